@@ -27,6 +27,8 @@ QTV3PrefWindow::QTV3PrefWindow(QWidget *parent, QGLVolRenWidget *vrw, bool vrw_s
 
    vol_hue_ = 120.0f;
 
+   frame_time_ = 0.0f;
+
    QSettings settings("www.open-terrain.org", "qtv3");
 
    if (settings.contains("vol_maxsize"))
@@ -42,6 +44,9 @@ QTV3PrefWindow::QTV3PrefWindow(QWidget *parent, QGLVolRenWidget *vrw, bool vrw_s
    if (settings.contains("vol_hue"))
       vol_hue_ = settings.value("vol_hue").toFloat();
 
+   if (settings.contains("frame_time"))
+      frame_time_ = settings.value("frame_time").toFloat();
+
    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
 
    if (env.contains("QTV3_VOL_LIMIT"))
@@ -54,6 +59,36 @@ QTV3PrefWindow::QTV3PrefWindow(QWidget *parent, QGLVolRenWidget *vrw, bool vrw_s
       iso_maxsize_ = env.value("QTV3_ISO_LIMIT").toUInt();
    }
 
+   if (env.contains("QTV3_GFX_BUDGET"))
+   {
+      vrw_->set_vol_budget(env.value("QTV3_GFX_BUDGET").toUInt());
+   }
+
+   if (env.contains("QTV3_RAYCAST"))
+   {
+      vrw_->set_vol_raycast(env.value("QTV3_RAYCAST").toUInt()!=0);
+   }
+
+   if (env.contains("QTV3_CPU_RENDER"))
+   {
+      vrw_->set_vol_cpu(env.value("QTV3_CPU_RENDER").toUInt()!=0);
+   }
+
+   if (env.contains("QTV3_OCCLUSION"))
+   {
+      vrw_->set_vol_occlusion(env.value("QTV3_OCCLUSION").toUInt()!=0);
+   }
+
+   if (env.contains("QTV3_VOL_SCALE"))
+   {
+      vrw_->set_vol_scale(env.value("QTV3_VOL_SCALE").toFloat());
+   }
+
+   if (env.contains("QTV3_FRAME_TIME"))
+   {
+      frame_time_ = env.value("QTV3_FRAME_TIME").toFloat();
+   }
+
    vrw_->set_vol_maxsize(vol_maxsize_, border_ratio_);
    vrw_->set_iso_maxsize(iso_maxsize_, border_ratio_);
 
@@ -62,6 +97,8 @@ QTV3PrefWindow::QTV3PrefWindow(QWidget *parent, QGLVolRenWidget *vrw, bool vrw_s
 
    vrw_->setColorHue(vol_hue_);
 
+   vrw_->setFrameTime(frame_time_);
+
    createWidgets();
 
    shotname_="shot";
@@ -78,6 +115,8 @@ QTV3PrefWindow::~QTV3PrefWindow()
    settings.setValue("slice_opacity2", slice_opacity2_);
 
    settings.setValue("vol_hue", vol_hue_);
+
+   settings.setValue("frame_time", frame_time_);
 }
 
 void QTV3PrefWindow::setLabelFileName(QString fname)
@@ -137,6 +176,11 @@ void QTV3PrefWindow::createWidgets()
    connect(lineEdit_iso_maxsize_,SIGNAL(textChanged(QString)),this,SLOT(isoMaxSizeChange(QString)));
    layout_->addWidget(iso_maxsize_group);
 
+   lineEdit_frame_time_ = new QLineEdit;
+   QGroupBox *frame_time_group = createEdit("Target Frame Time for Progressive Rendering (ms, 0=off)", QString::number(frame_time_), &lineEdit_frame_time_);
+   connect(lineEdit_frame_time_,SIGNAL(textChanged(QString)),this,SLOT(frameTimeChange(QString)));
+   layout_->addWidget(frame_time_group);
+
    QFrame* line2 = new QFrame();
    line2->setFrameShape(QFrame::HLine);
    line2->setFrameShadow(QFrame::Raised);
@@ -274,6 +318,12 @@ void QTV3PrefWindow::isoMaxSizeChange(QString maxsize)
    isoMaxSizeChange(maxsize.toUInt());
 }
 
+void QTV3PrefWindow::frameTimeChange(QString ms)
+{
+   frame_time_ = ms.toFloat();
+   vrw_->setFrameTime(frame_time_);
+}
+
 void QTV3PrefWindow::sfxBaseChange(int value)
 {
    sfx_base_ = value/100.0f/16;
@@ -50,6 +50,8 @@ public:
 
    float vol_hue_;
 
+   float frame_time_;
+
    QString shotname_;
 
 protected:
@@ -68,6 +70,7 @@ protected:
    QLineEdit *lineEdit_vol_maxsize_;
    QLineEdit *lineEdit_gfx_maxsize_;
    QLineEdit *lineEdit_iso_maxsize_;
+   QLineEdit *lineEdit_frame_time_;
 
    QRadioButton *sfxOffCheck_;
    QRadioButton *anaModeCheck_;
@@ -100,6 +103,7 @@ protected slots:
    void volMaxSizeChange(QString);
    void volGfxSizeChange(QString);
    void isoMaxSizeChange(QString);
+   void frameTimeChange(QString);
 
    void sfxBaseChange(int value);
    void sfxFocusChange(int value);
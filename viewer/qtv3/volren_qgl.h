@@ -28,6 +28,8 @@
 
 #define VOLREN_DEFAULT_BRICKSIZE 128
 
+#define VOLREN_PROGRESSIVE_VIEW 26 // number of tracked view parameters
+
 #define VOLREN_DEFAULT_WIDTH 800
 #define VOLREN_DEFAULT_HEIGHT 600
 
@@ -194,6 +196,12 @@ public:
       set_vol_maxsize(512);
       set_iso_maxsize(256);
 
+      set_vol_budget(0);
+      set_vol_raycast(FALSE);
+      set_vol_cpu(FALSE);
+      set_vol_occlusion(FALSE);
+      set_vol_scale(1.0f);
+
       setSliceOpacity(0.75f);
       setOuterOpacity(0.1f);
 
@@ -228,6 +236,9 @@ public:
       opacity_ = 0.75f;
       opacity2_ = 0.1f;
       oversampling_ = 1.0;
+      frametime_ = 0.0;
+      deadline_ = 0.0;
+      for (int i=0; i<VOLREN_PROGRESSIVE_VIEW; i++) view_[i] = 0.0;
       emi_ = 0.25;
       att_ = 0.25;
       emi_gm_ = 0.25;
@@ -438,6 +449,36 @@ public:
       iso_ratio_=ratio;
    }
 
+   //! set graphics memory budget in MB (0=unlimited)
+   void set_vol_budget(long long budget)
+   {
+      vol_budget_=budget;
+   }
+
+   //! enable ray casting instead of slicing
+   void set_vol_raycast(bool raycast)
+   {
+      vol_raycast_=raycast;
+   }
+
+   //! enable ray casting on the cpu for render servers without a gpu
+   void set_vol_cpu(bool cpu)
+   {
+      vol_cpu_=cpu;
+   }
+
+   //! enable occlusion culling of bricks behind saturated pixels
+   void set_vol_occlusion(bool occlusion)
+   {
+      vol_occlusion_=occlusion;
+   }
+
+   //! set volume resolution during interaction (1=full resolution)
+   void set_vol_scale(float scale)
+   {
+      vol_scale_=scale;
+   }
+
    //! set volume rotation speed
    void setRotation(double omega=30.0)
    {
@@ -573,6 +614,12 @@ public:
    void setOversampling(double rate=1.0)
       {oversampling_=1.0/rate;}
 
+   //! set target frame time in ms for progressive rendering (0=off)
+   //! the sampling adapts to the target frame time during interaction
+   //! and the following idle frame is rendered with full quality
+   void setFrameTime(double ms=0.0)
+      {frametime_=ms/1000.0;}
+
    //! set default color
    void setColor(float r,float g,float b)
    {
@@ -826,6 +873,11 @@ protected:
 
    long long vol_maxsize_;
    float vol_ratio_;
+   long long vol_budget_;
+   bool vol_raycast_;
+   bool vol_cpu_;
+   bool vol_occlusion_;
+   float vol_scale_;
    long long iso_maxsize_;
    float iso_ratio_;
 
@@ -852,6 +904,9 @@ protected:
    float opacity_; // clipping plane opacity
    float opacity2_; // outer clipping plane opacity
    double oversampling_; // oversampling rate
+   double frametime_; // target frame time in seconds
+   double deadline_; // abort time of actual frame
+   double view_[VOLREN_PROGRESSIVE_VIEW]; // view parameters of last frame
    double red_,green_,blue_; // default color
    double emi_; // volume emission
    double att_; // volume absorption
@@ -949,6 +1004,20 @@ protected:
 
       double vol_over=oversampling_;
 
+      // detect interaction
+      bool interacting=changedView();
+
+      // reduce the volume resolution during interaction
+      vr_->set_vol_scale(interacting?vol_scale_:1.0f);
+
+      // progressive rendering adapts the sampling of the volume to the target frame time
+      bool progressive=(frametime_>0.0 && vr_->has_data());
+
+      vr_->set_vol_fps((progressive && interacting)?1.0/frametime_:0.0);
+
+      if (progressive && interacting)
+         deadline_=gettime()+2.0*frametime_;
+
       // zoom
       eye_x=(1.0-zoom_)*eye_x;
       eye_y=(1.0-zoom_)*eye_y;
@@ -982,6 +1051,9 @@ protected:
 
       vr_->setSFXmode(0);
 
+      vr_->set_vol_raycast(vol_raycast_);
+      vr_->set_vol_occlusion(vol_occlusion_);
+
       // call volume renderer
       if (sfx_base==0.0)
          vr_->renderscene(eye_tx,eye_ty,eye_tz, // view point
@@ -1007,7 +1079,8 @@ protected:
                           opacity_, // clipping plane opacity
                           opacity2_, // outer clipping plane opacity
                           geo_show_, // show surface geometry
-                          TRUE); // clear frame buffer
+                          TRUE, // clear frame buffer
+                          (progressive && interacting)?abortFrame:NULL,this); // abort late preview
       else
       {
          double eye_rx,eye_ry,eye_rz;
@@ -1185,6 +1258,37 @@ protected:
       if (vr_->has_data()) rendercount_++;
    }
 
+   // check for changed view parameters
+   bool changedView()
+   {
+      double view[VOLREN_PROGRESSIVE_VIEW]={eye_x_,eye_y_,eye_z_,
+                                     eye_dx_,eye_dy_,eye_dz_,
+                                     eye_ux_,eye_uy_,eye_uz_,
+                                     angle_,tiltXY_,tiltYZ_,tilt_,zoom_,
+                                     vol_dx_,vol_dy_,vol_dz_,clipdist_,
+                                     emi_,att_,emi_gm_,att_gm_,
+                                     tf_center_,tf_size_,
+                                     (double)width(),(double)height()};
+
+      bool changed=bLeftButtonDown || bMiddleButtonDown || bRightButtonDown;
+
+      for (int i=0; i<VOLREN_PROGRESSIVE_VIEW; i++)
+         if (view[i]!=view_[i])
+         {
+            view_[i]=view[i];
+            changed=true;
+         }
+
+      return(changed);
+   }
+
+   // abort a preview that exceeds the target frame time by far
+   static BOOLINT abortFrame(void *data)
+   {
+      QGLVolRenWidget *widget=(QGLVolRenWidget *)data;
+      return(gettime()>widget->deadline_);
+   }
+
    void timerEvent(QTimerEvent *)
    {
       repaint();
@@ -1209,6 +1313,12 @@ protected:
             // set maximum volume size
             vr->set_vol_maxsize(vol_maxsize_,vol_ratio_);
 
+            // set graphics memory budget
+            vr->set_vol_budget(vol_budget_);
+
+            // keep the volume in host memory for cpu ray casting
+            vr->set_vol_cpu(vol_cpu_);
+
             // try to load from regular file path
             if (!loadFile(vr, toload_))
                if (altpath_!=NULL)
@@ -1246,6 +1356,12 @@ protected:
 
             volren_qgl *vr = new volren_qgl();
 
+            // set graphics memory budget
+            vr->set_vol_budget(vol_budget_);
+
+            // keep the volume in host memory for cpu ray casting
+            vr->set_vol_cpu(vol_cpu_);
+
             vr->loadseries(series_,
                            0.0f,0.0f,0.0f,
                            1.0f,1.0f,1.0f,
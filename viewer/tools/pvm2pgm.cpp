@@ -3,6 +3,7 @@
 #include "codebase.h"
 
 #include "ddsbase.h"
+#include "mprbase.h"
 
 #define MAX_STR 1000
 
@@ -21,14 +22,59 @@ int main(int argc,char *argv[])
 
    char filename[MAX_STR];
 
-   if (argc!=3)
+   char str1[MAX_STR],str2[MAX_STR];
+
+   BOOLINT oblique=FALSE;
+
+   float cx=-1.0f,cy=-1.0f,cz=-1.0f;
+   float nx=0.0f,ny=0.0f,nz=1.0f;
+   float thickness=0.0f,spacing=0.0f,distance=0.0f;
+   int mode=MPR_SLICE,bits=8,slices=1;
+   int wd=0,ht=0;
+
+   if (argc<3)
       {
-      printf("usage: %s <input.pvm> <output.pgm>\n",argv[0]);
+      printf("usage: %s <input.pvm> <output.pgm> {<option>=<value>}\n",argv[0]);
       printf(" input: compressed PVM volume\n");
       printf(" output: pgm image series containing the volume slices\n");
+      printf(" options for oblique slices:\n");
+      printf("  cx=<center x> cy=<center y> cz=<center z> (in voxels)\n");
+      printf("  nx=<normal x> ny=<normal y> nz=<normal z>\n");
+      printf("  wd=<width> ht=<height> sp=<pixel spacing> (in edge length units)\n");
+      printf("  ns=<number of slices> ds=<slice distance> (in edge length units)\n");
+      printf("  th=<slab thickness> (in edge length units)\n");
+      printf("  md=<slab mode: 1=mip 2=minip 3=average> bt=<bits: 8 or 16>\n");
       exit(1);
       }
 
+   for (i=3; i<(unsigned int)argc; i++)
+      if (sscanf(argv[i],"%999[^=]=%999s",str1,str2)==2)
+         {
+         if (strcasecmp(str1,"cx")==0) sscanf(str2,"%g",&cx);
+         else if (strcasecmp(str1,"cy")==0) sscanf(str2,"%g",&cy);
+         else if (strcasecmp(str1,"cz")==0) sscanf(str2,"%g",&cz);
+         else if (strcasecmp(str1,"nx")==0) sscanf(str2,"%g",&nx);
+         else if (strcasecmp(str1,"ny")==0) sscanf(str2,"%g",&ny);
+         else if (strcasecmp(str1,"nz")==0) sscanf(str2,"%g",&nz);
+         else if (strcasecmp(str1,"wd")==0) sscanf(str2,"%d",&wd);
+         else if (strcasecmp(str1,"ht")==0) sscanf(str2,"%d",&ht);
+         else if (strcasecmp(str1,"sp")==0) sscanf(str2,"%g",&spacing);
+         else if (strcasecmp(str1,"ns")==0) sscanf(str2,"%d",&slices);
+         else if (strcasecmp(str1,"ds")==0) sscanf(str2,"%g",&distance);
+         else if (strcasecmp(str1,"th")==0) sscanf(str2,"%g",&thickness);
+         else if (strcasecmp(str1,"md")==0) sscanf(str2,"%d",&mode);
+         else if (strcasecmp(str1,"bt")==0) sscanf(str2,"%d",&bits);
+         else ERRORMSG();
+
+         oblique=TRUE;
+         }
+      else ERRORMSG();
+
+   if (nx==0.0f && ny==0.0f && nz==0.0f) ERRORMSG();
+   if (slices<1 || thickness<0.0f || spacing<0.0f) ERRORMSG();
+   if (mode<MPR_SLICE || mode>MPR_AVERAGE) ERRORMSG();
+   if (bits!=8 && bits!=16) ERRORMSG();
+
    printf("reading PVM file\n");
 
    if ((volume=readPVMvolume(argv[1],&width,&height,&depth,&components,&scalex,&scaley,&scalez))==NULL) exit(1);
@@ -42,23 +88,90 @@ int main(int argc,char *argv[])
 
    printf("and data checksum=%08X\n",checksum(volume,width*height*depth*components));
 
+   // 16-bit data is kept for 16-bit oblique slices
    if (components==2)
+      if (!oblique || bits==8)
+         {
+         volume=quantize(volume,width,height,depth);
+         components=1;
+         }
+
+   if (components!=1 && components!=2) ERRORMSG();
+
+   if (!oblique)
       {
-      volume=quantize(volume,width,height,depth);
-      components=1;
-      }
+      if ((image=(unsigned char *)malloc(width*height*components))==NULL) exit(1);
+
+      for (i=0; i<depth; i++)
+         {
+         printf("writing PGM file #%d\n",i+1);
 
-   if ((image=(unsigned char *)malloc(width*height*components))==NULL) exit(1);
+         for (j=0; j<height; j++)
+            memcpy(&image[(height-1-j)*width*components],&volume[i*width*height*components+j*width*components],width*components);
 
-   for (i=0; i<depth; i++)
+         snprintf(filename,MAX_STR,"%s-%04d.pgm",argv[2],i+1);
+         writePNMimage(filename,image,width,height,components);
+         }
+      }
+   else
       {
-      printf("writing PGM file #%d\n",i+1);
+      mpr engine;
+
+      float l,o;
+      float ux,uy,uz;
+      float vx,vy,vz;
+      int samples;
+
+      if (width<2 || height<2 || depth<2) ERRORMSG();
+
+      // default plane through the center of the volume
+      if (cx<0.0f) cx=0.5f*(width-1);
+      if (cy<0.0f) cy=0.5f*(height-1);
+      if (cz<0.0f) cz=0.5f*(depth-1);
+
+      if (wd<=0) wd=width;
+      if (ht<=0) ht=height;
+
+      if (spacing==0.0f) spacing=fmin(scalex,fmin(scaley,scalez));
+      if (distance==0.0f) distance=spacing;
+
+      l=fsqrt(nx*nx+ny*ny+nz*nz);
+
+      nx/=l;
+      ny/=l;
+      nz/=l;
+
+      mpr::axes(nx,ny,nz,&ux,&uy,&uz,&vx,&vy,&vz);
+
+      // slab sampling with one sample per pixel spacing
+      samples=1;
+
+      if (thickness>0.0f && mode!=MPR_SLICE)
+         samples=ftrc(fceil(thickness/spacing))+1;
+
+      engine.set_data(volume,width,height,depth,components);
+
+      if ((image=(unsigned char *)malloc(wd*ht*(bits/8)))==NULL) exit(1);
+
+      for (i=0; i<(unsigned int)slices; i++)
+         {
+         printf("writing PGM file #%d\n",i+1);
+
+         o=(i-0.5f*(slices-1))*distance;
 
-      for (j=0; j<height; j++)
-         memcpy(&image[(height-1-j)*width*components],&volume[i*width*height*components+j*width*components],width*components);
+         engine.resample(cx+o*nx/scalex,cy+o*ny/scaley,cz+o*nz/scalez,
+                         spacing*ux/scalex,spacing*uy/scaley,spacing*uz/scalez,
+                         spacing*vx/scalex,spacing*vy/scaley,spacing*vz/scalez,
+                         (samples>1)?thickness/(samples-1)*nx/scalex:0.0f,
+                         (samples>1)?thickness/(samples-1)*ny/scaley:0.0f,
+                         (samples>1)?thickness/(samples-1)*nz/scalez:0.0f,
+                         samples,mode,
+                         wd,ht,
+                         image,bits/8);
 
-      snprintf(filename,MAX_STR,"%s-%04d.pgm",argv[2],i+1);
-      writePNMimage(filename,image,width,height,components);
+         snprintf(filename,MAX_STR,"%s-%04d.pgm",argv[2],i+1);
+         writePNMimage(filename,image,wd,ht,bits/8);
+         }
       }
 
    free(image);
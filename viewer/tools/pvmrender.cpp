@@ -0,0 +1,571 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+// headless offscreen renderer for thumbnails and turntable movies
+
+#include "codebase.h" // universal code base
+#include "oglbase.h" // OpenGL base rendering
+#include "ddsbase.h" // volume file reader
+#include "volren.h" // volume renderer
+#include "threadbase.h" // thread base
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#endif
+
+#ifdef HAVE_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#define STR_MAX (256)
+
+#define IMG_WIDTH (512)
+#define IMG_HEIGHT (512)
+
+#define EYE_FOVY (60.0f)
+#define EYE_NEAR (0.01f)
+#define EYE_FAR (10.0f)
+#define EYE_DIST (2.0f)
+
+#define VOL_EMISSION (1000.0f)
+#define VOL_DENSITY (1000.0f)
+#define VOL_SCALE (0.25f)
+
+#define VOL_BRICKSIZE (128)
+
+#define QUEUE_MAX (8)
+
+char *TFNAME=NULL;
+char *PATHNAME=NULL;
+
+int WIDTH=IMG_WIDTH;
+int HEIGHT=IMG_HEIGHT;
+
+int FRAMES=1;
+
+float OVER=1.0f;
+BOOLINT RAYCAST=FALSE;
+BOOLINT CPU=FALSE;
+int PROJ=0;
+BOOLINT WHITE=TRUE;
+
+volren *VOLREN=NULL;
+
+float TF_RE,TF_GE,TF_BE;
+float TF_RA,TF_GA,TF_BA;
+
+// camera path
+struct camera
+   {
+   float ex,ey,ez;
+   float dx,dy,dz;
+   float ux,uy,uz;
+   float rot;
+   };
+
+camera *PATH=NULL;
+int PATHCNT=0;
+
+// queue of frames waiting to be encoded
+struct encoder
+   {
+   unsigned char *image[QUEUE_MAX];
+   int frame[QUEUE_MAX];
+
+   int first,count;
+   BOOLINT done;
+
+   const char *prefix;
+
+   void *thread;
+   void *lock;
+   void *cond;
+   };
+
+encoder ENCODER;
+
+// flip and write one frame
+void encode(unsigned char *image,int frame,const char *prefix)
+   {
+   int y;
+
+   unsigned char *flipped;
+
+   char filename[STR_MAX];
+
+   if ((flipped=(unsigned char *)malloc(3*WIDTH*HEIGHT))==NULL) ERRORMSG();
+
+   for (y=0; y<HEIGHT; y++)
+      memcpy(&flipped[3*WIDTH*y],&image[3*WIDTH*(HEIGHT-1-y)],3*WIDTH);
+
+   snprintf(filename,STR_MAX,"%s%04d.ppm",prefix,frame);
+   writePNMimage(filename,flipped,WIDTH,HEIGHT,3);
+
+   free(flipped);
+   }
+
+// encoder thread
+void encodethread(void *data)
+   {
+   encoder *enc=(encoder *)data;
+
+   unsigned char *image;
+   int frame;
+
+   for (;;)
+      {
+      acquirelock(enc->lock);
+
+      while (enc->count==0 && !enc->done)
+         waitcondition(enc->cond,enc->lock);
+
+      if (enc->count==0)
+         {
+         releaselock(enc->lock);
+         break;
+         }
+
+      image=enc->image[enc->first];
+      frame=enc->frame[enc->first];
+
+      enc->first=(enc->first+1)%QUEUE_MAX;
+      enc->count--;
+
+      signalcondition(enc->cond);
+      releaselock(enc->lock);
+
+      encode(image,frame,enc->prefix);
+
+      free(image);
+      }
+   }
+
+// hand a frame over to the encoder thread
+void pushframe(encoder *enc,unsigned char *image,int frame)
+   {
+   // encode synchronously if no encoder thread is running
+   if (enc->thread==NULL)
+      {
+      encode(image,frame,enc->prefix);
+      free(image);
+      return;
+      }
+
+   acquirelock(enc->lock);
+
+   while (enc->count==QUEUE_MAX)
+      waitcondition(enc->cond,enc->lock);
+
+   enc->image[(enc->first+enc->count)%QUEUE_MAX]=image;
+   enc->frame[(enc->first+enc->count)%QUEUE_MAX]=frame;
+
+   enc->count++;
+
+   signalcondition(enc->cond);
+   releaselock(enc->lock);
+   }
+
+// create the offscreen framebuffer object that receives the frames
+GLuint openframebuffer(GLuint rbo[2])
+   {
+   GLuint fbo=0;
+
+#ifdef GL_EXT_framebuffer_object
+
+   char *GL_EXTs;
+
+   if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+   if (strstr(GL_EXTs,"EXT_framebuffer_object")==NULL) return(0);
+
+   glGenRenderbuffersEXT(2,rbo);
+
+   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT,rbo[0]);
+   glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT,GL_RGBA8,WIDTH,HEIGHT);
+   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT,rbo[1]);
+   glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT,GL_DEPTH_COMPONENT24,WIDTH,HEIGHT);
+   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT,0);
+
+   glGenFramebuffersEXT(1,&fbo);
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,fbo);
+
+   glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT,GL_RENDERBUFFER_EXT,rbo[0]);
+   glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,GL_DEPTH_ATTACHMENT_EXT,GL_RENDERBUFFER_EXT,rbo[1]);
+
+   // fall back to the pbuffer if the fbo is incomplete
+   if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)!=GL_FRAMEBUFFER_COMPLETE_EXT)
+      {
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,0);
+      glDeleteFramebuffersEXT(1,&fbo);
+      glDeleteRenderbuffersEXT(2,rbo);
+      return(0);
+      }
+
+#endif
+
+   return(fbo);
+   }
+
+// delete the offscreen framebuffer object
+void closeframebuffer(GLuint fbo,GLuint rbo[2])
+   {
+   if (fbo==0) return;
+
+#ifdef GL_EXT_framebuffer_object
+
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,0);
+   glDeleteFramebuffersEXT(1,&fbo);
+   glDeleteRenderbuffersEXT(2,rbo);
+
+#endif
+   }
+
+// create an offscreen context
+BOOLINT opencontext()
+   {
+#ifdef HAVE_EGL
+
+   EGLDisplay display;
+   EGLConfig config;
+   EGLSurface surface;
+   EGLContext context;
+
+   EGLint major,minor,count;
+
+   EGLint configattr[]={EGL_SURFACE_TYPE,EGL_PBUFFER_BIT,
+                        EGL_RED_SIZE,8,EGL_GREEN_SIZE,8,EGL_BLUE_SIZE,8,EGL_ALPHA_SIZE,8,
+                        EGL_DEPTH_SIZE,24,
+                        EGL_RENDERABLE_TYPE,EGL_OPENGL_BIT,
+                        EGL_NONE};
+
+   EGLint surfaceattr[]={EGL_WIDTH,WIDTH,EGL_HEIGHT,HEIGHT,EGL_NONE};
+
+   // servers have no display, so let mesa run without one
+   if (getenv("DISPLAY")==NULL) setenv("EGL_PLATFORM","surfaceless",0);
+
+   if ((display=eglGetDisplay(EGL_DEFAULT_DISPLAY))==EGL_NO_DISPLAY) return(FALSE);
+   if (!eglInitialize(display,&major,&minor)) return(FALSE);
+
+   if (!eglChooseConfig(display,configattr,&config,1,&count)) return(FALSE);
+   if (count<1) return(FALSE);
+
+   if ((surface=eglCreatePbufferSurface(display,config,surfaceattr))==EGL_NO_SURFACE) return(FALSE);
+
+   if (!eglBindAPI(EGL_OPENGL_API)) return(FALSE);
+   if ((context=eglCreateContext(display,config,EGL_NO_CONTEXT,NULL))==EGL_NO_CONTEXT) return(FALSE);
+
+   return(eglMakeCurrent(display,surface,surface,context));
+
+#elif defined(HAVE_OSMESA)
+
+   OSMesaContext context;
+
+   static unsigned char *buffer=NULL;
+
+   if ((context=OSMesaCreateContextExt(OSMESA_RGBA,24,0,0,NULL))==NULL) return(FALSE);
+
+   if ((buffer=(unsigned char *)malloc(4*WIDTH*HEIGHT))==NULL) ERRORMSG();
+
+   return(OSMesaMakeCurrent(context,buffer,GL_UNSIGNED_BYTE,WIDTH,HEIGHT));
+
+#else
+
+   return(FALSE);
+
+#endif
+   }
+
+// read a camera path with one view per line
+// each view is given by eye point, viewing direction, up vector and volume rotation
+void loadpath(const char *filename)
+   {
+   FILE *file;
+
+   camera cam;
+   int maxcnt;
+
+   if ((file=fopen(filename,"rb"))==NULL) ERRORMSG();
+
+   maxcnt=0;
+
+   while (fscanf(file,"%g %g %g %g %g %g %g %g %g %g\n",
+                 &cam.ex,&cam.ey,&cam.ez,
+                 &cam.dx,&cam.dy,&cam.dz,
+                 &cam.ux,&cam.uy,&cam.uz,
+                 &cam.rot)==10)
+      {
+      if (PATHCNT>=maxcnt)
+         {
+         maxcnt=2*maxcnt+1;
+         if ((PATH=(camera *)realloc(PATH,maxcnt*sizeof(camera)))==NULL) ERRORMSG();
+         }
+
+      PATH[PATHCNT++]=cam;
+      }
+
+   fclose(file);
+
+   if (PATHCNT==0) ERRORMSG();
+
+   FRAMES=PATHCNT;
+   }
+
+// get the view of a frame
+camera getview(int frame)
+   {
+   camera cam;
+
+   if (PATHCNT>0) return(PATH[frame]);
+
+   // turntable about the vertical axis
+   cam.ex=0.0f;
+   cam.ey=0.0f;
+   cam.ez=EYE_DIST;
+
+   cam.dx=0.0f;
+   cam.dy=0.0f;
+   cam.dz=-1.0f;
+
+   cam.ux=0.0f;
+   cam.uy=1.0f;
+   cam.uz=0.0f;
+
+   cam.rot=360.0f*frame/FRAMES;
+
+   return(cam);
+   }
+
+// load the transfer function from a v3 configuration file
+void loadtfunc(const char *filename)
+   {
+   FILE *file;
+
+   if ((file=fopen(filename,"rb"))==NULL) ERRORMSG();
+
+   VOLREN->get_tfunc()->load(file);
+
+   fclose(file);
+
+   VOLREN->get_tfunc()->get_escale(&TF_RE,&TF_GE,&TF_BE);
+   VOLREN->get_tfunc()->get_ascale(&TF_RA,&TF_GA,&TF_BA);
+
+   TF_RE=fsqrt(TF_RE);
+   TF_GE=fsqrt(TF_GE);
+   TF_BE=fsqrt(TF_BE);
+
+   TF_RA=fsqrt(TF_RA);
+   TF_GA=fsqrt(TF_GA);
+   TF_BA=fsqrt(TF_BA);
+   }
+
+// render one frame
+void renderframe(int frame)
+   {
+   camera cam=getview(frame);
+
+   glViewport(0,0,WIDTH,HEIGHT);
+
+   VOLREN->begin(EYE_FOVY,(float)WIDTH/HEIGHT,EYE_NEAR,EYE_FAR,
+                 WHITE,FALSE);
+
+   VOLREN->render(cam.ex,cam.ey,cam.ez,
+                  cam.dx,cam.dy,cam.dz,
+                  cam.ux,cam.uy,cam.uz,
+                  EYE_NEAR,
+                  TRUE,
+                  cam.rot,0.0f,0.0f,
+                  0.0f,0.0f,0.0f,
+                  VOL_EMISSION,VOL_DENSITY,
+                  TF_RE,TF_GE,TF_BE,
+                  TF_RA,TF_GA,TF_BA,
+                  TRUE,TRUE,
+                  FALSE,
+                  OVER,
+                  TRUE);
+   }
+
+// render all frames into the fbo with asynchronous pixel buffer readback
+void renderframes(const char *prefix)
+   {
+   int i;
+
+   char *GL_EXTs;
+   BOOLINT haspbo=FALSE;
+
+   GLuint fbo,rbo[2];
+   GLuint pbo[2];
+
+   unsigned char *image;
+   unsigned char *ptr;
+
+   int bytes=3*WIDTH*HEIGHT;
+
+   if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+
+#ifdef GL_ARB_pixel_buffer_object
+   if (strstr(GL_EXTs,"ARB_pixel_buffer_object")!=NULL) haspbo=TRUE;
+#endif
+
+   ENCODER.first=ENCODER.count=0;
+   ENCODER.done=FALSE;
+   ENCODER.prefix=prefix;
+
+   ENCODER.lock=createlock();
+   ENCODER.cond=createcondition();
+
+   ENCODER.thread=createthread(encodethread,&ENCODER);
+
+   // render into an fbo and read back from it (or from the pbuffer if there is no fbo)
+   fbo=openframebuffer(rbo);
+
+   glPixelStorei(GL_PACK_ALIGNMENT,1);
+
+#ifdef GL_ARB_pixel_buffer_object
+
+   if (haspbo)
+      {
+      glGenBuffersARB(2,pbo);
+
+      for (i=0; i<2; i++)
+         {
+         glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,pbo[i]);
+         glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB,bytes,NULL,GL_STREAM_READ_ARB);
+         }
+
+      glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,0);
+
+      // read frame i into one pbo while the previous frame is mapped from the other
+      for (i=0; i<=FRAMES; i++)
+         {
+         if (i<FRAMES)
+            {
+            renderframe(i);
+
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,pbo[i%2]);
+            glReadPixels(0,0,WIDTH,HEIGHT,GL_RGB,GL_UNSIGNED_BYTE,NULL);
+
+            // keep the pbo unbound while rendering
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,0);
+            }
+
+         if (i>0)
+            {
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,pbo[(i-1)%2]);
+
+            if ((ptr=(unsigned char *)glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB,GL_READ_ONLY_ARB))==NULL) ERRORMSG();
+            if ((image=(unsigned char *)malloc(bytes))==NULL) ERRORMSG();
+
+            memcpy(image,ptr,bytes);
+            glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,0);
+
+            pushframe(&ENCODER,image,i-1);
+            }
+         }
+
+      glDeleteBuffersARB(2,pbo);
+      }
+
+#endif
+
+   // synchronous readback
+   if (!haspbo)
+      for (i=0; i<FRAMES; i++)
+         {
+         renderframe(i);
+
+         if ((image=(unsigned char *)malloc(bytes))==NULL) ERRORMSG();
+         glReadPixels(0,0,WIDTH,HEIGHT,GL_RGB,GL_UNSIGNED_BYTE,image);
+
+         pushframe(&ENCODER,image,i);
+         }
+
+   closeframebuffer(fbo,rbo);
+
+   // wait for the encoder to finish
+   acquirelock(ENCODER.lock);
+   ENCODER.done=TRUE;
+   signalcondition(ENCODER.cond);
+   releaselock(ENCODER.lock);
+
+   jointhread(ENCODER.thread);
+
+   destroycondition(ENCODER.cond);
+   destroylock(ENCODER.lock);
+   }
+
+int main(int argc,char *argv[])
+   {
+   int i,tmp;
+
+   char str1[STR_MAX],str2[STR_MAX];
+
+   if (argc<3)
+      {
+      printf("usage: %s <input.pvm> <output prefix> {<option>=<value>}\n",argv[0]);
+      printf(" options: wd=<width> ht=<height> fr=<turntable frames>\n");
+      printf("          tf=<v3 configuration file> cp=<camera path file>\n");
+      printf("          ov=<oversampling> rc=<ray casting> cr=<cpu ray casting>\n");
+      printf("          bg=<white background> pm=<projection mode: 1=mip 2=minip 3=average>\n");
+      printf(" each line of a camera path holds the eye point, viewing direction,\n");
+      printf(" up vector and volume rotation in degrees\n");
+      exit(1);
+      }
+
+   for (i=3; i<argc; i++)
+      if (sscanf(argv[i],"%255[^=]=%255s",str1,str2)==2)
+         {
+         if (strcasecmp(str1,"wd")==0) sscanf(str2,"%d",&WIDTH);
+         else if (strcasecmp(str1,"ht")==0) sscanf(str2,"%d",&HEIGHT);
+         else if (strcasecmp(str1,"fr")==0) sscanf(str2,"%d",&FRAMES);
+         else if (strcasecmp(str1,"tf")==0) TFNAME=strdup(str2);
+         else if (strcasecmp(str1,"cp")==0) PATHNAME=strdup(str2);
+         else if (strcasecmp(str1,"ov")==0) sscanf(str2,"%g",&OVER);
+         else if (strcasecmp(str1,"rc")==0) {sscanf(str2,"%d",&tmp); RAYCAST=(tmp!=0);}
+         else if (strcasecmp(str1,"cr")==0) {sscanf(str2,"%d",&tmp); CPU=(tmp!=0);}
+         else if (strcasecmp(str1,"pm")==0) sscanf(str2,"%d",&PROJ);
+         else if (strcasecmp(str1,"bg")==0) {sscanf(str2,"%d",&tmp); WHITE=(tmp!=0);}
+         else ERRORMSG();
+         }
+      else ERRORMSG();
+
+   if (WIDTH<1 || HEIGHT<1 || FRAMES<1 || OVER<=0.0f) ERRORMSG();
+
+   if (PATHNAME!=NULL) loadpath(PATHNAME);
+
+   if (!opencontext())
+      {
+      printf("unable to create an offscreen context\n");
+      exit(1);
+      }
+
+   VOLREN=new volren;
+   VOLREN->set_vol_cpu(CPU);
+   VOLREN->set_vol_mode(PROJ);
+
+   if (!VOLREN->loadvolume(argv[1],NULL,
+                           0.0f,0.0f,0.0f,
+                           1.0f,1.0f,1.0f,
+                           VOL_BRICKSIZE))
+      {
+      printf("unable to load %s\n",argv[1]);
+      exit(1);
+      }
+
+   VOLREN->set_vol_raycast(RAYCAST);
+
+   VOLREN->set_tfunc();
+
+   TF_RE=TF_GE=TF_BE=VOL_SCALE;
+   TF_RA=TF_GA=TF_BA=VOL_SCALE;
+
+   if (TFNAME!=NULL) loadtfunc(TFNAME);
+
+   renderframes(argv[2]);
+
+   delete VOLREN;
+
+   if (TFNAME!=NULL) free(TFNAME);
+   if (PATHNAME!=NULL) free(PATHNAME);
+   if (PATH!=NULL) free(PATH);
+
+   return(0);
+   }
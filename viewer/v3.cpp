@@ -136,6 +136,15 @@ BOOLINT GUI_inv=FALSE,
 
 BOOLINT GUI_fbo=TRUE;
 
+int GUI_budget=0;
+BOOLINT GUI_atlas=FALSE;
+BOOLINT GUI_raycast=FALSE;
+BOOLINT GUI_cpu=FALSE;
+int GUI_proj=0;
+BOOLINT GUI_occlusion=FALSE;
+float GUI_fps=0.0f;
+float GUI_scale=1.0f;
+
 float GUI_clip_dist=0.0f;
 
 int GUI_mode=0;
@@ -1133,7 +1142,7 @@ void parseargs(int argc,char *argv[])
       printf("        option of = save input data to pvm output file\n");
       printf("        option im = use inverse mode for dark room\n");
       printf("        option hi = use high-accuracy fbo\n");
-      printf("       advanced options: hm | hf | kn | hs | rd | ld\n");
+      printf("       advanced options: hm | hf | kn | hs | rd | ld | gb | ba | rc | cr | pm | oq | fr | rs\n");
       }
 
    if (argc<2)
@@ -1175,6 +1184,14 @@ void parseargs(int argc,char *argv[])
       else if (strcasecmp(str1,"ld")==0) {sscanf(str2,"%d",&tmp); GUI_loop=(tmp!=0);} // loop demo
       else if (strcasecmp(str1,"im")==0) {sscanf(str2,"%d",&tmp); GUI_inv=(tmp!=0);} // inverse mode
       else if (strcasecmp(str1,"hi")==0) {sscanf(str2,"%d",&tmp); GUI_fbo=(tmp!=0);} // fbo mode
+      else if (strcasecmp(str1,"gb")==0) sscanf(str2,"%d",&GUI_budget); // graphics memory budget in MB
+      else if (strcasecmp(str1,"ba")==0) {sscanf(str2,"%d",&tmp); GUI_atlas=(tmp!=0);} // brick atlas mode
+      else if (strcasecmp(str1,"rc")==0) {sscanf(str2,"%d",&tmp); GUI_raycast=(tmp!=0);} // ray casting mode
+      else if (strcasecmp(str1,"cr")==0) {sscanf(str2,"%d",&tmp); GUI_cpu=(tmp!=0);} // cpu ray casting
+      else if (strcasecmp(str1,"pm")==0) sscanf(str2,"%d",&GUI_proj); // intensity projection mode
+      else if (strcasecmp(str1,"oq")==0) {sscanf(str2,"%d",&tmp); GUI_occlusion=(tmp!=0);} // occlusion queries
+      else if (strcasecmp(str1,"fr")==0) sscanf(str2,"%g",&GUI_fps); // target frame rate
+      else if (strcasecmp(str1,"rs")==0) sscanf(str2,"%g",&GUI_scale); // reduced resolution scale
       }
    }
 
@@ -1191,6 +1208,10 @@ void initglobal(int argc,char *argv[])
    else *ptr='\0';
 
    VOLREN=new volren(PROGNAME);
+   VOLREN->set_vol_budget(GUI_budget);
+   VOLREN->set_vol_atlas(GUI_atlas);
+   VOLREN->set_vol_cpu(GUI_cpu);
+   VOLREN->set_vol_occlusion(GUI_occlusion);
 
    if (strlen(OUTNAME)>0)
       {
@@ -1339,6 +1360,9 @@ void handler(float time)
          case 'i': // toggle preintegration
             GUI_preint=!GUI_preint;
             break;
+         case 'r': // toggle ray casting
+            GUI_raycast=!GUI_raycast;
+            break;
          case 'g': // toggle 2DTF
             GUI_grad=!GUI_grad;
             reloadhook();
@@ -1517,6 +1541,16 @@ void handler(float time)
    VOLREN->enablewireframe(GUI_wire);
    VOLREN->enablehistogram(GUI_points);
 
+   VOLREN->set_vol_raycast(GUI_raycast);
+   VOLREN->set_vol_mode(GUI_proj);
+
+   // hold the target frame rate (demo replay defaults to the window rate)
+   if (GUI_fps>0.0f) VOLREN->set_vol_fps(GUI_fps);
+   else VOLREN->set_vol_fps(GUI_demo?WIN_FPS:0.0f);
+
+   // render the volume with reduced resolution during interaction
+   VOLREN->set_vol_scale(GUI_reduced?GUI_scale:1.0f);
+
    VOLREN->begin(EYE_FOVY,getaspect(),EYE_NEAR,EYE_FAR,
                  GUI_white,GUI_inv);
 
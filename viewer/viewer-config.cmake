@@ -207,9 +207,6 @@ IF (DCMTK_FOUND)
       ADD_DEFINITIONS(-DHAVE_CONFIG_H)
    ENDIF (NOT WIN32)
 
-   # find threads library
-   FIND_PACKAGE(Threads)
-
    # find ZLIB dependency
    FIND_VIEWER_LIBRARY(ZLIB_LIBRARY z "${ZLIB_PATH}")
    FIND_VIEWER_LIBRARY(ZLIB_LIBRARY zlib "${WIN32_ZLIB_PATH}")
@@ -219,6 +216,9 @@ IF (DCMTK_FOUND)
    ADD_DEFINITIONS(-DHAVE_DCMTK)
 ENDIF (DCMTK_FOUND)
 
+# find threads library
+FIND_PACKAGE(Threads)
+
 # find OpenGL dependency
 FIND_PACKAGE(OpenGL)
 IF (NOT OPENGL_LIBRARIES)
@@ -293,5 +293,6 @@ MACRO(MAKE_VIEWER_EXECUTABLE name)
    TARGET_LINK_LIBRARIES(${name}
       ${OPENGL_LIBRARIES}
       ${GLUT_LIBRARY}
+      ${CMAKE_THREAD_LIBS_INIT}
       )
 ENDMACRO(MAKE_VIEWER_EXECUTABLE)
@@ -3,8 +3,8 @@
 SET(VOLREN_HDRS
    volren/codebase.h
    volren/ddsbase.h volren/dicombase.h
-   volren/dirbase.h volren/oglbase.h volren/shaderbase.h
-   volren/tfbase.h volren/tilebase.h volren/progs.h
+   volren/dirbase.h volren/threadbase.h volren/oglbase.h volren/shaderbase.h
+   volren/tfbase.h volren/tilebase.h volren/raybase.h volren/mprbase.h volren/progs.h volren/ray_progs.h
    volren/volume.h volren/volren.h
    volren/geobase.h
    volren/v3d.h
@@ -12,8 +12,8 @@ SET(VOLREN_HDRS
 
 SET(VOLREN_SRCS
    volren/ddsbase.cpp volren/dicombase.cpp
-   volren/dirbase.cpp volren/oglbase.cpp volren/shaderbase.cpp
-   volren/tfbase.cpp volren/tilebase.cpp
+   volren/dirbase.cpp volren/threadbase.cpp volren/oglbase.cpp volren/shaderbase.cpp
+   volren/tfbase.cpp volren/tilebase.cpp volren/raybase.cpp volren/mprbase.cpp
    volren/volume.cpp
    volren/geobase.cpp
    )
@@ -0,0 +1,312 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#include "codebase.h"
+
+#include "threadbase.h"
+
+#include "mprbase.h"
+
+mpr::mpr()
+   {
+   DATA=NULL;
+
+   WIDTH=HEIGHT=DEPTH=0;
+   COMPONENTS=1;
+   }
+
+mpr::~mpr() {}
+
+// set the volume data
+void mpr::set_data(const unsigned char *data,
+                   long long width,long long height,long long depth,
+                   unsigned int components)
+   {
+   if (components!=1 && components!=2) ERRORMSG();
+
+   DATA=data;
+
+   WIDTH=width;
+   HEIGHT=height;
+   DEPTH=depth;
+
+   COMPONENTS=components;
+   }
+
+// calculate orthonormal in-plane axes
+void mpr::axes(float nx,float ny,float nz,
+               float *ux,float *uy,float *uz,
+               float *vx,float *vy,float *vz)
+   {
+   float l;
+   float ax,ay,az;
+
+   l=fsqrt(nx*nx+ny*ny+nz*nz);
+   if (l==0.0f) ERRORMSG();
+
+   nx/=l;
+   ny/=l;
+   nz/=l;
+
+   // the vertical axis follows the y-axis unless the plane is coronal
+   if (fabs(ny)<0.9f) {ax=0.0f; ay=1.0f; az=0.0f;}
+   else {ax=0.0f; ay=0.0f; az=1.0f;}
+
+   l=ax*nx+ay*ny+az*nz;
+
+   *vx=ax-l*nx;
+   *vy=ay-l*ny;
+   *vz=az-l*nz;
+
+   l=fsqrt((*vx)*(*vx)+(*vy)*(*vy)+(*vz)*(*vz));
+
+   *vx/=l;
+   *vy/=l;
+   *vz/=l;
+
+   *ux=(*vy)*nz-(*vz)*ny;
+   *uy=(*vz)*nx-(*vx)*nz;
+   *uz=(*vx)*ny-(*vy)*nx;
+   }
+
+// trilinear interpolation and accumulation of a packet of samples
+// the samples are clamped to the volume and flagged as valid if they were inside
+// so that the index calculation and the interpolation vectorize without branches
+void mpr::samplepacket(const float *x,const float *y,const float *z,
+                       int mode,float *acc,int *cnt)
+   {
+   int l,c;
+
+   int valid[MPRPACKET];
+
+   int ix[MPRPACKET],iy[MPRPACKET],iz[MPRPACKET];
+   float fx[MPRPACKET],fy[MPRPACKET],fz[MPRPACKET];
+
+   float w[8][MPRPACKET];
+   float v00,v01,v10,v11,v0,v1;
+   float v[MPRPACKET];
+
+   float sx,sy,sz;
+   float mx,my,mz;
+
+   long long idx,slice;
+
+   mx=WIDTH-1;
+   my=HEIGHT-1;
+   mz=DEPTH-1;
+
+   // clamped cell indices and fractions
+   for (l=0; l<MPRPACKET; l++)
+      {
+      valid[l]=(x[l]>=0.0f)&(y[l]>=0.0f)&(z[l]>=0.0f)&
+               (x[l]<=mx)&(y[l]<=my)&(z[l]<=mz);
+
+      sx=(x[l]>0.0f)?x[l]:0.0f;
+      sy=(y[l]>0.0f)?y[l]:0.0f;
+      sz=(z[l]>0.0f)?z[l]:0.0f;
+
+      sx=(sx<mx)?sx:mx;
+      sy=(sy<my)?sy:my;
+      sz=(sz<mz)?sz:mz;
+
+      ix[l]=(int)((sx<mx-1.0f)?sx:mx-1.0f);
+      iy[l]=(int)((sy<my-1.0f)?sy:my-1.0f);
+      iz[l]=(int)((sz<mz-1.0f)?sz:mz-1.0f);
+
+      fx[l]=sx-ix[l];
+      fy[l]=sy-iy[l];
+      fz[l]=sz-iz[l];
+      }
+
+   slice=WIDTH*HEIGHT;
+
+   // gather the cell corners
+   if (COMPONENTS==1)
+      for (l=0; l<MPRPACKET; l++)
+         {
+         idx=ix[l]+(iy[l]+iz[l]*HEIGHT)*WIDTH;
+
+         const unsigned char *ptr=&DATA[idx];
+
+         w[0][l]=ptr[0]; w[1][l]=ptr[1];
+         w[2][l]=ptr[WIDTH]; w[3][l]=ptr[WIDTH+1];
+         w[4][l]=ptr[slice]; w[5][l]=ptr[slice+1];
+         w[6][l]=ptr[slice+WIDTH]; w[7][l]=ptr[slice+WIDTH+1];
+         }
+   else
+      for (l=0; l<MPRPACKET; l++)
+         {
+         idx=ix[l]+(iy[l]+iz[l]*HEIGHT)*WIDTH;
+
+         const unsigned char *ptr=&DATA[2*idx];
+
+         long long o[8];
+
+         o[0]=0; o[1]=1;
+         o[2]=WIDTH; o[3]=WIDTH+1;
+         o[4]=slice; o[5]=slice+1;
+         o[6]=slice+WIDTH; o[7]=slice+WIDTH+1;
+
+         for (c=0; c<8; c++)
+            w[c][l]=256*ptr[2*o[c]]+ptr[2*o[c]+1];
+         }
+
+   // interpolate
+   for (l=0; l<MPRPACKET; l++)
+      {
+      v00=w[0][l]+fx[l]*(w[1][l]-w[0][l]);
+      v01=w[2][l]+fx[l]*(w[3][l]-w[2][l]);
+      v10=w[4][l]+fx[l]*(w[5][l]-w[4][l]);
+      v11=w[6][l]+fx[l]*(w[7][l]-w[6][l]);
+
+      v0=v00+fy[l]*(v01-v00);
+      v1=v10+fy[l]*(v11-v10);
+
+      v[l]=v0+fz[l]*(v1-v0);
+      }
+
+   // accumulate the valid samples
+   if (mode==MPR_MIP)
+      for (l=0; l<MPRPACKET; l++)
+         acc[l]=(valid[l] && v[l]>acc[l])?v[l]:acc[l];
+   else if (mode==MPR_MINIP)
+      for (l=0; l<MPRPACKET; l++)
+         acc[l]=(valid[l] && v[l]<acc[l])?v[l]:acc[l];
+   else
+      for (l=0; l<MPRPACKET; l++)
+         acc[l]+=valid[l]?v[l]:0.0f;
+
+   for (l=0; l<MPRPACKET; l++) cnt[l]+=valid[l];
+   }
+
+// resample one image row in packets of pixels
+void mpr::resamplerow(int j,void *data)
+   {
+   int i,k,l,n;
+
+   plane *s=(plane *)data;
+   mpr *e=s->engine;
+
+   float px,py,pz;
+   float ox,oy,oz;
+   float o;
+
+   float x[MPRPACKET],y[MPRPACKET],z[MPRPACKET];
+   float sx[MPRPACKET],sy[MPRPACKET],sz[MPRPACKET];
+   float acc[MPRPACKET],v;
+   int cnt[MPRPACKET];
+
+   float scale,maxval;
+   unsigned int q;
+
+   unsigned char *ptr;
+
+   // first pixel of the row
+   px=s->cx-0.5f*(s->width-1)*s->ux+(0.5f*(s->height-1)-j)*s->vx;
+   py=s->cy-0.5f*(s->width-1)*s->uy+(0.5f*(s->height-1)-j)*s->vy;
+   pz=s->cz-0.5f*(s->width-1)*s->uz+(0.5f*(s->height-1)-j)*s->vz;
+
+   // output scaling (2-byte images have a maximum value of 32767)
+   if (s->bytes==1)
+      {
+      scale=(e->COMPONENTS==1)?1.0f:1.0f/257.0f;
+      maxval=255.0f;
+      }
+   else
+      {
+      scale=(e->COMPONENTS==1)?32767.0f/255.0f:32767.0f/65535.0f;
+      maxval=32767.0f;
+      }
+
+   ptr=&s->image[(long long)j*s->width*s->bytes];
+
+   for (i=0; i<s->width; i+=MPRPACKET)
+      {
+      n=s->width-i;
+      if (n>MPRPACKET) n=MPRPACKET;
+
+      for (l=0; l<MPRPACKET; l++)
+         {
+         x[l]=px+(i+l)*s->ux;
+         y[l]=py+(i+l)*s->uy;
+         z[l]=pz+(i+l)*s->uz;
+
+         acc[l]=(s->mode==MPR_MINIP)?MAXFLOAT:0.0f;
+         cnt[l]=0;
+         }
+
+      // accumulate the samples across the slab
+      for (k=0; k<s->samples; k++)
+         {
+         o=k-0.5f*(s->samples-1);
+
+         ox=o*s->nx;
+         oy=o*s->ny;
+         oz=o*s->nz;
+
+         for (l=0; l<MPRPACKET; l++)
+            {
+            sx[l]=x[l]+ox;
+            sy[l]=y[l]+oy;
+            sz[l]=z[l]+oz;
+            }
+
+         e->samplepacket(sx,sy,sz,s->mode,acc,cnt);
+         }
+
+      for (l=0; l<n; l++)
+         {
+         if (cnt[l]==0) v=0.0f;
+         else if (s->mode==MPR_SLICE || s->mode==MPR_AVERAGE) v=acc[l]/cnt[l];
+         else v=acc[l];
+
+         v=v*scale+0.5f;
+
+         q=(unsigned int)((v<maxval)?v:maxval);
+
+         if (s->bytes==1) *ptr++=q;
+         else
+            {
+            *ptr++=q>>8;
+            *ptr++=q&255;
+            }
+         }
+      }
+   }
+
+// resample an oblique slice
+void mpr::resample(float cx,float cy,float cz,
+                   float ux,float uy,float uz,
+                   float vx,float vy,float vz,
+                   float nx,float ny,float nz,
+                   int samples,int mode,
+                   int width,int height,
+                   unsigned char *image,int bytes)
+   {
+   plane s;
+
+   if (DATA==NULL) ERRORMSG();
+   if (WIDTH<2 || HEIGHT<2 || DEPTH<2) ERRORMSG();
+   if (bytes!=1 && bytes!=2) ERRORMSG();
+
+   if (width<=0 || height<=0) return;
+
+   if (samples<1 || mode==MPR_SLICE) samples=1;
+
+   s.engine=this;
+
+   s.cx=cx; s.cy=cy; s.cz=cz;
+   s.ux=ux; s.uy=uy; s.uz=uz;
+   s.vx=vx; s.vy=vy; s.vz=vz;
+   s.nx=nx; s.ny=ny; s.nz=nz;
+
+   s.samples=samples;
+   s.mode=mode;
+
+   s.width=width;
+   s.height=height;
+   s.image=image;
+   s.bytes=bytes;
+
+   // rows are distributed over the worker threads
+   parallelfor(height,resamplerow,&s);
+   }
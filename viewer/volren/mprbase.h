@@ -0,0 +1,82 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#ifndef MPRBASE_H
+#define MPRBASE_H
+
+#include "codebase.h" // universal code base
+
+// slab modes
+#define MPR_SLICE 0 // single slice
+#define MPR_MIP 1 // maximum intensity projection
+#define MPR_MINIP 2 // minimum intensity projection
+#define MPR_AVERAGE 3 // average intensity projection
+
+#define MPRPACKET 8 // pixels per sampling packet
+
+// a cpu multi-planar reconstruction engine
+class mpr
+   {
+   public:
+
+   // default constructor
+   mpr();
+
+   // destructor
+   ~mpr();
+
+   // set the volume data with 1 or 2 bytes per voxel (msb first)
+   // the data is referenced, not copied
+   void set_data(const unsigned char *data,
+                 long long width,long long height,long long depth,
+                 unsigned int components=1);
+
+   // resample an oblique slice in voxel coordinates
+   // the slice is centered at c and spanned by the pixel steps u and v
+   // the slab consists of the given number of samples spaced by n
+   // the image is written top-down with 1 or 2 bytes per pixel (msb first)
+   // 2-byte pixels range up to 32767 as written by writePNMimage
+   void resample(float cx,float cy,float cz,
+                 float ux,float uy,float uz,
+                 float vx,float vy,float vz,
+                 float nx,float ny,float nz,
+                 int samples,int mode,
+                 int width,int height,
+                 unsigned char *image,int bytes=1);
+
+   // calculate orthonormal in-plane axes for a plane normal
+   // axial planes yield the x- and y-axis
+   static void axes(float nx,float ny,float nz,
+                    float *ux,float *uy,float *uz,
+                    float *vx,float *vy,float *vz);
+
+   protected:
+
+   const unsigned char *DATA;
+   long long WIDTH,HEIGHT,DEPTH;
+   unsigned int COMPONENTS;
+
+   private:
+
+   struct plane
+      {
+      mpr *engine;
+
+      float cx,cy,cz;
+      float ux,uy,uz;
+      float vx,vy,vz;
+      float nx,ny,nz;
+
+      int samples,mode;
+
+      int width,height;
+      unsigned char *image;
+      int bytes;
+      };
+
+   static void resamplerow(int j,void *data);
+
+   void samplepacket(const float *x,const float *y,const float *z,
+                     int mode,float *acc,int *cnt);
+   };
+
+#endif
@@ -9,11 +9,41 @@
 static void initwglprocs()
    {
    if ((glTexImage3DEXT=(PFNGLTEXIMAGE3DEXTPROC)wglGetProcAddress("glTexImage3DEXT"))==NULL) ERRORMSG();
+   if ((glTexSubImage3DEXT=(PFNGLTEXSUBIMAGE3DEXTPROC)wglGetProcAddress("glTexSubImage3DEXT"))==NULL) ERRORMSG();
 
 #ifdef GL_ARB_multitexture
    if ((glActiveTextureARB=(PFNGLACTIVETEXTUREARBPROC)wglGetProcAddress("glActiveTextureARB"))==NULL) ERRORMSG();
    if ((glMultiTexCoord3fARB=(PFNGLMULTITEXCOORD3FARBPROC)wglGetProcAddress("glMultiTexCoord3fARB"))==NULL) ERRORMSG();
    if ((glMultiTexCoord4fARB=(PFNGLMULTITEXCOORD4FARBPROC)wglGetProcAddress("glMultiTexCoord4fARB"))==NULL) ERRORMSG();
+   if ((glClientActiveTextureARB=(PFNGLCLIENTACTIVETEXTUREARBPROC)wglGetProcAddress("glClientActiveTextureARB"))==NULL) ERRORMSG();
+#endif
+
+#ifdef GL_ARB_vertex_buffer_object
+   glGenBuffersARB=(PFNGLGENBUFFERSARBPROC)wglGetProcAddress("glGenBuffersARB");
+   glBindBufferARB=(PFNGLBINDBUFFERARBPROC)wglGetProcAddress("glBindBufferARB");
+   glBufferDataARB=(PFNGLBUFFERDATAARBPROC)wglGetProcAddress("glBufferDataARB");
+   glBufferSubDataARB=(PFNGLBUFFERSUBDATAARBPROC)wglGetProcAddress("glBufferSubDataARB");
+   glDeleteBuffersARB=(PFNGLDELETEBUFFERSARBPROC)wglGetProcAddress("glDeleteBuffersARB");
+
+   if (!(glGenBuffersARB && glBindBufferARB && glBufferDataARB && glBufferSubDataARB &&
+         glDeleteBuffersARB)) WARNMSG("vbo unsupported");
+#endif
+
+#ifdef GL_ARB_occlusion_query
+   glGenQueriesARB=(PFNGLGENQUERIESARBPROC)wglGetProcAddress("glGenQueriesARB");
+   glBeginQueryARB=(PFNGLBEGINQUERYARBPROC)wglGetProcAddress("glBeginQueryARB");
+   glEndQueryARB=(PFNGLENDQUERYARBPROC)wglGetProcAddress("glEndQueryARB");
+   glGetQueryObjectuivARB=(PFNGLGETQUERYOBJECTUIVARBPROC)wglGetProcAddress("glGetQueryObjectuivARB");
+   glDeleteQueriesARB=(PFNGLDELETEQUERIESARBPROC)wglGetProcAddress("glDeleteQueriesARB");
+
+   if (!(glGenQueriesARB && glBeginQueryARB && glEndQueryARB && glGetQueryObjectuivARB &&
+         glDeleteQueriesARB)) WARNMSG("occlusion queries unsupported");
+#endif
+
+#ifdef GL_EXT_blend_minmax
+   glBlendEquationEXT=(PFNGLBLENDEQUATIONEXTPROC)wglGetProcAddress("glBlendEquationEXT");
+
+   if (!glBlendEquationEXT) WARNMSG("min/max blending unsupported");
 #endif
 
 #ifdef GL_ARB_fragment_program
@@ -25,6 +55,30 @@ static void initwglprocs()
    if ((glDeleteProgramsARB=(PFNGLDELETEPROGRAMSARBPROC)wglGetProcAddress("glDeleteProgramsARB"))==NULL) ERRORMSG();
 #endif
 
+#ifdef GL_VERSION_2_0
+   glCreateShader=(PFNGLCREATESHADERPROC)wglGetProcAddress("glCreateShader");
+   glShaderSource=(PFNGLSHADERSOURCEPROC)wglGetProcAddress("glShaderSource");
+   glCompileShader=(PFNGLCOMPILESHADERPROC)wglGetProcAddress("glCompileShader");
+   glGetShaderiv=(PFNGLGETSHADERIVPROC)wglGetProcAddress("glGetShaderiv");
+   glGetShaderInfoLog=(PFNGLGETSHADERINFOLOGPROC)wglGetProcAddress("glGetShaderInfoLog");
+   glDeleteShader=(PFNGLDELETESHADERPROC)wglGetProcAddress("glDeleteShader");
+   glCreateProgram=(PFNGLCREATEPROGRAMPROC)wglGetProcAddress("glCreateProgram");
+   glAttachShader=(PFNGLATTACHSHADERPROC)wglGetProcAddress("glAttachShader");
+   glLinkProgram=(PFNGLLINKPROGRAMPROC)wglGetProcAddress("glLinkProgram");
+   glGetProgramiv=(PFNGLGETPROGRAMIVPROC)wglGetProcAddress("glGetProgramiv");
+   glGetProgramInfoLog=(PFNGLGETPROGRAMINFOLOGPROC)wglGetProcAddress("glGetProgramInfoLog");
+   glUseProgram=(PFNGLUSEPROGRAMPROC)wglGetProcAddress("glUseProgram");
+   glDeleteProgram=(PFNGLDELETEPROGRAMPROC)wglGetProcAddress("glDeleteProgram");
+   glGetUniformLocation=(PFNGLGETUNIFORMLOCATIONPROC)wglGetProcAddress("glGetUniformLocation");
+   glUniform1i=(PFNGLUNIFORM1IPROC)wglGetProcAddress("glUniform1i");
+   glUniform4f=(PFNGLUNIFORM4FPROC)wglGetProcAddress("glUniform4f");
+
+   if (!(glCreateShader && glShaderSource && glCompileShader && glGetShaderiv &&
+         glGetShaderInfoLog && glDeleteShader && glCreateProgram && glAttachShader &&
+         glLinkProgram && glGetProgramiv && glGetProgramInfoLog && glUseProgram &&
+         glDeleteProgram && glGetUniformLocation && glUniform1i && glUniform4f)) WARNMSG("glsl unsupported");
+#endif
+
 #ifdef GL_EXT_framebuffer_object
    glGenFramebuffersEXT                     = (PFNGLGENFRAMEBUFFERSPROC)wglGetProcAddress("glGenFramebuffers");
    glDeleteFramebuffersEXT                  = (PFNGLDELETEFRAMEBUFFERSPROC)wglGetProcAddress("glDeleteFramebuffers");
@@ -125,11 +179,33 @@ void initogl()
 #ifdef WINOS
 
 PFNGLTEXIMAGE3DEXTPROC glTexImage3DEXT=NULL;
+PFNGLTEXSUBIMAGE3DEXTPROC glTexSubImage3DEXT=NULL;
 
 #ifdef GL_ARB_multitexture
 PFNGLACTIVETEXTUREARBPROC glActiveTextureARB=NULL;
 PFNGLMULTITEXCOORD3FARBPROC glMultiTexCoord3fARB=NULL;
 PFNGLMULTITEXCOORD4FARBPROC glMultiTexCoord4fARB=NULL;
+PFNGLCLIENTACTIVETEXTUREARBPROC glClientActiveTextureARB=NULL;
+#endif
+
+#ifdef GL_ARB_vertex_buffer_object
+PFNGLGENBUFFERSARBPROC glGenBuffersARB=NULL;
+PFNGLBINDBUFFERARBPROC glBindBufferARB=NULL;
+PFNGLBUFFERDATAARBPROC glBufferDataARB=NULL;
+PFNGLBUFFERSUBDATAARBPROC glBufferSubDataARB=NULL;
+PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB=NULL;
+#endif
+
+#ifdef GL_ARB_occlusion_query
+PFNGLGENQUERIESARBPROC glGenQueriesARB=NULL;
+PFNGLBEGINQUERYARBPROC glBeginQueryARB=NULL;
+PFNGLENDQUERYARBPROC glEndQueryARB=NULL;
+PFNGLGETQUERYOBJECTUIVARBPROC glGetQueryObjectuivARB=NULL;
+PFNGLDELETEQUERIESARBPROC glDeleteQueriesARB=NULL;
+#endif
+
+#ifdef GL_EXT_blend_minmax
+PFNGLBLENDEQUATIONEXTPROC glBlendEquationEXT=NULL;
 #endif
 
 #ifdef GL_ARB_fragment_program
@@ -141,6 +217,25 @@ PFNGLPROGRAMENVPARAMETER4FARBPROC glProgramEnvParameter4fARB=NULL;
 PFNGLDELETEPROGRAMSARBPROC glDeleteProgramsARB=NULL;
 #endif
 
+#ifdef GL_VERSION_2_0
+PFNGLCREATESHADERPROC glCreateShader=NULL;
+PFNGLSHADERSOURCEPROC glShaderSource=NULL;
+PFNGLCOMPILESHADERPROC glCompileShader=NULL;
+PFNGLGETSHADERIVPROC glGetShaderiv=NULL;
+PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog=NULL;
+PFNGLDELETESHADERPROC glDeleteShader=NULL;
+PFNGLCREATEPROGRAMPROC glCreateProgram=NULL;
+PFNGLATTACHSHADERPROC glAttachShader=NULL;
+PFNGLLINKPROGRAMPROC glLinkProgram=NULL;
+PFNGLGETPROGRAMIVPROC glGetProgramiv=NULL;
+PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog=NULL;
+PFNGLUSEPROGRAMPROC glUseProgram=NULL;
+PFNGLDELETEPROGRAMPROC glDeleteProgram=NULL;
+PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation=NULL;
+PFNGLUNIFORM1IPROC glUniform1i=NULL;
+PFNGLUNIFORM4FPROC glUniform4f=NULL;
+#endif
+
 #ifdef GL_EXT_framebuffer_object
 PFNGLGENFRAMEBUFFERSPROC                     glGenFramebuffersEXT = 0;                      // FBO name generation procedure
 PFNGLDELETEFRAMEBUFFERSPROC                  glDeleteFramebuffersEXT = 0;                   // FBO deletion procedure
@@ -52,6 +52,9 @@
 #ifndef glTexImage3D
 #define glTexImage3D glTexImage3DEXT
 #endif
+#ifndef glTexSubImage3D
+#define glTexSubImage3D glTexSubImage3DEXT
+#endif
 #endif
 
 // OpenGL 3.3 workaround:
@@ -72,11 +75,33 @@ void invertbuffer();
 #ifdef WINOS
 
 extern PFNGLTEXIMAGE3DEXTPROC glTexImage3DEXT;
+extern PFNGLTEXSUBIMAGE3DEXTPROC glTexSubImage3DEXT;
 
 #ifdef GL_ARB_multitexture
 extern PFNGLACTIVETEXTUREARBPROC glActiveTextureARB;
 extern PFNGLMULTITEXCOORD3FARBPROC glMultiTexCoord3fARB;
 extern PFNGLMULTITEXCOORD4FARBPROC glMultiTexCoord4fARB;
+extern PFNGLCLIENTACTIVETEXTUREARBPROC glClientActiveTextureARB;
+#endif
+
+#ifdef GL_ARB_vertex_buffer_object
+extern PFNGLGENBUFFERSARBPROC glGenBuffersARB;
+extern PFNGLBINDBUFFERARBPROC glBindBufferARB;
+extern PFNGLBUFFERDATAARBPROC glBufferDataARB;
+extern PFNGLBUFFERSUBDATAARBPROC glBufferSubDataARB;
+extern PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB;
+#endif
+
+#ifdef GL_ARB_occlusion_query
+extern PFNGLGENQUERIESARBPROC glGenQueriesARB;
+extern PFNGLBEGINQUERYARBPROC glBeginQueryARB;
+extern PFNGLENDQUERYARBPROC glEndQueryARB;
+extern PFNGLGETQUERYOBJECTUIVARBPROC glGetQueryObjectuivARB;
+extern PFNGLDELETEQUERIESARBPROC glDeleteQueriesARB;
+#endif
+
+#ifdef GL_EXT_blend_minmax
+extern PFNGLBLENDEQUATIONEXTPROC glBlendEquationEXT;
 #endif
 
 #ifdef GL_ARB_fragment_program
@@ -88,6 +113,25 @@ extern PFNGLPROGRAMENVPARAMETER4FARBPROC glProgramEnvParameter4fARB;
 extern PFNGLDELETEPROGRAMSARBPROC glDeleteProgramsARB;
 #endif
 
+#ifdef GL_VERSION_2_0
+extern PFNGLCREATESHADERPROC glCreateShader;
+extern PFNGLSHADERSOURCEPROC glShaderSource;
+extern PFNGLCOMPILESHADERPROC glCompileShader;
+extern PFNGLGETSHADERIVPROC glGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
+extern PFNGLDELETESHADERPROC glDeleteShader;
+extern PFNGLCREATEPROGRAMPROC glCreateProgram;
+extern PFNGLATTACHSHADERPROC glAttachShader;
+extern PFNGLLINKPROGRAMPROC glLinkProgram;
+extern PFNGLGETPROGRAMIVPROC glGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC glUseProgram;
+extern PFNGLDELETEPROGRAMPROC glDeleteProgram;
+extern PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+extern PFNGLUNIFORM1IPROC glUniform1i;
+extern PFNGLUNIFORM4FPROC glUniform4f;
+#endif
+
 #ifdef GL_EXT_framebuffer_object
 extern PFNGLGENFRAMEBUFFERSPROC                     glGenFramebuffersEXT;
 extern PFNGLDELETEFRAMEBUFFERSPROC                  glDeleteFramebuffersEXT;
@@ -71,3 +71,59 @@ MOV result.color, fragment.color.primary;\n\
 \n\
 END\n\
 ";
+
+char screen_vtxprg[]=
+"\
+void main()\n\
+   {\n\
+   gl_TexCoord[0]=gl_MultiTexCoord0;\n\
+   gl_Position=ftransform();\n\
+   }\n\
+";
+
+char downsample_frgprg[]=
+"\
+uniform sampler2D depth; // native depth\n\
+\n\
+void main()\n\
+   {\n\
+   // write the native depth into the reduced depth buffer\n\
+   gl_FragDepth=texture2D(depth,gl_TexCoord[0].xy).x;\n\
+   }\n\
+";
+
+char upsample_frgprg[]=
+"\
+uniform sampler2D col; // reduced color\n\
+uniform sampler2D lowdepth; // reduced depth\n\
+uniform sampler2D depth; // native depth\n\
+uniform vec4 size; // reduced size and its reciprocal\n\
+\n\
+void main()\n\
+   {\n\
+   vec2 tc=gl_TexCoord[0].xy;\n\
+   float z=texture2D(depth,tc).x;\n\
+\n\
+   // the four nearest reduced texels\n\
+   vec2 p=tc*size.xy-0.5;\n\
+   vec2 f=fract(p);\n\
+   vec2 b=(floor(p)+0.5)*size.zw;\n\
+\n\
+   vec4 acc=vec4(0.0);\n\
+   float sum=0.0;\n\
+\n\
+   // bilinear weights attenuated by the depth difference\n\
+   for (int j=0; j<2; j++)\n\
+      for (int i=0; i<2; i++)\n\
+         {\n\
+         vec2 c=b+vec2(float(i),float(j))*size.zw;\n\
+         float w=mix(1.0-f.x,f.x,float(i))*mix(1.0-f.y,f.y,float(j));\n\
+         float dz=texture2D(lowdepth,c).x-z;\n\
+         w*=1.0/(1.0E-3+abs(dz));\n\
+         acc+=w*texture2D(col,c);\n\
+         sum+=w;\n\
+         }\n\
+\n\
+   gl_FragColor=acc/max(sum,1.0E-7);\n\
+   }\n\
+";
@@ -4,15 +4,26 @@ char inline_prog1[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the back of the slab\n\
 TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the front of the slab\n\
+MAD_SAT tmp.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
 \n\
 # dependent 2D texture lookup\n\
 TEX col, tmp, texture[3], 2D;   # perform 2D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -23,7 +34,7 @@ char inline_prog1sfx[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # stereo interlacing\n\
 MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
@@ -34,10 +45,21 @@ KIL tmp.xyxy;\n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the back of the slab\n\
 TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the front of the slab\n\
+MAD_SAT tmp.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
 \n\
 # dependent 2D texture lookup\n\
 TEX col, tmp, texture[3], 2D;   # perform 2D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -48,15 +70,26 @@ char inline_prog2[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # get data from 3D texture\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the mid of the slab\n\
+MAD_SAT tmp.x, tmp.x, program.env[5].x, program.env[5].y;   # map the scalar value into the window\n\
 \n\
 # dependent 1D texture lookup\n\
 MOV tmp.y, 0.5;\n\
 TEX col, tmp, texture[3], 2D;   # perform 1D dependent texture lookup in transfer function\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -67,7 +100,7 @@ char inline_prog2sfx[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # stereo interlacing\n\
 MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
@@ -77,11 +110,22 @@ KIL tmp.xyxy;\n\
 \n\
 # get data from 3D texture\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the mid of the slab\n\
+MAD_SAT tmp.x, tmp.x, program.env[5].x, program.env[5].y;   # map the scalar value into the window\n\
 \n\
 # dependent 1D texture lookup\n\
 MOV tmp.y, 0.5;\n\
 TEX col, tmp, texture[3], 2D;   # perform 1D dependent texture lookup in transfer function\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -92,15 +136,26 @@ char inline_prog3[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the mid of the slab\n\
+MAD_SAT tmp.x, tmp.x, program.env[5].x, program.env[5].y;   # map the scalar value into the window\n\
 TEX tmp.y, fragment.texcoord[1], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
 \n\
 # dependent 2D texture lookup\n\
 TEX col, tmp, texture[3], 2D;   # perform 2D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -111,7 +166,7 @@ char inline_prog3sfx[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # stereo interlacing\n\
 MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
@@ -121,11 +176,22 @@ KIL tmp.xyxy;\n\
 \n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the mid of the slab\n\
+MAD_SAT tmp.x, tmp.x, program.env[5].x, program.env[5].y;   # map the scalar value into the window\n\
 TEX tmp.y, fragment.texcoord[1], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
 \n\
 # dependent 2D texture lookup\n\
 TEX col, tmp, texture[3], 2D;   # perform 2D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -136,16 +202,27 @@ char inline_prog4[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the back of the slab\n\
 TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the front of the slab\n\
 TEX tmp.z, fragment.texcoord[2], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
+MAD_SAT tmp.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
 \n\
 # dependent 3D texture lookup\n\
 TEX col, tmp, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -156,7 +233,7 @@ char inline_prog4sfx[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # stereo interlacing\n\
 MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
@@ -168,10 +245,21 @@ KIL tmp.xyxy;\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the back of the slab\n\
 TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the front of the slab\n\
 TEX tmp.z, fragment.texcoord[2], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
+MAD_SAT tmp.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
 \n\
 # dependent 3D texture lookup\n\
 TEX col, tmp, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
 \n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
+\n\
 # write to output register\n\
 MUL result.color, col, fragment.color.primary;   # attenuate with primary color\n\
 \n\
@@ -182,7 +270,7 @@ char inline_prog5[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # get data from 3D textures\n\
 TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value at the back of the slab\n\
@@ -190,7 +278,19 @@ TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the
 TEX tmp.z, fragment.texcoord[2], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
 \n\
 # dependent 3D texture lookup\n\
-TEX col, tmp, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
+MAD_SAT col.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
+MOV col.z, tmp.z;\n\
+TEX col, col, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
+\n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
 \n\
 # compute the diffuse and specular illumination factors of a head light\n\
 SUB tmp.x, tmp.x, tmp.y;              # calculate frontal gradient (not yet normalized)\n\
@@ -216,7 +316,7 @@ char inline_prog5sfx[]=
 "\
 !!ARBfp1.0\n\
 \n\
-TEMP tmp, col;\n\
+TEMP tmp, col, cor;\n\
 \n\
 # stereo interlacing\n\
 MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
@@ -230,7 +330,19 @@ TEX tmp.y, fragment.texcoord[1], texture[0], 3D;   # get the scalar value at the
 TEX tmp.z, fragment.texcoord[2], texture[1], 3D;   # get the gradient magnitude at the mid of the slab\n\
 \n\
 # dependent 3D texture lookup\n\
-TEX col, tmp, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
+MAD_SAT col.xy, tmp, program.env[5].x, program.env[5].y;   # map the scalar values into the window\n\
+MOV col.z, tmp.z;\n\
+TEX col, col, texture[3], 3D;   # perform 3D dependent texture lookup in pre-integration table\n\
+\n\
+# scale the emission and correct the opacity of slab-independent tables\n\
+MUL cor, col, program.env[4];        # optical depth in powers of two\n\
+EX2 cor.x, -cor.x;\n\
+EX2 cor.y, -cor.y;\n\
+EX2 cor.z, -cor.z;\n\
+EX2 cor.w, -cor.w;\n\
+MUL_SAT col, col, program.env[3];    # emission scaled by the slab thickness\n\
+ADD col, col, 1.0;\n\
+SUB col, col, cor;                   # opacity of the absorbing channels\n\
 \n\
 # compute the diffuse and specular illumination factors of a head light\n\
 SUB tmp.x, tmp.x, tmp.y;              # calculate frontal gradient (not yet normalized)\n\
@@ -252,5 +364,54 @@ MUL result.color, col, fragment.color.primary;   # attenuate with primary color\
 END\n\
 ";
 
-char *inline_prog[10]={inline_prog1,inline_prog2,inline_prog3,inline_prog4,inline_prog5,
-                       inline_prog1sfx,inline_prog2sfx,inline_prog3sfx,inline_prog4sfx,inline_prog5sfx};
+char inline_prog6[]=
+"\
+!!ARBfp1.0\n\
+\n\
+TEMP tmp;\n\
+\n\
+# get data from 3D texture\n\
+TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value\n\
+\n\
+# discard samples below the window\n\
+SUB tmp.x, tmp.x, program.env[0].x;   # subtract the window minimum\n\
+KIL tmp.xxxx;\n\
+MUL_SAT tmp.x, tmp.x, program.env[0].y;   # scale with the reciprocal window width\n\
+\n\
+# write to output register\n\
+MAD result.color.rgb, tmp.x, program.env[1].x, program.env[1].y;   # apply intensity scale and bias\n\
+MOV result.color.a, program.env[1].z;                               # apply opacity\n\
+\n\
+END\n\
+";
+
+char inline_prog6sfx[]=
+"\
+!!ARBfp1.0\n\
+\n\
+TEMP tmp;\n\
+\n\
+# stereo interlacing\n\
+MAD tmp.xy, fragment.position, program.env[2], program.env[2].zwxy;\n\
+FRC tmp.xy, tmp;\n\
+SUB tmp.xy, tmp, 0.5;\n\
+KIL tmp.xyxy;\n\
+\n\
+# get data from 3D texture\n\
+TEX tmp.x, fragment.texcoord[0], texture[0], 3D;   # get the scalar value\n\
+\n\
+# discard samples below the window\n\
+SUB tmp.x, tmp.x, program.env[0].x;   # subtract the window minimum\n\
+KIL tmp.xxxx;\n\
+MUL_SAT tmp.x, tmp.x, program.env[0].y;   # scale with the reciprocal window width\n\
+\n\
+# write to output register\n\
+MAD result.color.rgb, tmp.x, program.env[1].x, program.env[1].y;   # apply intensity scale and bias\n\
+MOV result.color.a, program.env[1].z;                               # apply opacity\n\
+\n\
+END\n\
+";
+
+char *inline_prog[12]={inline_prog1,inline_prog2,inline_prog3,inline_prog4,inline_prog5,
+                       inline_prog1sfx,inline_prog2sfx,inline_prog3sfx,inline_prog4sfx,inline_prog5sfx,
+                       inline_prog6,inline_prog6sfx};
@@ -0,0 +1,165 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+// the ray casting shaders are compiled with RAYMODE defined as:
+// 0 = 1D tf, 1 = pre-integrated 1D tf,
+// 2 = 2D tf, 3 = pre-integrated 2D tf, 4 = pre-integrated 2D tf with lighting
+// the texture units and matrices are the same as for the slicing fragment programs
+
+char ray_vtxprg[]=
+"\
+varying vec3 pos;\n\
+\n\
+void main()\n\
+   {\n\
+   // pass the world position of the proxy geometry\n\
+   pos=gl_Vertex.xyz;\n\
+   gl_Position=ftransform();\n\
+   }\n\
+";
+
+char ray_frgprg[]=
+"\
+uniform sampler3D vol; // scalar data\n\
+uniform sampler3D grad; // gradient magnitude\n\
+\n\
+#if RAYMODE>=3\n\
+#define GRADUNIT 2\n\
+uniform sampler3D tf; // pre-integrated 2D tf\n\
+#else\n\
+#define GRADUNIT 1\n\
+uniform sampler2D tf; // 1D tf, pre-integrated 1D tf or 2D tf\n\
+#endif\n\
+\n\
+uniform vec4 eye; // eye point and near plane distance\n\
+uniform vec4 dir; // viewing direction and slab thickness\n\
+uniform vec4 boxmin; // minimum corner of visible tile\n\
+uniform vec4 boxmax; // maximum corner of visible tile\n\
+uniform vec4 param; // termination threshold, number of clip planes, reciprocal slab thickness, noise\n\
+uniform vec4 light; // ambient, diffuse, specular and specular exponent\n\
+uniform vec4 sfx; // stereo interlacing\n\
+uniform vec4 tflin; // linear scaling of the tf channels\n\
+uniform vec4 tfexp; // exponential scaling of the tf channels\n\
+uniform vec4 window; // scale and bias of the windowing transform\n\
+uniform sampler2D occ; // opacity composited in front of the tile\n\
+uniform vec4 occwin; // window origin and reciprocal size of the opacity (0=none)\n\
+\n\
+varying vec3 pos;\n\
+\n\
+const int maxsteps=4096;\n\
+\n\
+// scale the emission and correct the opacity of slab-independent tables\n\
+vec4 tfcorr(vec4 col)\n\
+   {return(clamp(col*tflin,0.0,1.0)+1.0-exp2(-col*tfexp));}\n\
+\n\
+// map a scalar value into the window of the tf\n\
+float win(float s)\n\
+   {return(clamp(s*window.x+window.y,0.0,1.0));}\n\
+\n\
+void main()\n\
+   {\n\
+   int i;\n\
+\n\
+   // stereo interlacing\n\
+   vec2 il=fract(gl_FragCoord.xy*sfx.xy+sfx.zw)-0.5;\n\
+   if (il.x<0.0 || il.y<0.0) discard;\n\
+\n\
+   // ray through the fragment\n\
+   vec3 r=pos-eye.xyz;\n\
+   r+=vec3(equal(r,vec3(0.0)))*1.0E-7;\n\
+\n\
+   // view depth per unit ray parameter\n\
+   float rd=dot(r,dir.xyz);\n\
+   if (rd<=0.0) discard;\n\
+\n\
+   // intersect ray with visible tile\n\
+   vec3 t1=(boxmin.xyz-eye.xyz)/r;\n\
+   vec3 t2=(boxmax.xyz-eye.xyz)/r;\n\
+   vec3 tn=min(t1,t2);\n\
+   vec3 tx=max(t1,t2);\n\
+   float tin=max(max(tn.x,tn.y),max(tn.z,0.0));\n\
+   float tout=min(min(tx.x,tx.y),tx.z);\n\
+\n\
+   // clip ray against the user clip planes\n\
+   for (i=0; i<6; i++)\n\
+      if (float(i)<param.y)\n\
+         {\n\
+         vec4 p=gl_ClipPlane[i]*gl_ModelViewMatrix;\n\
+         float a=dot(p.xyz,eye.xyz)+p.w;\n\
+         float b=dot(p.xyz,r);\n\
+         if (b>0.0) tin=max(tin,-a/b);\n\
+         else if (b<0.0) tout=min(tout,-a/b);\n\
+         else if (a<0.0) discard;\n\
+         }\n\
+\n\
+   // depth range of ray segment\n\
+   float slab=dir.w;\n\
+   float din=max(tin*rd,eye.w);\n\
+   float dout=tout*rd;\n\
+\n\
+   // first slice plane behind the entry point (same planes as the slicer)\n\
+   float d=(ceil((din-eye.w)/slab-0.5)+0.5)*slab+eye.w;\n\
+   if (d>=dout) discard;\n\
+\n\
+   // ray in texture space parameterized by view depth\n\
+   vec3 rs=r/rd;\n\
+   vec3 tc0=(gl_TextureMatrix[0]*vec4(eye.xyz,1.0)).xyz;\n\
+   vec3 tcd=(gl_TextureMatrix[0]*vec4(rs,0.0)).xyz;\n\
+#if RAYMODE>=2\n\
+   vec3 gc0=(gl_TextureMatrix[GRADUNIT]*vec4(eye.xyz,1.0)).xyz;\n\
+   vec3 gcd=(gl_TextureMatrix[GRADUNIT]*vec4(rs,0.0)).xyz;\n\
+#endif\n\
+\n\
+#if RAYMODE==1 || RAYMODE>=3\n\
+   float sf=texture3D(vol,tc0+tcd*(d-0.5*slab)).x;\n\
+#endif\n\
+\n\
+   // opacity composited in front of the tile by the preceding front-to-back tiles\n\
+   float front=0.0;\n\
+   if (occwin.z>0.0) front=texture2D(occ,(gl_FragCoord.xy-occwin.xy)*occwin.zw).a;\n\
+   if (front>=param.x) discard;\n\
+\n\
+   // the ray terminates once the total opacity reaches the threshold\n\
+   float thres=1.0-(1.0-param.x)/(1.0-front);\n\
+\n\
+   vec4 acc=vec4(0.0);\n\
+\n\
+   // composite front-to-back\n\
+   for (i=0; i<maxsteps; i++)\n\
+      {\n\
+      vec4 col;\n\
+\n\
+#if RAYMODE==0\n\
+      float s=texture3D(vol,tc0+tcd*d).x;\n\
+      col=tfcorr(texture2D(tf,vec2(win(s),0.5)));\n\
+#elif RAYMODE==1\n\
+      float sb=texture3D(vol,tc0+tcd*(d+0.5*slab)).x;\n\
+      col=tfcorr(texture2D(tf,vec2(win(sb),win(sf))));\n\
+      sf=sb;\n\
+#elif RAYMODE==2\n\
+      float s=texture3D(vol,tc0+tcd*d).x;\n\
+      float g=texture3D(grad,gc0+gcd*d).x;\n\
+      col=tfcorr(texture2D(tf,vec2(win(s),g)));\n\
+#else\n\
+      float sb=texture3D(vol,tc0+tcd*(d+0.5*slab)).x;\n\
+      float g=texture3D(grad,gc0+gcd*d).x;\n\
+      col=tfcorr(texture3D(tf,vec3(win(sb),win(sf),g)));\n\
+#if RAYMODE==4\n\
+      // head light from the frontal gradient\n\
+      float x=clamp(abs(sb-sf)*param.z/max(g,param.w),0.0,1.0);\n\
+      col.rgb*=x*light.y+light.x+pow(x,light.w)*light.z;\n\
+#endif\n\
+      sf=sb;\n\
+#endif\n\
+\n\
+      acc+=(1.0-acc.a)*col;\n\
+\n\
+      // early ray termination\n\
+      if (acc.a>=thres) break;\n\
+\n\
+      d+=slab;\n\
+      if (d>=dout) break;\n\
+      }\n\
+\n\
+   gl_FragColor=acc;\n\
+   }\n\
+";
@@ -0,0 +1,847 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#include "codebase.h"
+
+#include "threadbase.h"
+
+#include "raybase.h"
+
+#define RAYMAXSTEPS 4096
+
+// invert a column-major 4x4 matrix
+static BOOLINT invert4(const double m[16],double inv[16])
+   {
+   int i;
+
+   double det;
+
+   inv[0]=m[5]*m[10]*m[15]-m[5]*m[11]*m[14]-m[9]*m[6]*m[15]+m[9]*m[7]*m[14]+m[13]*m[6]*m[11]-m[13]*m[7]*m[10];
+   inv[4]=-m[4]*m[10]*m[15]+m[4]*m[11]*m[14]+m[8]*m[6]*m[15]-m[8]*m[7]*m[14]-m[12]*m[6]*m[11]+m[12]*m[7]*m[10];
+   inv[8]=m[4]*m[9]*m[15]-m[4]*m[11]*m[13]-m[8]*m[5]*m[15]+m[8]*m[7]*m[13]+m[12]*m[5]*m[11]-m[12]*m[7]*m[9];
+   inv[12]=-m[4]*m[9]*m[14]+m[4]*m[10]*m[13]+m[8]*m[5]*m[14]-m[8]*m[6]*m[13]-m[12]*m[5]*m[10]+m[12]*m[6]*m[9];
+   inv[1]=-m[1]*m[10]*m[15]+m[1]*m[11]*m[14]+m[9]*m[2]*m[15]-m[9]*m[3]*m[14]-m[13]*m[2]*m[11]+m[13]*m[3]*m[10];
+   inv[5]=m[0]*m[10]*m[15]-m[0]*m[11]*m[14]-m[8]*m[2]*m[15]+m[8]*m[3]*m[14]+m[12]*m[2]*m[11]-m[12]*m[3]*m[10];
+   inv[9]=-m[0]*m[9]*m[15]+m[0]*m[11]*m[13]+m[8]*m[1]*m[15]-m[8]*m[3]*m[13]-m[12]*m[1]*m[11]+m[12]*m[3]*m[9];
+   inv[13]=m[0]*m[9]*m[14]-m[0]*m[10]*m[13]-m[8]*m[1]*m[14]+m[8]*m[2]*m[13]+m[12]*m[1]*m[10]-m[12]*m[2]*m[9];
+   inv[2]=m[1]*m[6]*m[15]-m[1]*m[7]*m[14]-m[5]*m[2]*m[15]+m[5]*m[3]*m[14]+m[13]*m[2]*m[7]-m[13]*m[3]*m[6];
+   inv[6]=-m[0]*m[6]*m[15]+m[0]*m[7]*m[14]+m[4]*m[2]*m[15]-m[4]*m[3]*m[14]-m[12]*m[2]*m[7]+m[12]*m[3]*m[6];
+   inv[10]=m[0]*m[5]*m[15]-m[0]*m[7]*m[13]-m[4]*m[1]*m[15]+m[4]*m[3]*m[13]+m[12]*m[1]*m[7]-m[12]*m[3]*m[5];
+   inv[14]=-m[0]*m[5]*m[14]+m[0]*m[6]*m[13]+m[4]*m[1]*m[14]-m[4]*m[2]*m[13]-m[12]*m[1]*m[6]+m[12]*m[2]*m[5];
+   inv[3]=-m[1]*m[6]*m[11]+m[1]*m[7]*m[10]+m[5]*m[2]*m[11]-m[5]*m[3]*m[10]-m[9]*m[2]*m[7]+m[9]*m[3]*m[6];
+   inv[7]=m[0]*m[6]*m[11]-m[0]*m[7]*m[10]-m[4]*m[2]*m[11]+m[4]*m[3]*m[10]+m[8]*m[2]*m[7]-m[8]*m[3]*m[6];
+   inv[11]=-m[0]*m[5]*m[11]+m[0]*m[7]*m[9]+m[4]*m[1]*m[11]-m[4]*m[3]*m[9]-m[8]*m[1]*m[7]+m[8]*m[3]*m[5];
+   inv[15]=m[0]*m[5]*m[10]-m[0]*m[6]*m[9]-m[4]*m[1]*m[10]+m[4]*m[2]*m[9]+m[8]*m[1]*m[6]-m[8]*m[2]*m[5];
+
+   det=m[0]*inv[0]+m[1]*inv[4]+m[2]*inv[8]+m[3]*inv[12];
+   if (det==0.0) return(FALSE);
+
+   for (i=0; i<16; i++) inv[i]/=det;
+
+   return(TRUE);
+   }
+
+// unproject a point from normalized device coordinates
+static inline void unproject(const double minv[16],
+                             double x,double y,double z,
+                             double *wx,double *wy,double *wz)
+   {
+   double w;
+
+   w=minv[3]*x+minv[7]*y+minv[11]*z+minv[15];
+
+   *wx=(minv[0]*x+minv[4]*y+minv[8]*z+minv[12])/w;
+   *wy=(minv[1]*x+minv[5]*y+minv[9]*z+minv[13])/w;
+   *wz=(minv[2]*x+minv[6]*y+minv[10]*z+minv[14])/w;
+   }
+
+// fetch a voxel with zero padding outside of the volume
+static inline int fetch(const unsigned char *data,
+                        int width,int height,int depth,
+                        int x,int y,int z)
+   {
+   if (x<0 || x>=width || y<0 || y>=height || z<0 || z>=depth) return(0);
+   return(data[x+(y+(long long)z*height)*width]);
+   }
+
+// trilinear interpolation with zero padding (same as the bricks)
+static inline float sample(const unsigned char *data,
+                           int width,int height,int depth,
+                           float x,float y,float z)
+   {
+   int ix,iy,iz;
+   float fx,fy,fz;
+
+   const unsigned char *ptr;
+   int slice;
+
+   float v00,v01,v10,v11,v0,v1;
+
+   if (x<=-1.0f || y<=-1.0f || z<=-1.0f) return(0.0f);
+   if (x>=width || y>=height || z>=depth) return(0.0f);
+
+   ix=(int)(x+1.0f)-1;
+   iy=(int)(y+1.0f)-1;
+   iz=(int)(z+1.0f)-1;
+
+   fx=x-ix;
+   fy=y-iy;
+   fz=z-iz;
+
+   if (ix>=0 && iy>=0 && iz>=0 && ix<width-1 && iy<height-1 && iz<depth-1)
+      {
+      slice=width*height;
+      ptr=&data[ix+(iy+(long long)iz*height)*width];
+
+      v00=ptr[0]+fx*(ptr[1]-ptr[0]);
+      v01=ptr[width]+fx*(ptr[width+1]-ptr[width]);
+      v10=ptr[slice]+fx*(ptr[slice+1]-ptr[slice]);
+      v11=ptr[slice+width]+fx*(ptr[slice+width+1]-ptr[slice+width]);
+      }
+   else
+      {
+      v00=fetch(data,width,height,depth,ix,iy,iz);
+      v00+=fx*(fetch(data,width,height,depth,ix+1,iy,iz)-v00);
+      v01=fetch(data,width,height,depth,ix,iy+1,iz);
+      v01+=fx*(fetch(data,width,height,depth,ix+1,iy+1,iz)-v01);
+      v10=fetch(data,width,height,depth,ix,iy,iz+1);
+      v10+=fx*(fetch(data,width,height,depth,ix+1,iy,iz+1)-v10);
+      v11=fetch(data,width,height,depth,ix,iy+1,iz+1);
+      v11+=fx*(fetch(data,width,height,depth,ix+1,iy+1,iz+1)-v11);
+      }
+
+   v0=v00+fy*(v01-v00);
+   v1=v10+fy*(v11-v10);
+
+   return((v0+fz*(v1-v0))/255.0f);
+   }
+
+raycaster::raycaster(tfunc2D *tf)
+   {
+   TFUNC=tf;
+
+   LEVELS=0;
+
+   TABLE=NULL;
+   TABRES=0;
+   TABDIM=FALSE;
+
+   IMAGE=NULL;
+   DEPTH=NULL;
+   IMGSIZE=0;
+   }
+
+raycaster::~raycaster()
+   {
+   clear();
+
+   if (TABLE!=NULL) delete[] TABLE;
+
+   if (IMAGE!=NULL) delete[] IMAGE;
+   if (DEPTH!=NULL) delete[] DEPTH;
+   }
+
+// free the data of one pyramid level
+void raycaster::freelevel(int level)
+   {
+   if (LEVEL[level].owned) free(LEVEL[level].data);
+
+   delete[] LEVEL[level].minmax;
+   delete[] LEVEL[level].empty;
+   }
+
+// remove all pyramid levels
+void raycaster::clear()
+   {
+   int i;
+
+   for (i=0; i<LEVELS; i++) freelevel(i);
+
+   LEVELS=0;
+   }
+
+// calculate the value range of one slab of blocks
+void raycaster::calcminmax(int k,void *data)
+   {
+   int i,j;
+   int x,y,z;
+
+   level *lvl=(level *)data;
+
+   int x0,x1,y0,y1,z0,z1;
+
+   unsigned char v,vmin,vmax;
+   const unsigned char *ptr;
+
+   unsigned char *mm;
+
+   z0=k*RAYBLOCK;
+   z1=z0+RAYBLOCK;
+   if (z1>lvl->depth-1) z1=lvl->depth-1;
+
+   for (j=0; j<lvl->by; j++)
+      {
+      y0=j*RAYBLOCK;
+      y1=y0+RAYBLOCK;
+      if (y1>lvl->height-1) y1=lvl->height-1;
+
+      for (i=0; i<lvl->bx; i++)
+         {
+         x0=i*RAYBLOCK;
+         x1=x0+RAYBLOCK;
+         if (x1>lvl->width-1) x1=lvl->width-1;
+
+         vmin=255;
+         vmax=0;
+
+         // the block range includes the neighbouring voxels of the trilinear interpolation
+         for (z=z0; z<=z1; z++)
+            for (y=y0; y<=y1; y++)
+               {
+               ptr=&lvl->data[x0+(y+(long long)z*lvl->height)*lvl->width];
+
+               for (x=x0; x<=x1; x++)
+                  {
+                  v=*ptr++;
+                  if (v<vmin) vmin=v;
+                  if (v>vmax) vmax=v;
+                  }
+               }
+
+         // the boundary blocks also cover the zero padding
+         if (i==0 || j==0 || k==0 || i==lvl->bx-1 || j==lvl->by-1 || k==lvl->bz-1) vmin=0;
+
+         mm=&lvl->minmax[2*(i+(j+k*lvl->by)*lvl->bx)];
+
+         mm[0]=vmin;
+         mm[1]=vmax;
+         }
+      }
+   }
+
+// set the volume data of one pyramid level
+void raycaster::set_level(int level,
+                          unsigned char *data,
+                          long long width,long long height,long long depth,
+                          float mx,float my,float mz,
+                          float sx,float sy,float sz,
+                          int border,
+                          BOOLINT copy)
+   {
+   long long cells,blocks;
+
+   raycaster::level *lvl;
+
+   if (level<0 || level>=RAYLEVELS) return;
+   if (width<2 || height<2 || depth<2) return;
+
+   while (LEVELS<=level)
+      {
+      LEVEL[LEVELS].data=NULL;
+      LEVEL[LEVELS].owned=FALSE;
+      LEVEL[LEVELS].minmax=NULL;
+      LEVEL[LEVELS].empty=NULL;
+      LEVELS++;
+      }
+
+   lvl=&LEVEL[level];
+
+   if (lvl->data!=NULL) freelevel(level);
+
+   cells=width*height*depth;
+
+   if (copy)
+      {
+      if ((lvl->data=(unsigned char *)malloc(cells))==NULL) ERRORMSG();
+      memcpy(lvl->data,data,cells);
+      }
+   else lvl->data=data;
+
+   lvl->owned=copy;
+
+   lvl->width=width;
+   lvl->height=height;
+   lvl->depth=depth;
+
+   // voxels are located at the corners of the bounding box
+   lvl->ox=mx-sx/2.0f;
+   lvl->oy=my-sy/2.0f;
+   lvl->oz=mz-sz/2.0f;
+
+   lvl->fx=(width-1)/sx;
+   lvl->fy=(height-1)/sy;
+   lvl->fz=(depth-1)/sz;
+
+   lvl->border=border;
+
+   lvl->bx=(width-2)/RAYBLOCK+1;
+   lvl->by=(height-2)/RAYBLOCK+1;
+   lvl->bz=(depth-2)/RAYBLOCK+1;
+
+   blocks=(long long)lvl->bx*lvl->by*lvl->bz;
+
+   lvl->minmax=new unsigned char[2*blocks];
+   lvl->empty=new unsigned char[blocks];
+
+   // calculate the block value ranges for empty space skipping
+   parallelfor(lvl->bz,calcminmax,lvl);
+   }
+
+// check whether or not the actual transfer function can be ray casted
+BOOLINT raycaster::check()
+   {
+   if (TFUNC->get_num()!=1) return(FALSE);
+   if (!TFUNC->checkRGBA()) return(FALSE);
+
+   return(TFUNC->get_pre_e()!=NULL || TFUNC->get_pre_fe()!=NULL);
+   }
+
+// copy the pre-integrated table into floating point
+void raycaster::fetchtable()
+   {
+   int i,size;
+
+   unsigned char *pre;
+
+   TABRES=TFUNC->get_res();
+   TABDIM=TFUNC->get_dim();
+
+   WSCALE=TFUNC->get_wscale();
+   WBIAS=TFUNC->get_wbias();
+
+   size=TABDIM?4*TABRES*TABRES:4*TABRES;
+
+   if (TABLE!=NULL) delete[] TABLE;
+   TABLE=new float[size];
+
+   // slab-independent tables are corrected like in the shader
+   if (TFUNC->get_pre_fe()!=NULL)
+      {
+      float *fpre=TFUNC->get_pre_fe();
+
+      float ke=TFUNC->get_ecorr();
+      float ka=TFUNC->get_acorr();
+
+      for (i=0; i<size; i+=4)
+         {
+         TABLE[i]=fmin(fpre[i]*ke,1.0f);
+         TABLE[i+1]=fmin(fpre[i+1]*ke,1.0f);
+         TABLE[i+2]=fmin(fpre[i+2]*ke,1.0f);
+         TABLE[i+3]=1.0f-fexp(-fpre[i+3]*ka);
+         }
+
+      return;
+      }
+
+   pre=TFUNC->get_pre_e();
+
+   for (i=0; i<size; i++) TABLE[i]=pre[i]/255.0f;
+   }
+
+// classify the blocks with respect to the actual transfer function
+void raycaster::classify(level *lvl)
+   {
+   long long i,blocks;
+
+   unsigned char *mm;
+
+   blocks=(long long)lvl->bx*lvl->by*lvl->bz;
+
+   for (mm=lvl->minmax,i=0; i<blocks; i++,mm+=2)
+      lvl->empty[i]=TFUNC->zot(mm[0]/255.0f,mm[1]/255.0f);
+   }
+
+// cast rays through one image tile
+void raycaster::casttile(int i,void *data)
+   {
+   int x,y,l;
+   int x0,y0,x1,y1;
+
+   int px[RAYPACKET],py[RAYPACKET];
+   int n;
+
+   frame *f=(frame *)data;
+
+   x0=(i%f->tilesx)*RAYTILE;
+   y0=(i/f->tilesx)*RAYTILE;
+
+   x1=x0+RAYTILE;
+   y1=y0+RAYTILE;
+
+   if (x1>f->width) x1=f->width;
+   if (y1>f->height) y1=f->height;
+
+   // traverse the tile in packets of 2x2 rays
+   for (y=y0; y<y1; y+=2)
+      for (x=x0; x<x1; x+=2)
+         {
+         n=0;
+
+         for (l=0; l<RAYPACKET; l++)
+            if (x+(l&1)<x1 && y+(l>>1)<y1)
+               {
+               px[n]=x+(l&1);
+               py[n]=y+(l>>1);
+               n++;
+               }
+
+         f->caster->castpacket(f,px,py,n);
+         }
+   }
+
+// cast a packet of rays in lockstep through the shared slice planes
+void raycaster::castpacket(frame *f,int px[RAYPACKET],int py[RAYPACKET],int n)
+   {
+   int i,l;
+
+   level *lvl=f->lvl;
+
+   float u0[RAYPACKET],v0[RAYPACKET],w0[RAYPACKET]; // ray origin in voxels
+   float ud[RAYPACKET],vd[RAYPACKET],wd[RAYPACKET]; // ray direction in voxels per depth unit
+
+   int kfirst[RAYPACKET],kend[RAYPACKET];
+   BOOLINT live[RAYPACKET];
+
+   float sf[RAYPACKET],sb[RAYPACKET];
+   float acc[RAYPACKET][4];
+
+   int k,kmin,kmax;
+   int skip,steps;
+
+   float d,h;
+
+   float sx,sy,sz;
+
+   double x,y,wx,wy,wz;
+   double rx,ry,rz,rd;
+
+   double tn,tx,t1,t2;
+   double din,dout;
+
+   double bmin[3],bmax[3],e[3],r[3];
+
+   h=0.5f*f->slab;
+
+   // the bounding box includes the border of the bricks
+   bmin[0]=lvl->ox-lvl->border/lvl->fx;
+   bmin[1]=lvl->oy-lvl->border/lvl->fy;
+   bmin[2]=lvl->oz-lvl->border/lvl->fz;
+
+   bmax[0]=lvl->ox+(lvl->width-1+lvl->border)/lvl->fx;
+   bmax[1]=lvl->oy+(lvl->height-1+lvl->border)/lvl->fy;
+   bmax[2]=lvl->oz+(lvl->depth-1+lvl->border)/lvl->fz;
+
+   e[0]=f->ex;
+   e[1]=f->ey;
+   e[2]=f->ez;
+
+   kmin=RAYMAXSTEPS+1;
+   kmax=-RAYMAXSTEPS-1;
+
+   // set up the rays of the packet
+   for (l=0; l<RAYPACKET; l++)
+      {
+      acc[l][0]=acc[l][1]=acc[l][2]=acc[l][3]=0.0f;
+
+      live[l]=FALSE;
+
+      u0[l]=v0[l]=w0[l]=0.0f;
+      ud[l]=vd[l]=wd[l]=0.0f;
+
+      kfirst[l]=kend[l]=0;
+
+      if (l>=n) continue;
+
+      // ray through the pixel center
+      x=2.0*(px[l]+0.5)/f->width-1.0;
+      y=2.0*(py[l]+0.5)/f->height-1.0;
+
+      unproject(f->minv,x,y,-1.0,&wx,&wy,&wz);
+
+      rx=wx-f->ex;
+      ry=wy-f->ey;
+      rz=wz-f->ez;
+
+      if (rx==0.0) rx=1.0E-7;
+      if (ry==0.0) ry=1.0E-7;
+      if (rz==0.0) rz=1.0E-7;
+
+      // view depth per unit ray parameter
+      rd=rx*f->dx+ry*f->dy+rz*f->dz;
+      if (rd<=0.0) continue;
+
+      // ray parameterized by view depth
+      r[0]=rx/rd;
+      r[1]=ry/rd;
+      r[2]=rz/rd;
+
+      // intersect ray with the bounding box
+      din=0.0;
+      dout=MAXFLOAT;
+
+      for (i=0; i<3; i++)
+         {
+         t1=(bmin[i]-e[i])/r[i];
+         t2=(bmax[i]-e[i])/r[i];
+
+         tn=fmin(t1,t2);
+         tx=fmax(t1,t2);
+
+         if (tn>din) din=tn;
+         if (tx<dout) dout=tx;
+         }
+
+      if (din<f->nearp) din=f->nearp;
+
+      // clip ray against the clip planes
+      for (i=0; i<f->planes; i++)
+         {
+         const double *p=&f->equ[4*i];
+
+         double a=p[0]*e[0]+p[1]*e[1]+p[2]*e[2]+p[3];
+         double b=p[0]*r[0]+p[1]*r[1]+p[2]*r[2];
+
+         if (b>0.0) din=fmax(din,-a/b);
+         else if (b<0.0) dout=fmin(dout,-a/b);
+         else if (a<0.0) dout=-MAXFLOAT;
+         }
+
+      // clip ray against the opaque geometry
+      if (f->depth!=NULL)
+         if (f->depth[px[l]+py[l]*f->width]<1.0f)
+            {
+            unproject(f->minv,x,y,2.0*f->depth[px[l]+py[l]*f->width]-1.0,&wx,&wy,&wz);
+            dout=fmin(dout,(wx-e[0])*f->dx+(wy-e[1])*f->dy+(wz-e[2])*f->dz);
+            }
+
+      if (din>=dout) continue;
+
+      // slice planes inside the ray segment (same planes as the slicer)
+      kfirst[l]=(int)fceil((din-f->nearp)/f->slab-0.5);
+      kend[l]=(int)fceil((dout-f->nearp)/f->slab-0.5);
+
+      if (kend[l]>kfirst[l]+RAYMAXSTEPS) kend[l]=kfirst[l]+RAYMAXSTEPS;
+      if (kfirst[l]>=kend[l]) continue;
+
+      // ray in voxel coordinates
+      u0[l]=(e[0]-lvl->ox)*lvl->fx;
+      v0[l]=(e[1]-lvl->oy)*lvl->fy;
+      w0[l]=(e[2]-lvl->oz)*lvl->fz;
+
+      ud[l]=r[0]*lvl->fx;
+      vd[l]=r[1]*lvl->fy;
+      wd[l]=r[2]*lvl->fz;
+
+      live[l]=TRUE;
+
+      if (kfirst[l]<kmin) kmin=kfirst[l];
+      if (kend[l]>kmax) kmax=kend[l];
+      }
+
+   k=kmin;
+   if (k>=kmax) return;
+
+   d=f->nearp+(k+0.5f)*f->slab;
+
+   for (l=0; l<RAYPACKET; l++)
+      sf[l]=sample(lvl->data,lvl->width,lvl->height,lvl->depth,u0[l]+ud[l]*(d-h),v0[l]+vd[l]*(d-h),w0[l]+wd[l]*(d-h));
+
+   // composite front-to-back
+   while (k<kmax)
+      {
+      // skip the segments that start and end inside empty blocks
+      skip=RAYMAXSTEPS;
+
+      for (l=0; l<RAYPACKET && skip>0; l++)
+         if (live[l])
+            {
+            int bx,by,bz;
+            double dexit,t;
+
+            sx=u0[l]+ud[l]*(d-h);
+            sy=v0[l]+vd[l]*(d-h);
+            sz=w0[l]+wd[l]*(d-h);
+
+            bx=(sx<0.0f)?0:(int)(sx/RAYBLOCK);
+            by=(sy<0.0f)?0:(int)(sy/RAYBLOCK);
+            bz=(sz<0.0f)?0:(int)(sz/RAYBLOCK);
+
+            if (bx>=lvl->bx) bx=lvl->bx-1;
+            if (by>=lvl->by) by=lvl->by-1;
+            if (bz>=lvl->bz) bz=lvl->bz-1;
+
+            if (!lvl->empty[bx+(by+bz*lvl->by)*lvl->bx])
+               {
+               skip=0;
+               break;
+               }
+
+            // view depth at which the ray leaves the block
+            dexit=MAXFLOAT;
+
+            if (ud[l]>0.0f) dexit=fmin(dexit,((bx+1)*RAYBLOCK-u0[l])/ud[l]);
+            else if (ud[l]<0.0f) dexit=fmin(dexit,(bx*RAYBLOCK-u0[l])/ud[l]);
+
+            if (vd[l]>0.0f) dexit=fmin(dexit,((by+1)*RAYBLOCK-v0[l])/vd[l]);
+            else if (vd[l]<0.0f) dexit=fmin(dexit,(by*RAYBLOCK-v0[l])/vd[l]);
+
+            if (wd[l]>0.0f) dexit=fmin(dexit,((bz+1)*RAYBLOCK-w0[l])/wd[l]);
+            else if (wd[l]<0.0f) dexit=fmin(dexit,(bz*RAYBLOCK-w0[l])/wd[l]);
+
+            t=(dexit-d-h)/f->slab;
+
+            if (t<=0.0) steps=0;
+            else if (t>=RAYMAXSTEPS) steps=RAYMAXSTEPS;
+            else steps=(int)fceil(t);
+
+            if (steps<skip) skip=steps;
+            }
+
+      if (skip>0)
+         {
+         k+=skip;
+         if (k>=kmax) break;
+
+         d=f->nearp+(k+0.5f)*f->slab;
+
+         for (l=0; l<RAYPACKET; l++)
+            sf[l]=sample(lvl->data,lvl->width,lvl->height,lvl->depth,u0[l]+ud[l]*(d-h),v0[l]+vd[l]*(d-h),w0[l]+wd[l]*(d-h));
+
+         continue;
+         }
+
+      // sample the back of the ray segments
+      if (TABDIM)
+         for (l=0; l<RAYPACKET; l++)
+            sb[l]=sample(lvl->data,lvl->width,lvl->height,lvl->depth,u0[l]+ud[l]*(d+h),v0[l]+vd[l]*(d+h),w0[l]+wd[l]*(d+h));
+      else
+         for (l=0; l<RAYPACKET; l++)
+            sb[l]=sample(lvl->data,lvl->width,lvl->height,lvl->depth,u0[l]+ud[l]*d,v0[l]+vd[l]*d,w0[l]+wd[l]*d);
+
+      for (l=0; l<RAYPACKET; l++)
+         if (live[l] && k>=kfirst[l] && k<kend[l])
+            {
+            float col[4],a,b;
+            float cx,cy,fx,fy;
+            int ix,iy,ix1,iy1;
+
+            const float *t00,*t01,*t10,*t11;
+
+            // bilinear lookup of the pre-integrated table
+            cx=(sb[l]*WSCALE+WBIAS)*TABRES-0.5f;
+            if (cx<0.0f) cx=0.0f; else if (cx>TABRES-1) cx=TABRES-1;
+
+            ix=(int)cx;
+            ix1=(ix<TABRES-1)?ix+1:ix;
+            fx=cx-ix;
+
+            if (TABDIM)
+               {
+               cy=(sf[l]*WSCALE+WBIAS)*TABRES-0.5f;
+               if (cy<0.0f) cy=0.0f; else if (cy>TABRES-1) cy=TABRES-1;
+
+               iy=(int)cy;
+               iy1=(iy<TABRES-1)?iy+1:iy;
+               fy=cy-iy;
+               }
+            else
+               {
+               iy=iy1=0;
+               fy=0.0f;
+               }
+
+            t00=&TABLE[4*(ix+iy*TABRES)];
+            t01=&TABLE[4*(ix1+iy*TABRES)];
+            t10=&TABLE[4*(ix+iy1*TABRES)];
+            t11=&TABLE[4*(ix1+iy1*TABRES)];
+
+            for (i=0; i<4; i++)
+               {
+               a=t00[i]+fx*(t01[i]-t00[i]);
+               b=t10[i]+fx*(t11[i]-t10[i]);
+               col[i]=a+fy*(b-a);
+               }
+
+            a=1.0f-acc[l][3];
+
+            for (i=0; i<4; i++) acc[l][i]+=a*col[i];
+
+            // early ray termination
+            if (acc[l][3]>=f->thres) live[l]=FALSE;
+            }
+
+      for (l=0; l<RAYPACKET; l++)
+         {
+         sf[l]=sb[l];
+         if (k+1>=kend[l]) live[l]=FALSE;
+         }
+
+      for (l=0; l<RAYPACKET; l++)
+         if (live[l]) break;
+
+      if (l==RAYPACKET) break;
+
+      k++;
+
+      d=f->nearp+(k+0.5f)*f->slab;
+      }
+
+   // write the pixels of the packet
+   for (l=0; l<n; l++)
+      {
+      unsigned char *ptr=&f->image[4*(px[l]+py[l]*f->width)];
+
+      for (i=0; i<4; i++)
+         {
+         float v=acc[l][i];
+
+         if (v<0.0f) v=0.0f;
+         else if (v>1.0f) v=1.0f;
+
+         ptr[i]=(unsigned char)(255.0f*v+0.5f);
+         }
+      }
+   }
+
+// cast rays into an RGBA image
+void raycaster::cast(int level,
+                     unsigned char *image,int width,int height,
+                     const double minv[16],const float *depth,
+                     float ex,float ey,float ez,
+                     float dx,float dy,float dz,
+                     float nearp,float slab,
+                     float thres,
+                     int planes,const double *equ)
+   {
+   frame f;
+
+   if (level<0 || level>=LEVELS) ERRORMSG();
+   if (width<=0 || height<=0) return;
+
+   fetchtable();
+   classify(&LEVEL[level]);
+
+   f.caster=this;
+   f.lvl=&LEVEL[level];
+
+   f.image=image;
+   f.width=width;
+   f.height=height;
+
+   f.tilesx=(width+RAYTILE-1)/RAYTILE;
+   f.tilesy=(height+RAYTILE-1)/RAYTILE;
+
+   f.minv=minv;
+   f.depth=depth;
+
+   f.ex=ex;
+   f.ey=ey;
+   f.ez=ez;
+
+   f.dx=dx;
+   f.dy=dy;
+   f.dz=dz;
+
+   f.nearp=nearp;
+   f.slab=slab;
+   f.thres=thres;
+
+   f.planes=planes;
+   f.equ=equ;
+
+   // the shared tile counter balances the load among the worker threads
+   parallelfor(f.tilesx*f.tilesy,casttile,&f);
+   }
+
+// cast rays and composite the image into the frame buffer
+void raycaster::render(int level,
+                       float ex,float ey,float ez,
+                       float dx,float dy,float dz,
+                       float nearp,float slab,
+                       float thres,
+                       int planes,const double *equ)
+   {
+   int i;
+
+   GLint viewport[4];
+   GLdouble mv[16],proj[16];
+   double m[16],minv[16];
+
+   int width,height;
+
+   glGetIntegerv(GL_VIEWPORT,viewport);
+   glGetDoublev(GL_MODELVIEW_MATRIX,mv);
+   glGetDoublev(GL_PROJECTION_MATRIX,proj);
+
+   width=viewport[2];
+   height=viewport[3];
+
+   if (width<=0 || height<=0) return;
+
+   // combined projection and modelview matrix
+   for (i=0; i<16; i++)
+      m[i]=proj[i&3]*mv[i&12]+
+           proj[(i&3)+4]*mv[(i&12)+1]+
+           proj[(i&3)+8]*mv[(i&12)+2]+
+           proj[(i&3)+12]*mv[(i&12)+3];
+
+   if (!invert4(m,minv)) return;
+
+   if (width*height>IMGSIZE)
+      {
+      if (IMAGE!=NULL) delete[] IMAGE;
+      if (DEPTH!=NULL) delete[] DEPTH;
+
+      IMGSIZE=width*height;
+
+      IMAGE=new unsigned char[4*IMGSIZE];
+      DEPTH=new float[IMGSIZE];
+      }
+
+   // read back the depth of the opaque geometry
+   glPixelStorei(GL_PACK_ALIGNMENT,1);
+   glReadPixels(viewport[0],viewport[1],width,height,GL_DEPTH_COMPONENT,GL_FLOAT,DEPTH);
+
+   cast(level,
+        IMAGE,width,height,
+        minv,DEPTH,
+        ex,ey,ez,
+        dx,dy,dz,
+        nearp,slab,
+        thres,
+        planes,equ);
+
+   // composite the image over the frame buffer
+   glPushAttrib(GL_ENABLE_BIT|GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+   for (i=0; i<planes; i++) glDisable(GL_CLIP_PLANE0+i);
+
+   glDisable(GL_DEPTH_TEST);
+   glDepthMask(GL_FALSE);
+
+   glDisable(GL_LIGHTING);
+   glDisable(GL_ALPHA_TEST);
+   glDisable(GL_TEXTURE_2D);
+   glDisable(GL_TEXTURE_3D);
+
+   glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+   glEnable(GL_BLEND);
+
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glRasterPos2f(-1.0f,-1.0f);
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+   glDrawPixels(width,height,GL_RGBA,GL_UNSIGNED_BYTE,IMAGE);
+
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+
+   glPopAttrib();
+   }
@@ -0,0 +1,134 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#ifndef RAYBASE_H
+#define RAYBASE_H
+
+#include "codebase.h" // universal code base
+#include "oglbase.h" // OpenGL base and window handling
+#include "tfbase.h" // transfer functions
+
+#define RAYLEVELS 16
+
+#define RAYBLOCK 8 // cells per empty space skipping block
+#define RAYTILE 16 // pixels per image tile
+#define RAYPACKET 4 // rays per packet (2x2 pixels)
+
+// a cpu ray caster for the volume hierarchy
+class raycaster
+   {
+   public:
+
+   // default constructor
+   raycaster(tfunc2D *tf);
+
+   // destructor
+   ~raycaster();
+
+   // set the volume data of one pyramid level
+   // the bounding box is extended by the zero padded border of the bricks
+   // the data is either copied or referenced
+   void set_level(int level,
+                  unsigned char *data,
+                  long long width,long long height,long long depth,
+                  float mx,float my,float mz,
+                  float sx,float sy,float sz,
+                  int border=0,
+                  BOOLINT copy=TRUE);
+
+   // remove all pyramid levels
+   void clear();
+
+   // get the number of pyramid levels
+   int get_levels() {return(LEVELS);}
+
+   // check whether or not the actual transfer function can be ray casted
+   BOOLINT check();
+
+   // cast rays through one pyramid level and composite the image into the frame buffer
+   // the view is defined by the actual modelview and projection matrix
+   // the clip plane equations are given in world coordinates (4 doubles per plane)
+   void render(int level,
+               float ex,float ey,float ez,
+               float dx,float dy,float dz,
+               float nearp,float slab,
+               float thres,
+               int planes,const double *equ);
+
+   // cast rays into an RGBA image with a bottom-up row order
+   // minv is the inverse of the combined projection and modelview matrix
+   // depth is the optional depth buffer of the opaque geometry
+   void cast(int level,
+             unsigned char *image,int width,int height,
+             const double minv[16],const float *depth,
+             float ex,float ey,float ez,
+             float dx,float dy,float dz,
+             float nearp,float slab,
+             float thres,
+             int planes,const double *equ);
+
+   protected:
+
+   tfunc2D *TFUNC;
+
+   struct level
+      {
+      unsigned char *data;
+      BOOLINT owned;
+
+      int width,height,depth;
+      float ox,oy,oz; // world position of the first voxel
+      float fx,fy,fz; // voxels per world unit
+      int border; // border of the bounding box in voxels
+
+      int bx,by,bz; // number of blocks
+      unsigned char *minmax; // block value range
+      unsigned char *empty; // block visibility for the actual frame
+      };
+
+   level LEVEL[RAYLEVELS];
+   int LEVELS;
+
+   float *TABLE; // floating point copy of the pre-integrated table
+   int TABRES;
+   BOOLINT TABDIM;
+
+   float WSCALE,WBIAS; // windowing transform of the table lookup
+
+   unsigned char *IMAGE;
+   float *DEPTH;
+   int IMGSIZE;
+
+   private:
+
+   struct frame
+      {
+      raycaster *caster;
+      level *lvl;
+
+      unsigned char *image;
+      int width,height;
+      int tilesx,tilesy;
+
+      const double *minv;
+      const float *depth;
+
+      float ex,ey,ez;
+      float dx,dy,dz;
+      float nearp,slab,thres;
+
+      int planes;
+      const double *equ;
+      };
+
+   void freelevel(int level);
+
+   void fetchtable();
+   void classify(level *lvl);
+
+   static void calcminmax(int k,void *data);
+   static void casttile(int i,void *data);
+
+   void castpacket(frame *f,int px[RAYPACKET],int py[RAYPACKET],int n);
+   };
+
+#endif
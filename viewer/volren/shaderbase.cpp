@@ -5,6 +5,8 @@
 
 #include "shaderbase.h"
 
+#define MAXLOG 1024
+
 int buildprog(const char *prog,bool vtxorfrg)
    {
    GLuint progid=0;
@@ -118,3 +120,108 @@ void bindfrgprog(int progid) {bindprog(progid,FALSE);}
 void setfrgprogpar(int n,float p1,float p2,float p3,float p4) {setprogpar(n,p1,p2,p3,p4,FALSE);}
 void setfrgprogpars(int n,int count,const float *params) {setprogpars(n,count,params,FALSE);}
 void deletefrgprog(int progid) {deleteprog(progid);}
+
+GLuint buildglslshader(const char *prog,GLenum type)
+   {
+   GLuint shaderid=0;
+
+#ifdef GL_VERSION_2_0
+   GLint status;
+   char info[MAXLOG];
+
+   shaderid=glCreateShader(type);
+
+   glShaderSource(shaderid,1,&prog,NULL);
+   glCompileShader(shaderid);
+
+   glGetShaderiv(shaderid,GL_COMPILE_STATUS,&status);
+
+   if (status!=GL_TRUE)
+      {
+      glGetShaderInfoLog(shaderid,MAXLOG,NULL,info);
+      WARNMSG("glsl shader unavailable");
+      WARNMSG(info);
+
+      glDeleteShader(shaderid);
+      shaderid=0;
+      }
+#endif
+
+   return(shaderid);
+   }
+
+int buildglslprog(const char *vtxprog,const char *frgprog)
+   {
+   GLuint progid=0;
+
+#ifdef GL_VERSION_2_0
+   GLuint vtxid,frgid;
+   GLint status;
+   char info[MAXLOG];
+
+   if ((vtxid=buildglslshader(vtxprog,GL_VERTEX_SHADER))==0) return(0);
+
+   if ((frgid=buildglslshader(frgprog,GL_FRAGMENT_SHADER))==0)
+      {
+      glDeleteShader(vtxid);
+      return(0);
+      }
+
+   progid=glCreateProgram();
+
+   glAttachShader(progid,vtxid);
+   glAttachShader(progid,frgid);
+
+   glLinkProgram(progid);
+
+   // the shaders are released together with the program
+   glDeleteShader(vtxid);
+   glDeleteShader(frgid);
+
+   glGetProgramiv(progid,GL_LINK_STATUS,&status);
+
+   if (status!=GL_TRUE)
+      {
+      glGetProgramInfoLog(progid,MAXLOG,NULL,info);
+      WARNMSG("glsl program unavailable");
+      WARNMSG(info);
+
+      glDeleteProgram(progid);
+      progid=0;
+      }
+#endif
+
+   return(progid);
+   }
+
+void bindglslprog(int progid)
+   {
+#ifdef GL_VERSION_2_0
+   glUseProgram(progid);
+#endif
+   }
+
+void setglslprogpar(int progid,const char *name,float p1,float p2,float p3,float p4)
+   {
+#ifdef GL_VERSION_2_0
+   GLint loc;
+
+   if ((loc=glGetUniformLocation(progid,name))>=0) glUniform4f(loc,p1,p2,p3,p4);
+#endif
+   }
+
+void setglslprogtex(int progid,const char *name,int unit)
+   {
+#ifdef GL_VERSION_2_0
+   GLint loc;
+
+   if ((loc=glGetUniformLocation(progid,name))>=0) glUniform1i(loc,unit);
+#endif
+   }
+
+void deleteglslprog(int progid)
+   {
+#ifdef GL_VERSION_2_0
+   if (progid!=0) glDeleteProgram(progid);
+#endif
+   }
@@ -15,6 +15,12 @@ void setfrgprogpar(int n,float p1,float p2,float p3,float p4);
 void setfrgprogpars(int n,int count,const float *params);
 void deletefrgprog(int progid);
 
+int buildglslprog(const char *vtxprog,const char *frgprog);
+void bindglslprog(int progid);
+void setglslprogpar(int progid,const char *name,float p1,float p2,float p3,float p4);
+void setglslprogtex(int progid,const char *name,int unit);
+void deleteglslprog(int progid);
+
 static const char default_vtxprg[]=
    "!!ARBvp1.0\n"
    "OPTION ARB_position_invariant; \n"
@@ -1,15 +1,27 @@
 // (c) by Stefan Roettger, licensed under GPL 2+
 
+#include "threadbase.h"
+
 #include "tfbase.h"
 
 // a transfer function:
 
 tfunc::tfunc(int res)
    {
+   int i;
+
    if (res<2) ERRORMSG();
 
    RES=res;
 
+   DIRTYMIN=RES;
+   DIRTYMAX=-1;
+
+   UPDMIN=0;
+   UPDMAX=RES-1;
+
+   THREADED=TRUE;
+
    RE=new float[res];
    GE=new float[res];
    BE=new float[res];
@@ -41,17 +53,20 @@ tfunc::tfunc(int res)
    PGA=new float[res];
    PBA=new float[res];
 
-   PMIN=new float[res*res];
+   for (PLEVELS=1; (1<<PLEVELS)<=res; PLEVELS++);
 
-   PPSIZE=256;
+   POPA=new float[res];
+   PMIN=new float[res*PLEVELS];
+   PLOG=new int[res+1];
 
-   TABLE1=new float[PPSIZE];
-   TABLE2=new float[PPSIZE];
-   TABLE3=new float[PPSIZE];
+   // binary logarithm of the range length
+   PLOG[0]=PLOG[1]=0;
+   for (i=2; i<=res; i++) PLOG[i]=PLOG[i/2]+1;
 
-   LAST1=LAST2=LAST3=-1.0f;
+   PVALID=FALSE;
 
    EDATA=ADATA=NULL;
+   FEDATA=FADATA=NULL;
 
    LAST_EMS=0.0f;
    LAST_DNS=0.0f;
@@ -61,8 +76,9 @@ tfunc::tfunc(int res)
    LAST_INT=FALSE;
    LAST_RGBA=FALSE;
    LAST_DIM=FALSE;
+   LAST_FLT=FALSE;
 
-   CHANGED=TRUE;
+   touchall();
    }
 
 tfunc::~tfunc()
@@ -83,14 +99,15 @@ tfunc::~tfunc()
    delete PGA;
    delete PBA;
 
+   delete[] POPA;
    delete PMIN;
-
-   delete TABLE1;
-   delete TABLE2;
-   delete TABLE3;
+   delete[] PLOG;
 
    if (EDATA!=NULL) delete EDATA;
    if (ADATA!=NULL) delete ADATA;
+
+   if (FEDATA!=NULL) delete[] FEDATA;
+   if (FADATA!=NULL) delete[] FADATA;
    }
 
 // check whether or not the absorption is equal for all channels
@@ -110,50 +127,43 @@ BOOLINT tfunc::checkRGBA()
    return(TRUE);
    }
 
-// pre-computed power functions:
-
-float tfunc::prepow1(float x,float p)
+// fast power of two of a packet of values with a relative error below 1.0E-5
+// the values are clamped in a separate pass so that both passes vectorize
+inline void tfunc::fexp2(float *x,int n)
    {
-   int i;
+   int i,e;
+   float f,p,q;
 
-   if (x!=LAST1)
+   for (i=0; i<n; i++)
       {
-      for (i=0; i<PPSIZE; i++) TABLE1[i]=fpow(x,(float)i/(PPSIZE-1));
-      LAST1=x;
+      x[i]=(x[i]>-126.0f)?x[i]:-126.0f;
+      x[i]=(x[i]<126.0f)?x[i]:126.0f;
       }
 
-   return(TABLE1[ftrc(p*(PPSIZE-1)+0.5f)]);
-   }
-
-float tfunc::prepow2(float x,float p)
-   {
-   int i;
-
-   if (x!=LAST2)
+   for (i=0; i<n; i++)
       {
-      for (i=0; i<PPSIZE; i++) TABLE2[i]=fpow(x,(float)i/(PPSIZE-1));
-      LAST2=x;
-      }
+      // split into integer and fractional part without branching
+      e=(int)x[i];
+      e-=(x[i]<e);
+      f=x[i]-e;
 
-   return(TABLE2[ftrc(p*(PPSIZE-1)+0.5f)]);
-   }
+      // polynomial approximation of 2^f on [0,1]
+      p=1.0f+f*(0.69314718f+f*(0.24022651f+f*(0.05550411f+f*(0.00961813f+f*0.00150407f))));
 
-float tfunc::prepow3(float x,float p)
-   {
-   int i;
+      // power of two of the integer part via the float exponent
+      e=(e+127)<<23;
+      memcpy(&q,&e,sizeof(q));
 
-   if (x!=LAST3)
-      {
-      for (i=0; i<PPSIZE; i++) TABLE3[i]=fpow(x,(float)i/(PPSIZE-1));
-      LAST3=x;
+      x[i]=q*p;
       }
-
-   return(TABLE3[ftrc(p*(PPSIZE-1)+0.5f)]);
    }
 
 // quantize float to 8 bit
 unsigned char tfunc::quant(float x)
-   {return((x<1.0f)?ftrc(255.0f*x+0.5f):255);}
+   {
+   x=255.0f*x+0.5f;
+   return((int)((x<255.0f)?x:255.0f));
+   }
 
 // invert the actual transfer function
 void tfunc::invert1D(BOOLINT RGBA)
@@ -163,8 +173,29 @@ void tfunc::invert1D(BOOLINT RGBA)
    unsigned char *ptr;
    int R,G,B;
 
+   float *fptr;
+   float FR,FG,FB;
+
    if (!INVMODE) return;
 
+   if (FEDATA!=NULL)
+      {
+      for (fptr=FEDATA,c=0; c<RES; c++)
+         {
+         FR=fptr[0];
+         FG=fptr[1];
+         FB=fptr[2];
+
+         *fptr++=fmax(fmax(FG-FR,FB-FR),0.0f);
+         *fptr++=fmax(fmax(FR-FG,FB-FG),0.0f);
+         *fptr++=fmax(fmax(FR-FB,FG-FB),0.0f);
+
+         if (RGBA) fptr++;
+         }
+
+      return;
+      }
+
    for (ptr=EDATA,c=0; c<RES; c++)
       {
       R=ptr[0];
@@ -187,8 +218,30 @@ void tfunc::invert2D(BOOLINT RGBA)
    unsigned char *ptr;
    int R,G,B;
 
+   float *fptr;
+   float FR,FG,FB;
+
    if (!INVMODE) return;
 
+   if (FEDATA!=NULL)
+      {
+      for (fptr=FEDATA,r=0; r<RES; r++)
+         for (c=0; c<RES; c++)
+            {
+            FR=fptr[0];
+            FG=fptr[1];
+            FB=fptr[2];
+
+            *fptr++=fmax(fmax(FG-FR,FB-FR),0.0f);
+            *fptr++=fmax(fmax(FR-FG,FB-FG),0.0f);
+            *fptr++=fmax(fmax(FR-FB,FG-FB),0.0f);
+
+            if (RGBA) fptr++;
+            }
+
+      return;
+      }
+
    for (ptr=EDATA,r=0; r<RES; r++)
       for (c=0; c<RES; c++)
          {
@@ -209,46 +262,128 @@ BOOLINT tfunc::refresh1D(const float emission,
                          const float density,
                          const float slab,
                          BOOLINT premult,
-                         BOOLINT RGBA)
+                         BOOLINT RGBA,
+                         BOOLINT flt)
    {
-   int c;
+   // float tables do not depend on emission, density and slab thickness
+   if ((!flt && (emission!=LAST_EMS || density!=LAST_DNS || slab!=LAST_SLB)) ||
+       premult!=LAST_MLT || RGBA!=LAST_RGBA || flt!=LAST_FLT || LAST_DIM)
+      {
+      LAST_MLT=premult;
+      LAST_RGBA=RGBA;
+      LAST_DIM=FALSE;
+      LAST_FLT=flt;
 
-   unsigned char *ptr;
+      touchall();
+      }
 
-   float scale_re,scale_ge,scale_be;
-   float exp_ra,exp_ga,exp_ba;
+   LAST_EMS=emission;
+   LAST_DNS=density;
+   LAST_SLB=slab;
 
-   if (emission!=LAST_EMS || density!=LAST_DNS || slab!=LAST_SLB ||
-       premult!=LAST_MLT || RGBA!=LAST_RGBA || LAST_DIM)
-      {
-      LAST_EMS=emission;
-      LAST_DNS=density;
-      LAST_SLB=slab;
+   if (!CHANGED) return(FALSE);
+
+   // rebuild the dirty entries of the table
+   rebuild(emission,density,slab,premult,FALSE,RGBA,flt,1);
+
+   invert1D(RGBA);
 
+   return(TRUE);
+   }
+
+// pre-integrate the actual transfer function
+BOOLINT tfunc::refresh2D(const float emission,
+                         const float density,
+                         const float slab,
+                         BOOLINT premult,
+                         BOOLINT preint,
+                         BOOLINT RGBA,
+                         BOOLINT flt)
+   {
+   // float tables do not depend on emission, density and slab thickness
+   if ((!flt && (emission!=LAST_EMS || density!=LAST_DNS || slab!=LAST_SLB)) ||
+       premult!=LAST_MLT || preint!=LAST_INT || RGBA!=LAST_RGBA || flt!=LAST_FLT || !LAST_DIM)
+      {
       LAST_MLT=premult;
+      LAST_INT=preint;
       LAST_RGBA=RGBA;
-      LAST_DIM=FALSE;
+      LAST_DIM=TRUE;
+      LAST_FLT=flt;
 
-      CHANGED=TRUE;
+      touchall();
       }
 
+   LAST_EMS=emission;
+   LAST_DNS=density;
+   LAST_SLB=slab;
+
    if (!CHANGED) return(FALSE);
 
-   // delete old transfer function tables
-   if (EDATA!=NULL) delete EDATA;
-   if (ADATA!=NULL) delete ADATA;
+   // rebuild the dirty rows and columns of the pre-integration tables
+   rebuild(emission,density,slab,premult,preint,RGBA,flt,RES);
+
+   invert2D(RGBA);
+
+   return(TRUE);
+   }
+
+// rebuild the part of the tables that depends on the edited entries
+// the prefix sums are only recomputed from the first edited entry on
+// and only the rows and columns with integrals across the edited range are recomputed
+void tfunc::rebuild(const float emission,const float density,const float slab,
+                    BOOLINT premult,BOOLINT preint,BOOLINT RGBA,BOOLINT flt,
+                    int rows)
+   {
+   int c,c0;
+
+   table t;
+
+   // the inversion is applied to the whole table
+   if (INVMODE || (flt?FEDATA:(void *)EDATA)==NULL || DIRTYMIN>DIRTYMAX)
+      {
+      DIRTYMIN=0;
+      DIRTYMAX=RES-1;
+      }
+
+   if (DIRTYMIN==0 && DIRTYMAX==RES-1)
+      {
+      // delete old tables
+      if (EDATA!=NULL) delete EDATA;
+      if (ADATA!=NULL) delete ADATA;
+
+      if (FEDATA!=NULL) delete[] FEDATA;
+      if (FADATA!=NULL) delete[] FADATA;
+
+      EDATA=ADATA=NULL;
+      FEDATA=FADATA=NULL;
+
+      // create new RGBA emission/absorption table or RGB emission and absorption tables
+      if (flt)
+         {
+         FEDATA=new float[(RGBA?4:3)*RES*rows];
+         FADATA=RGBA?NULL:new float[3*RES*rows];
+         }
+      else
+         {
+         EDATA=new unsigned char[(RGBA?4:3)*RES*rows];
+         ADATA=RGBA?NULL:new unsigned char[3*RES*rows];
+         }
+      }
 
    // pre-integrate emission for RGB channels:
 
-   scale_re=emission*slab*RE_SCALE*IMPORTANCE;
-   scale_ge=emission*slab*GE_SCALE*IMPORTANCE;
-   scale_be=emission*slab*BE_SCALE*IMPORTANCE;
+   c0=DIRTYMIN;
 
-   PRE[0]=RE[0];
-   PGE[0]=GE[0];
-   PBE[0]=BE[0];
+   if (c0==0)
+      {
+      PRE[0]=RE[0];
+      PGE[0]=GE[0];
+      PBE[0]=BE[0];
 
-   for (c=1; c<RES; c++)
+      c0=1;
+      }
+
+   for (c=c0; c<RES; c++)
       if (premult)
          {
          PRE[c]=PRE[c-1]+RE[c]*RA[c];
@@ -262,263 +397,270 @@ BOOLINT tfunc::refresh1D(const float emission,
          PBE[c]=PBE[c-1]+BE[c];
          }
 
-   if (RGBA)
-      {
-      // pre-integrate absorption for a single channel:
-
-      exp_ra=fexp(-density*slab*RA_SCALE*IMPORTANCE);
-
-      PRA[0]=PGA[0]=PBA[0]=RA[0];
+   // pre-integrate absorption:
 
-      for (c=1; c<RES; c++) PRA[c]=PGA[c]=PBA[c]=PRA[c-1]+RA[c];
+   c0=DIRTYMIN;
 
-      // create new RGBA emission/absorption table
-      EDATA=new unsigned char[4*RES];
-      ADATA=NULL;
+   if (RGBA)
+      {
+      if (c0==0)
+         {
+         PRA[0]=PGA[0]=PBA[0]=RA[0];
+         c0=1;
+         }
 
-      // calculate emission/absorption
-      for (ptr=EDATA,c=0; c<RES; c++)
-         if (premult)
-            {
-            *ptr++=quant(scale_re*RE[c]*RA[c]);
-            *ptr++=quant(scale_ge*GE[c]*GA[c]);
-            *ptr++=quant(scale_be*BE[c]*BA[c]);
-            *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-            }
-         else
-            {
-            *ptr++=quant(scale_re*RE[c]);
-            *ptr++=quant(scale_ge*GE[c]);
-            *ptr++=quant(scale_be*BE[c]);
-            *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-            }
+      for (c=c0; c<RES; c++) PRA[c]=PGA[c]=PBA[c]=PRA[c-1]+RA[c];
       }
    else
       {
-      // create new RGB emission table
-      EDATA=new unsigned char[3*RES];
-
-      // calculate emission
-      for (ptr=EDATA,c=0; c<RES; c++)
-         if (premult)
-            {
-            *ptr++=quant(scale_re*RE[c]*RA[c]);
-            *ptr++=quant(scale_ge*GE[c]*GA[c]);
-            *ptr++=quant(scale_be*BE[c]*BA[c]);
-            }
-         else
-            {
-            *ptr++=quant(scale_re*RE[c]);
-            *ptr++=quant(scale_ge*GE[c]);
-            *ptr++=quant(scale_be*BE[c]);
-            }
-
-      // pre-integrate absorption for RGB channels:
-
-      exp_ra=fexp(-density*slab*RA_SCALE*IMPORTANCE);
-      exp_ga=fexp(-density*slab*GA_SCALE*IMPORTANCE);
-      exp_ba=fexp(-density*slab*BA_SCALE*IMPORTANCE);
+      if (c0==0)
+         {
+         PRA[0]=RA[0];
+         PGA[0]=GA[0];
+         PBA[0]=BA[0];
 
-      PRA[0]=RA[0];
-      PGA[0]=GA[0];
-      PBA[0]=BA[0];
+         c0=1;
+         }
 
-      for (c=1; c<RES; c++)
+      for (c=c0; c<RES; c++)
          {
          PRA[c]=PRA[c-1]+RA[c];
          PGA[c]=PGA[c-1]+GA[c];
          PBA[c]=PBA[c-1]+BA[c];
          }
+      }
 
-      // create new RGB absorption table
-      ADATA=new unsigned char[3*RES];
+   t.tf=this;
 
-      // calculate absorption
-      for (ptr=ADATA,c=0; c<RES; c++)
-         {
-         *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-         *ptr++=quant(1.0f-prepow2(exp_ga,GA[c]));
-         *ptr++=quant(1.0f-prepow3(exp_ba,BA[c]));
-         }
+   t.scale_re=emission*slab*RE_SCALE*IMPORTANCE;
+   t.scale_ge=emission*slab*GE_SCALE*IMPORTANCE;
+   t.scale_be=emission*slab*BE_SCALE*IMPORTANCE;
+
+   // binary logarithm of the transmittance per unit absorption
+   t.log_ra=-density*slab*RA_SCALE*IMPORTANCE/flog(2.0f);
+   t.log_ga=-density*slab*GA_SCALE*IMPORTANCE/flog(2.0f);
+   t.log_ba=-density*slab*BA_SCALE*IMPORTANCE/flog(2.0f);
+
+   t.premult=premult;
+   t.preint=preint && rows>1;
+   t.RGBA=RGBA;
+   t.flt=flt;
+
+   t.rows=rows;
+
+   if (flt)
+      {
+      // emission and optical depth per unit slab thickness
+      t.scale_re=RE_SCALE*IMPORTANCE;
+      t.scale_ge=GE_SCALE*IMPORTANCE;
+      t.scale_be=BE_SCALE*IMPORTANCE;
+
+      t.scale_ra=RA_SCALE*IMPORTANCE;
+      t.scale_ga=GA_SCALE*IMPORTANCE;
+      t.scale_ba=BA_SCALE*IMPORTANCE;
       }
 
-   invert1D(RGBA);
+   // calculate emission/absorption in blocks of rows
+   if (rows<=TFROWS || !THREADED)
+      for (c=0; c<(rows+TFROWS-1)/TFROWS; c++) calcrows(c,&t);
+   else parallelfor((rows+TFROWS-1)/TFROWS,calcrows,&t);
+
+   UPDMIN=DIRTYMIN;
+   UPDMAX=DIRTYMAX;
+
+   DIRTYMIN=RES;
+   DIRTYMAX=-1;
 
    CHANGED=FALSE;
+   }
 
-   return(TRUE);
+// calculate the dirty entries of one block of table rows
+void tfunc::calcrows(int b,void *data)
+   {
+   int r,r1,r2;
+
+   table *t=(table *)data;
+
+   r1=b*TFROWS;
+   r2=r1+TFROWS;
+
+   if (r2>t->rows) r2=t->rows;
+
+   for (r=r1; r<r2; r++) calcrow(r,t);
    }
 
-// pre-integrate the actual transfer function
-BOOLINT tfunc::refresh2D(const float emission,
-                         const float density,
-                         const float slab,
-                         BOOLINT premult,
-                         BOOLINT preint,
-                         BOOLINT RGBA)
+// calculate the dirty entries of one table row
+void tfunc::calcrow(int r,table *t)
    {
-   int c,r;
+   int c,c1,c2,i,n;
 
-   unsigned char *ptr;
+   unsigned char *eptr,*aptr;
+   float *feptr,*faptr;
 
-   float scale_re,scale_ge,scale_be;
-   float exp_ra,exp_ga,exp_ba;
+   float re[TFPACKET],ge[TFPACKET],be[TFPACKET];
+   float ra[TFPACKET],ga[TFPACKET],ba[TFPACKET];
 
-   if (emission!=LAST_EMS || density!=LAST_DNS || slab!=LAST_SLB ||
-       premult!=LAST_MLT || preint!=LAST_INT || RGBA!=LAST_RGBA || !LAST_DIM)
-      {
-      LAST_EMS=emission;
-      LAST_DNS=density;
-      LAST_SLB=slab;
+   tfunc *tf=t->tf;
 
-      LAST_MLT=premult;
-      LAST_INT=preint;
-      LAST_RGBA=RGBA;
-      LAST_DIM=TRUE;
+   int res=tf->RES;
+   int comps=t->RGBA?4:3;
 
-      CHANGED=TRUE;
+   // an integral is dirty if it overlaps the edited range
+   if (!t->preint) {c1=tf->DIRTYMIN; c2=tf->DIRTYMAX;}
+   else if (r<tf->DIRTYMIN) {c1=tf->DIRTYMIN; c2=res-1;}
+   else if (r>tf->DIRTYMAX) {c1=0; c2=tf->DIRTYMAX;}
+   else {c1=0; c2=res-1;}
+
+   if (t->flt)
+      {
+      feptr=&tf->FEDATA[comps*(r*res+c1)];
+      faptr=(tf->FADATA==NULL)?NULL:&tf->FADATA[3*(r*res+c1)];
+
+      eptr=aptr=NULL;
       }
+   else
+      {
+      eptr=&tf->EDATA[comps*(r*res+c1)];
+      aptr=(tf->ADATA==NULL)?NULL:&tf->ADATA[3*(r*res+c1)];
 
-   if (!CHANGED) return(FALSE);
+      feptr=faptr=NULL;
+      }
 
-   // delete old pre-integration tables
-   if (EDATA!=NULL) delete EDATA;
-   if (ADATA!=NULL) delete ADATA;
+   // the row is evaluated in packets of entries
+   for (c=c1; c<=c2; c+=TFPACKET)
+      {
+      n=c2-c+1;
+      if (n>TFPACKET) n=TFPACKET;
 
-   // pre-integrate emission for RGB channels:
+      if (t->preint) tf->average(r,c,n,re,ge,be,ra,ga,ba);
 
-   scale_re=emission*slab*RE_SCALE*IMPORTANCE;
-   scale_ge=emission*slab*GE_SCALE*IMPORTANCE;
-   scale_be=emission*slab*BE_SCALE*IMPORTANCE;
+      // the diagonal and the classified entries are taken directly
+      if (!t->preint) tf->sample(c,n,t->premult,re,ge,be,ra,ga,ba);
+      else if (r>=c && r<c+n) tf->sample(r,1,t->premult,&re[r-c],&ge[r-c],&be[r-c],&ra[r-c],&ga[r-c],&ba[r-c]);
 
-   PRE[0]=RE[0];
-   PGE[0]=GE[0];
-   PBE[0]=BE[0];
+      for (i=0; i<n; i++)
+         {
+         re[i]*=t->scale_re;
+         ge[i]*=t->scale_ge;
+         be[i]*=t->scale_be;
+         }
 
-   for (c=1; c<RES; c++)
-      if (premult)
+      if (t->flt)
          {
-         PRE[c]=PRE[c-1]+RE[c]*RA[c];
-         PGE[c]=PGE[c-1]+GE[c]*GA[c];
-         PBE[c]=PBE[c-1]+BE[c]*BA[c];
+         for (i=0; i<n; i++)
+            {
+            *feptr++=re[i];
+            *feptr++=ge[i];
+            *feptr++=be[i];
+
+            if (t->RGBA) *feptr++=t->scale_ra*ra[i];
+            else
+               {
+               *faptr++=t->scale_ra*ra[i];
+               *faptr++=t->scale_ga*ga[i];
+               *faptr++=t->scale_ba*ba[i];
+               }
+            }
+
+         continue;
          }
-      else
+
+      // opacity from the transmittance of the slab
+      for (i=0; i<n; i++)
          {
-         PRE[c]=PRE[c-1]+RE[c];
-         PGE[c]=PGE[c-1]+GE[c];
-         PBE[c]=PBE[c-1]+BE[c];
+         ra[i]*=t->log_ra;
+         ga[i]*=t->log_ga;
+         ba[i]*=t->log_ba;
          }
 
-   if (RGBA)
-      {
-      // pre-integrate absorption for a single channel:
+      fexp2(ra,n);
+      fexp2(ga,n);
+      fexp2(ba,n);
 
-      exp_ra=fexp(-density*slab*RA_SCALE*IMPORTANCE);
+      for (i=0; i<n; i++)
+         {
+         ra[i]=1.0f-ra[i];
+         ga[i]=1.0f-ga[i];
+         ba[i]=1.0f-ba[i];
+         }
 
-      PRA[0]=PGA[0]=PBA[0]=RA[0];
+      if (t->RGBA)
+         for (i=0; i<n; i++)
+            {
+            eptr[0]=quant(re[i]);
+            eptr[1]=quant(ge[i]);
+            eptr[2]=quant(be[i]);
+            eptr[3]=quant(ra[i]);
 
-      for (c=1; c<RES; c++) PRA[c]=PGA[c]=PBA[c]=PRA[c-1]+RA[c];
+            eptr+=4;
+            }
+      else
+         for (i=0; i<n; i++)
+            {
+            eptr[0]=quant(re[i]);
+            eptr[1]=quant(ge[i]);
+            eptr[2]=quant(be[i]);
 
-      // create new RGBA emission/absorption table
-      EDATA=new unsigned char[4*RES*RES];
-      ADATA=NULL;
+            aptr[0]=quant(ra[i]);
+            aptr[1]=quant(ga[i]);
+            aptr[2]=quant(ba[i]);
 
-      // calculate emission/absorption
-      for (ptr=EDATA,r=0; r<RES; r++)
-         for (c=0; c<RES; c++)
-            if (c==r || !preint)
-               if (premult)
-                  {
-                  *ptr++=quant(scale_re*RE[c]*RA[c]);
-                  *ptr++=quant(scale_ge*GE[c]*GA[c]);
-                  *ptr++=quant(scale_be*BE[c]*BA[c]);
-                  *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-                  }
-               else
-                  {
-                  *ptr++=quant(scale_re*RE[c]);
-                  *ptr++=quant(scale_ge*GE[c]);
-                  *ptr++=quant(scale_be*BE[c]);
-                  *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-                  }
-            else
-               {
-               *ptr++=quant(scale_re*fabs((PRE[c]-PRE[r])/(c-r)));
-               *ptr++=quant(scale_ge*fabs((PGE[c]-PGE[r])/(c-r)));
-               *ptr++=quant(scale_be*fabs((PBE[c]-PBE[r])/(c-r)));
-               *ptr++=quant(1.0f-prepow1(exp_ra,fabs((PRA[c]-PRA[r])/(c-r))));
-               }
+            eptr+=3;
+            aptr+=3;
+            }
       }
-   else
-      {
-      // create new RGB emission table
-      EDATA=new unsigned char[3*RES*RES];
-
-      // calculate emission
-      for (ptr=EDATA,r=0; r<RES; r++)
-         for (c=0; c<RES; c++)
-            if (c==r || !preint)
-               if (premult)
-                  {
-                  *ptr++=quant(scale_re*RE[c]*RA[c]);
-                  *ptr++=quant(scale_ge*GE[c]*GA[c]);
-                  *ptr++=quant(scale_be*BE[c]*BA[c]);
-                  }
-               else
-                  {
-                  *ptr++=quant(scale_re*RE[c]);
-                  *ptr++=quant(scale_ge*GE[c]);
-                  *ptr++=quant(scale_be*BE[c]);
-                  }
-            else
-               {
-               *ptr++=quant(scale_re*fabs((PRE[c]-PRE[r])/(c-r)));
-               *ptr++=quant(scale_ge*fabs((PGE[c]-PGE[r])/(c-r)));
-               *ptr++=quant(scale_be*fabs((PBE[c]-PBE[r])/(c-r)));
-               }
+   }
 
-      // pre-integrate absorption for RGB channels:
+// fetch the classified channels of a packet of entries
+void tfunc::sample(int c,int n,BOOLINT premult,
+                   float *re,float *ge,float *be,
+                   float *ra,float *ga,float *ba)
+   {
+   int i;
 
-      exp_ra=fexp(-density*slab*RA_SCALE*IMPORTANCE);
-      exp_ga=fexp(-density*slab*GA_SCALE*IMPORTANCE);
-      exp_ba=fexp(-density*slab*BA_SCALE*IMPORTANCE);
+   for (i=0; i<n; i++)
+      {
+      re[i]=RE[c+i];
+      ge[i]=GE[c+i];
+      be[i]=BE[c+i];
 
-      PRA[0]=RA[0];
-      PGA[0]=GA[0];
-      PBA[0]=BA[0];
+      ra[i]=RA[c+i];
+      ga[i]=GA[c+i];
+      ba[i]=BA[c+i];
+      }
 
-      for (c=1; c<RES; c++)
+   if (premult)
+      for (i=0; i<n; i++)
          {
-         PRA[c]=PRA[c-1]+RA[c];
-         PGA[c]=PGA[c-1]+GA[c];
-         PBA[c]=PBA[c-1]+BA[c];
+         re[i]*=ra[i];
+         ge[i]*=ga[i];
+         be[i]*=ba[i];
          }
+   }
 
-      // create new RGB absorption table
-      ADATA=new unsigned char[3*RES*RES];
+// average the channels of a packet of entries between the front and back sample
+void tfunc::average(int r,int c,int n,
+                    float *re,float *ge,float *be,
+                    float *ra,float *ga,float *ba)
+   {
+   int i,d;
 
-      // calculate absorption
-      for (ptr=ADATA,r=0; r<RES; r++)
-         for (c=0; c<RES; c++)
-            if (c==r || !preint)
-               {
-               *ptr++=quant(1.0f-prepow1(exp_ra,RA[c]));
-               *ptr++=quant(1.0f-prepow2(exp_ga,GA[c]));
-               *ptr++=quant(1.0f-prepow3(exp_ba,BA[c]));
-               }
-            else
-               {
-               *ptr++=quant(1.0f-prepow1(exp_ra,fabs((PRA[c]-PRA[r])/(c-r))));
-               *ptr++=quant(1.0f-prepow2(exp_ga,fabs((PGA[c]-PGA[r])/(c-r))));
-               *ptr++=quant(1.0f-prepow3(exp_ba,fabs((PBA[c]-PBA[r])/(c-r))));
-               }
-      }
+   float w;
 
-   invert2D(RGBA);
+   for (i=0; i<n; i++)
+      {
+      // the diagonal entry is replaced afterwards
+      d=c+i-r;
+      w=1.0f/(d+(d==0));
 
-   CHANGED=FALSE;
+      re[i]=fabs((PRE[c+i]-PRE[r])*w);
+      ge[i]=fabs((PGE[c+i]-PGE[r])*w);
+      be[i]=fabs((PBE[c+i]-PBE[r])*w);
 
-   return(TRUE);
+      ra[i]=fabs((PRA[c+i]-PRA[r])*w);
+      ga[i]=fabs((PGA[c+i]-PGA[r])*w);
+      ba[i]=fabs((PBA[c+i]-PBA[r])*w);
+      }
    }
 
 // check visibility via ZOT (Zero Opacity Test)
@@ -589,6 +731,20 @@ void tfunc::preint(BOOLINT premult)
    LAST_MLT=premult;
    }
 
+// get the maximum emission and absorption of each entry
+void tfunc::get_vis(float *vis)
+   {
+   int c;
+
+   for (c=0; c<RES; c++)
+      if (LAST_MLT)
+         vis[c]=fmax(fmax(RE[c]*RA[c],fmax(GE[c]*GA[c],BE[c]*BA[c])),
+                     fmax(RA[c],fmax(GA[c],BA[c])));
+      else
+         vis[c]=fmax(fmax(RE[c],fmax(GE[c],BE[c])),
+                     fmax(RA[c],fmax(GA[c],BA[c])));
+   }
+
 // check transparency via MOT (Minimum Opacity Test)
 BOOLINT tfunc::mot(float mindata,float maxdata)
    {
@@ -597,29 +753,55 @@ BOOLINT tfunc::mot(float mindata,float maxdata)
    int minpos=ftrc(ffloor((RES-1)*mindata));
    int maxpos=ftrc(fceil((RES-1)*maxdata));
 
-   return(PMIN[minpos+maxpos*RES]<tolerance);
+   int k;
+
+   if (minpos>maxpos)
+      {
+      k=minpos;
+      minpos=maxpos;
+      maxpos=k;
+      }
+
+   // two overlapping power-of-two ranges cover the queried range
+   k=PLOG[maxpos-minpos+1];
+
+   return(fmin(PMIN[minpos+k*RES],PMIN[maxpos-(1<<k)+1+k*RES])<tolerance);
    }
 
 // precompute minimum opacity
 void tfunc::premin()
    {
-   int c,r,s;
+   int c,k;
 
    float val;
 
-   for (r=0; r<RES; r++)
-      for (c=0; c<=r; c++)
-         {
-         val=1.0f;
+   BOOLINT changed;
 
-         for (s=c; s<=r; s++) val=fmin(val,fmax(RA[s],fmax(GA[s],BA[s])));
+   // the table only needs to be rebuilt if the opacity has changed
+   changed=!PVALID;
 
-         PMIN[c+r*RES]=val;
-         }
+   for (c=0; c<RES; c++)
+      {
+      val=fmax(RA[c],fmax(GA[c],BA[c]));
+
+      if (val!=POPA[c])
+         {
+         POPA[c]=val;
+         changed=TRUE;
+         }
+      }
+
+   if (!changed) return;
+
+   // the first level holds the opacity itself
+   for (c=0; c<RES; c++) PMIN[c]=POPA[c];
 
-   for (r=0; r<RES; r++)
-      for (c=r+1; c<RES; c++)
-         PMIN[c+r*RES]=PMIN[r+c*RES];
+   // each level combines two ranges of the level below
+   for (k=1; k<PLEVELS; k++)
+      for (c=0; c+(1<<k)<=RES; c++)
+         PMIN[c+k*RES]=fmin(PMIN[c+(k-1)*RES],PMIN[c+(1<<(k-1))+(k-1)*RES]);
+
+   PVALID=TRUE;
    }
 
 // set scaling of emission
@@ -629,7 +811,7 @@ void tfunc::set_escale(float re,float ge,float be)
 
    if (fabs(re-RE_SCALE)>tolerance ||
        fabs(ge-GE_SCALE)>tolerance ||
-       fabs(be-BE_SCALE)>tolerance) CHANGED=TRUE;
+       fabs(be-BE_SCALE)>tolerance) touchall();
 
    RE_SCALE=re;
    GE_SCALE=ge;
@@ -643,7 +825,7 @@ void tfunc::set_ascale(float ra,float ga,float ba)
 
    if (fabs(ra-RA_SCALE)>tolerance ||
        fabs(ga-GA_SCALE)>tolerance ||
-       fabs(ba-BA_SCALE)>tolerance) CHANGED=TRUE;
+       fabs(ba-BA_SCALE)>tolerance) touchall();
 
    RA_SCALE=ra;
    GA_SCALE=ga;
@@ -671,7 +853,7 @@ void tfunc::set_imp(float imp)
    {
    const float tolerance=1.0E-6f;
 
-   if (fabs(imp-IMPORTANCE)>tolerance) CHANGED=TRUE;
+   if (fabs(imp-IMPORTANCE)>tolerance) touchall();
 
    IMPORTANCE=imp;
    }
@@ -682,7 +864,7 @@ void tfunc::set_invmode(BOOLINT invmode)
    if (INVMODE!=invmode)
       {
       INVMODE=invmode;
-      CHANGED=TRUE;
+      touchall();
       }
    }
 
@@ -696,7 +878,7 @@ void tfunc::set_re(float *re)
    for (i=0; i<RES; i++)
       if (fabs(re[i]-RE[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          RE[i]=re[i];
          }
    }
@@ -711,7 +893,7 @@ void tfunc::set_ge(float *ge)
    for (i=0; i<RES; i++)
       if (fabs(ge[i]-GE[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          GE[i]=ge[i];
          }
    }
@@ -726,7 +908,7 @@ void tfunc::set_be(float *be)
    for (i=0; i<RES; i++)
       if (fabs(be[i]-BE[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          BE[i]=be[i];
          }
    }
@@ -741,7 +923,7 @@ void tfunc::set_ra(float *ra)
    for (i=0; i<RES; i++)
       if (fabs(ra[i]-RA[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          RA[i]=ra[i];
          }
    }
@@ -756,7 +938,7 @@ void tfunc::set_ga(float *ga)
    for (i=0; i<RES; i++)
       if (fabs(ga[i]-GA[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          GA[i]=ga[i];
          }
    }
@@ -771,7 +953,7 @@ void tfunc::set_ba(float *ba)
    for (i=0; i<RES; i++)
       if (fabs(ba[i]-BA[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          BA[i]=ba[i];
          }
    }
@@ -786,7 +968,7 @@ void tfunc::copy_tf(float *src,float *tf)
    for (i=0; i<RES; i++)
       if (fabs(src[i]-tf[i])>tolerance)
          {
-         CHANGED=TRUE;
+         touch(i);
          tf[i]=src[i];
          }
    }
@@ -812,7 +994,7 @@ void tfunc::set_line(float x1,float y1,float x2,float y2,float *tf)
       for (i=c1; i<=c2; i++)
          if (i>=0 && i<=RES-1)
             {
-            if (fabs(y-tf[i])>tolerance) CHANGED=TRUE;
+            if (fabs(y-tf[i])>tolerance) touch(i);
 
             tf[i]=y;
             y+=(y2-y1)/(c2-c1+1);
@@ -823,7 +1005,7 @@ void tfunc::set_line(float x1,float y1,float x2,float y2,float *tf)
       for (i=c1; i>=c2; i--)
          if (i>=0 && i<=RES-1)
             {
-            if (fabs(y-tf[i])>tolerance) CHANGED=TRUE;
+            if (fabs(y-tf[i])>tolerance) touch(i);
 
             tf[i]=y;
             y+=(y2-y1)/(c1-c2+1);
@@ -1011,7 +1193,7 @@ void tfunc::randomize()
       BE[i]=rgb[2];
       }
 
-   CHANGED=TRUE;
+   touchall();
 
    free(hue);
    free(sat);
@@ -1106,7 +1288,7 @@ void tfunc::load(FILE *file)
 
    IMPORTANCE=1.0f;
 
-   CHANGED=TRUE;
+   touchall();
    }
 
 // a 2D transfer function:
@@ -1131,6 +1313,24 @@ tfunc2D::tfunc2D(int res)
    MODE=0;
 
    EID=AID=0;
+   CID[0]=CID[1]=CID[2]=0;
+
+   TEXDIM=0;
+   TEXRGBA=FALSE;
+   TEXFLOAT=FALSE;
+
+   FLOATREQ=TRUE;
+   FLOATSUP=-1;
+
+   ECORR=ACORR=1.0f;
+
+   WINLO=0.0f;
+   WINHI=1.0f;
+
+   STAMP=1;
+
+   ZTAB=NULL;
+   ZNUM=ZLEVELS=0;
    }
 
 tfunc2D::~tfunc2D()
@@ -1140,8 +1340,12 @@ tfunc2D::~tfunc2D()
    for (i=0; i<NUM; i++) delete TF[i];
    delete TF;
 
+   if (ZTAB!=NULL) delete[] ZTAB;
+
    deletetexmap(EID);
    deletetexmap(AID);
+
+   for (i=0; i<3; i++) deletetexmap(CID[i]);
    }
 
 // set number of transfer functions
@@ -1166,13 +1370,15 @@ void tfunc2D::set_num(int num)
    TF=tf;
 
    IMPORTANT=FALSE;
-
    update();
 
    deletetexmap(EID);
    deletetexmap(AID);
 
+   for (i=0; i<3; i++) deletetexmap(CID[i]);
+
    EID=AID=0;
+   CID[0]=CID[1]=CID[2]=0;
    }
 
 // set mode of 2D transfer function setup:
@@ -1221,172 +1427,426 @@ void tfunc2D::refresh(const float emission,
                       BOOLINT preint,
                       BOOLINT light)
    {
-   int i;
+   int i,n;
 
-   unsigned char *data;
+   int dim;
 
-   BOOLINT useRGBA;
+   BOOLINT useRGBA,useFLT;
    BOOLINT changed=FALSE;
+   BOOLINT rebuild;
+
+   int edited;
+   BOOLINT bylayer;
+
+   layers l;
 
    useRGBA=checkRGBA();
-   if (EID==0) changed=TRUE;
 
-   if (NUM==1)
-      if (!preint)
+   // slab-independent float tables require float textures and fragment programs
+   if (FLOATSUP<0)
+      {
+      char *GL_EXTs;
+
+      FLOATSUP=0;
+
+#if defined(GL_ARB_texture_float) && defined(GL_ARB_fragment_program)
+      if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))!=NULL)
+         if (strstr(GL_EXTs,"ARB_texture_float")!=NULL &&
+             strstr(GL_EXTs,"ARB_fragment_program")!=NULL) FLOATSUP=1;
+#endif
+      }
+
+   useFLT=FLOATREQ && FLOATSUP>0;
+
+   // the float tables are scaled per fragment
+   ECORR=emission*slab;
+   ACORR=density*slab;
+
+   // layout of the textures
+   if (NUM==1) dim=preint?2:1;
+   else dim=(!preint && !light)?3:4;
+
+   // the textures are updated in place unless their layout has changed
+   rebuild=(EID==0 || dim!=TEXDIM || useRGBA!=TEXRGBA || useFLT!=TEXFLOAT);
+   if (rebuild) changed=TRUE;
+
+   n=(NUM==1)?1:NUM;
+
+   l.tf=this;
+
+   l.emission=emission;
+   l.density=density;
+   l.slab=slab;
+
+   l.premult=premult;
+   l.preint=preint;
+   l.RGBA=useRGBA;
+   l.flt=useFLT;
+
+   l.dim=dim;
+   l.changed=new BOOLINT[n];
+
+   // the layers are shared among the threads if enough of them were edited
+   for (edited=i=0; i<n; i++)
+      if (TF[i]->is_edited()) edited++;
+
+   bylayer=(n>1 && (dim==3 || edited>=getthreads()));
+
+   // otherwise the rows of each layer are shared among the threads
+   for (i=0; i<n; i++) TF[i]->set_threaded(!bylayer);
+
+   // refresh all transfer functions
+   if (bylayer) parallelfor(n,refreshlayer,&l);
+   else
+      for (i=0; i<n; i++) refreshlayer(i,&l);
+
+   // update the slices of the changed transfer functions
+   for (i=0; i<n; i++)
+      if (l.changed[i])
          {
-         // refresh the transfer function
-         if (TF[0]->refresh1D(emission,density,slab,premult,useRGBA)) changed=TRUE;
+         if (!rebuild) updatetex(i,dim,preint,useRGBA,useFLT);
+         changed=TRUE;
+         }
 
-         if (!changed) return;
+   delete[] l.changed;
 
-         // delete old textures
-         deletetexmap(EID);
-         deletetexmap(AID);
+   if (!changed) return;
 
-         if (useRGBA)
-            {
-            // generate new 1D RGBA emission/absorption texture
-            EID=buildtexmap1DRGBA(TF[0]->get_pre_e(),RES);
+   if (rebuild)
+      {
+      // delete old textures
+      deletetexmap(EID);
+      deletetexmap(AID);
 
-            // separate absorption texture is unused
-            AID=0;
-            }
-         else
-            {
-            // generate new 1D RGB emission texture
-            EID=buildtexmap1DRGB(TF[0]->get_pre_e(),RES);
+      for (i=0; i<3; i++) deletetexmap(CID[i]);
 
-            // generate new 1D RGB absorption texture
-            AID=buildtexmap1DRGB(TF[0]->get_pre_a(),RES);
-            }
+      if (useRGBA)
+         {
+         // generate new RGBA emission/absorption texture
+         EID=buildtex(dim,FALSE,4,useFLT);
+
+         // separate absorption textures are unused
+         AID=0;
+         CID[0]=CID[1]=CID[2]=0;
          }
       else
          {
-         // refresh the transfer function
-         if (TF[0]->refresh2D(emission,density,slab,premult,preint,useRGBA)) changed=TRUE;
+         // generate new RGB emission texture
+         EID=buildtex(dim,FALSE,3,useFLT);
 
-         if (!changed) return;
+         // generate new RGB absorption texture
+         AID=buildtex(dim,TRUE,3,useFLT);
 
-         // delete old textures
-         deletetexmap(EID);
-         deletetexmap(AID);
+         // generate new RGBA emission/absorption textures of each channel
+         for (i=0; i<3; i++) CID[i]=buildtex(dim,FALSE,4,useFLT,i);
+         }
 
-         if (useRGBA)
-            {
-            // generate new 2D RGBA emission/absorption texture
-            EID=buildtexmap2DRGBA(TF[0]->get_pre_e(),RES,RES);
+      TEXDIM=dim;
+      TEXRGBA=useRGBA;
+      TEXFLOAT=useFLT;
+      }
 
-            // separate absorption texture is unused
-            AID=0;
-            }
-         else
-            {
-            // generate new 2D RGB emission texture
-            EID=buildtexmap2DRGB(TF[0]->get_pre_e(),RES,RES);
+   // the pre-integrated transfer functions have changed
+   buildzot();
+   }
 
-            // generate new 2D RGB absorption texture
-            AID=buildtexmap2DRGB(TF[0]->get_pre_a(),RES,RES);
-            }
-         }
+// refresh the table of one transfer function
+void tfunc2D::refreshlayer(int i,void *data)
+   {
+   layers *l=(layers *)data;
+   tfunc *tf=l->tf->TF[i];
+
+   if (l->dim==1 || l->dim==3)
+      l->changed[i]=tf->refresh1D(l->emission,l->density,l->slab,l->premult,l->RGBA,l->flt);
+   else
+      l->changed[i]=tf->refresh2D(l->emission,l->density,l->slab,l->premult,l->preint,l->RGBA,l->flt);
+   }
+
+// get the table of one transfer function as bytes or floats
+void *tfunc2D::gettable(int i,BOOLINT absorption,BOOLINT flt)
+   {
+   if (flt)
+      if (absorption) return(TF[i]->get_pre_fa());
+      else return(TF[i]->get_pre_fe());
    else
-      if (!preint && !light)
+      if (absorption) return(TF[i]->get_pre_a());
+      else return(TF[i]->get_pre_e());
+   }
+
+// interleave the emission and the absorption of one channel into an RGBA table
+// the emission is replicated into the rgb components and the absorption goes into alpha
+unsigned char *tfunc2D::getchannel(int i,int c,int dim,BOOLINT flt)
+   {
+   int j,k;
+
+   int cells;
+   unsigned char *data;
+
+   cells=RES*((dim==1 || dim==3)?1:RES);
+
+   data=new unsigned char[4*cells*(flt?sizeof(float):1)];
+
+   if (flt)
+      {
+      float *e=(float *)gettable(i,FALSE,TRUE);
+      float *a=(float *)gettable(i,TRUE,TRUE);
+      float *d=(float *)data;
+
+      for (j=0; j<cells; j++)
          {
-         // refresh all transfer functions
-         for (i=0; i<NUM; i++)
-            if (TF[i]->refresh1D(emission,density,slab,premult,useRGBA)) changed=TRUE;
+         for (k=0; k<3; k++) d[4*j+k]=e[3*j+c];
+         d[4*j+3]=a[3*j+c];
+         }
+      }
+   else
+      {
+      unsigned char *e=(unsigned char *)gettable(i,FALSE,FALSE);
+      unsigned char *a=(unsigned char *)gettable(i,TRUE,FALSE);
 
-         if (!changed) return;
+      for (j=0; j<cells; j++)
+         {
+         for (k=0; k<3; k++) data[4*j+k]=e[3*j+c];
+         data[4*j+3]=a[3*j+c];
+         }
+      }
 
-         // delete old textures
-         deletetexmap(EID);
-         deletetexmap(AID);
+   return(data);
+   }
 
-         if (useRGBA)
-            {
-            data=new unsigned char[4*RES*NUM];
+// build the emission or absorption texture of all transfer functions
+// or the combined emission/absorption texture of one channel
+int tfunc2D::buildtex(int dim,BOOLINT absorption,int components,BOOLINT flt,int channel)
+   {
+   int i;
 
-            // memcopy transfer functions
-            for (i=0; i<NUM; i++)
-               memcpy(&data[4*RES*i],TF[i]->get_pre_e(),4*RES);
+   int texid;
 
-            // generate new 2D RGBA emission/absorption texture
-            EID=buildtexmap2DRGBA(data,RES,NUM);
+   unsigned char *data,*table;
+   int size;
 
-            // separate absorption texture is unused
-            AID=0;
+   // 1D or 2D table of a single transfer function
+   if (dim==1 || dim==2)
+      {
+      if (channel<0) table=(unsigned char *)gettable(0,absorption,flt);
+      else table=getchannel(0,channel,dim,flt);
 
-            delete data;
-            }
-         else
-            {
-            data=new unsigned char[3*RES*NUM];
+      if (dim==1) texid=buildtexmap1D(table,RES,components,flt);
+      else texid=buildtexmap2D(table,RES,RES,components,flt);
 
-            // memcopy transfer functions
-            for (i=0; i<NUM; i++)
-               memcpy(&data[3*RES*i],TF[i]->get_pre_e(),3*RES);
+      if (channel>=0) delete[] table;
 
-            // generate new 2D RGB emission texture
-            EID=buildtexmap2DRGB(data,RES,NUM);
+      return(texid);
+      }
 
-            // memcopy transfer functions
-            for (i=0; i<NUM; i++)
-               memcpy(&data[3*RES*i],TF[i]->get_pre_a(),3*RES);
+   // size of one table in bytes
+   size=components*RES*((dim==3)?1:RES)*(flt?sizeof(float):1);
 
-            // generate new 2D RGB absorption texture
-            AID=buildtexmap2DRGB(data,RES,NUM);
+   data=new unsigned char[size*NUM];
 
-            delete data;
-            }
-         }
+   // memcopy transfer functions or pre-integrated slices
+   for (i=0; i<NUM; i++)
+      if (channel<0) memcpy(&data[size*i],gettable(i,absorption,flt),size);
       else
          {
-         // refresh all transfer functions
-         for (i=0; i<NUM; i++)
-            if (TF[i]->refresh2D(emission,density,slab,premult,preint,useRGBA)) changed=TRUE;
+         table=getchannel(i,channel,dim,flt);
+         memcpy(&data[size*i],table,size);
+         delete[] table;
+         }
 
-         if (!changed) return;
+   // generate new layered 2D or 3D texture
+   if (dim==3) texid=buildtexmap2D(data,RES,NUM,components,flt);
+   else texid=buildtexmap3D(data,RES,RES,NUM,components,flt);
 
-         // delete old textures
-         deletetexmap(EID);
-         deletetexmap(AID);
+   delete[] data;
 
-         if (useRGBA)
-            {
-            data=new unsigned char[4*RES*RES*NUM];
+   return(texid);
+   }
 
-            // memcopy pre-integrated slices
-            for (i=0; i<NUM; i++)
-               memcpy(&data[4*RES*RES*i],TF[i]->get_pre_e(),4*RES*RES);
+// update the dirty part of the textures of one transfer function
+void tfunc2D::updatetex(int i,int dim,BOOLINT preint,BOOLINT RGBA,BOOLINT flt)
+   {
+   int k,n,c;
 
-            // generate new 3D RGBA emission/absorption texture
-            EID=buildtexmap3DRGBA(data,RES,RES,NUM);
+   int minpos,maxpos;
+   int rect[3][4];
 
-            // separate absorption texture is unused
-            AID=0;
+   void *edata,*adata;
+   unsigned char *cdata;
+   int comps;
 
-            delete data;
-            }
-         else
-            {
-            data=new unsigned char[3*RES*RES*NUM];
+   TF[i]->get_dirty(&minpos,&maxpos);
 
-            // memcopy pre-integrated slices
-            for (i=0; i<NUM; i++)
-               memcpy(&data[3*RES*RES*i],TF[i]->get_pre_e(),3*RES*RES);
+   // dirty rectangles of the table
+   if (dim==1 || dim==3 || !preint)
+      {
+      rect[0][0]=minpos;
+      rect[0][1]=0;
+      rect[0][2]=maxpos-minpos+1;
+      rect[0][3]=(dim==1 || dim==3)?1:RES;
+
+      n=1;
+      }
+   else
+      {
+      // rows within the edited range
+      rect[0][0]=0;
+      rect[0][1]=minpos;
+      rect[0][2]=RES;
+      rect[0][3]=maxpos-minpos+1;
+
+      // integrals from below into the edited range
+      rect[1][0]=minpos;
+      rect[1][1]=0;
+      rect[1][2]=RES-minpos;
+      rect[1][3]=minpos;
+
+      // integrals from above into the edited range
+      rect[2][0]=0;
+      rect[2][1]=maxpos+1;
+      rect[2][2]=maxpos+1;
+      rect[2][3]=RES-1-maxpos;
+
+      n=3;
+      }
 
-            // generate new 3D RGB emission texture
-            EID=buildtexmap3DRGB(data,RES,RES,NUM);
+   edata=gettable(i,FALSE,flt);
+   adata=gettable(i,TRUE,flt);
 
-            // memcopy pre-integrated slices
-            for (i=0; i<NUM; i++)
-               memcpy(&data[3*RES*RES*i],TF[i]->get_pre_a(),3*RES*RES);
+   comps=RGBA?4:3;
 
-            // generate new 3D RGB absorption texture
-            AID=buildtexmap3DRGB(data,RES,RES,NUM);
+   for (k=0; k<n; k++)
+      {
+      if (rect[k][2]<=0 || rect[k][3]<=0) continue;
 
-            delete data;
-            }
+      updatetexrect(EID,edata,comps,flt,dim,i,rect[k]);
+      if (!RGBA) updatetexrect(AID,adata,3,flt,dim,i,rect[k]);
+      }
+
+   // the per-channel tables are updated from an interleaved copy
+   if (!RGBA)
+      for (c=0; c<3; c++)
+         {
+         cdata=getchannel(i,c,dim,flt);
+
+         for (k=0; k<n; k++)
+            if (rect[k][2]>0 && rect[k][3]>0)
+               updatetexrect(CID[c],cdata,4,flt,dim,i,rect[k]);
+
+         delete[] cdata;
+         }
+   }
+
+// update one dirty rectangle of the texture of one transfer function
+void tfunc2D::updatetexrect(int texid,void *data,int components,BOOLINT flt,int dim,int i,int rect[4])
+   {
+   switch (dim)
+      {
+      case 1:
+         // both rows of the 1D texture hold the same table
+         updatetexmap2D(texid,data,RES,components,flt,rect[0],0,rect[2],1,0);
+         updatetexmap2D(texid,data,RES,components,flt,rect[0],0,rect[2],1,1);
+         break;
+      case 2:
+         updatetexmap2D(texid,data,RES,components,flt,rect[0],rect[1],rect[2],rect[3]);
+         break;
+      case 3:
+         updatetexmap2D(texid,data,RES,components,flt,rect[0],0,rect[2],1,i);
+         break;
+      default:
+         updatetexmap3D(texid,data,RES,components,flt,rect[0],rect[1],i,rect[2],rect[3]);
+         break;
+      }
+   }
+
+// build the range table of the ZOT
+// each row holds the prefix sum of the maximum visibility of a power-of-two range of transfer functions
+void tfunc2D::buildzot()
+   {
+   int i,k,c;
+
+   float *row,*row1,*row2;
+
+   STAMP++;
+
+   if (ZTAB!=NULL) delete[] ZTAB;
+
+   ZTAB=NULL;
+   ZNUM=0;
+
+   if (NUM<2) return;
+
+   for (ZLEVELS=1; (1<<ZLEVELS)<=NUM; ZLEVELS++);
+
+   ZTAB=new float[ZLEVELS*NUM*RES];
+
+   // the first level holds the visibility of each transfer function
+   for (i=0; i<NUM; i++) TF[i]->get_vis(&ZTAB[i*RES]);
+
+   // each level combines two ranges of the level below
+   for (k=1; k<ZLEVELS; k++)
+      for (i=0; i+(1<<k)<=NUM; i++)
+         {
+         row=&ZTAB[(k*NUM+i)*RES];
+         row1=&ZTAB[((k-1)*NUM+i)*RES];
+         row2=&ZTAB[((k-1)*NUM+i+(1<<(k-1)))*RES];
+
+         for (c=0; c<RES; c++) row[c]=fmax(row1[c],row2[c]);
          }
+
+   // sum up the visibility of each row
+   for (k=0; k<ZLEVELS; k++)
+      for (i=0; i+(1<<k)<=NUM; i++)
+         for (row=&ZTAB[(k*NUM+i)*RES],c=1; c<RES; c++) row[c]+=row[c-1];
+
+   ZNUM=NUM;
+   }
+
+// check visibility of a range of transfer functions via the range table
+inline BOOLINT tfunc2D::zotrange(int minpos,int maxpos,int minc,int maxc)
+   {
+   const float tolerance=1.0E-3f;
+
+   int k;
+
+   float *row1,*row2;
+
+   // two overlapping power-of-two ranges cover the queried range
+   for (k=0; (2<<k)<=maxpos-minpos+1; k++);
+
+   row1=&ZTAB[(k*NUM+minpos)*RES];
+   row2=&ZTAB[(k*NUM+maxpos-(1<<k)+1)*RES];
+
+   if (minc==maxc)
+      if (minc==0) return(row1[0]<tolerance && row2[0]<tolerance);
+      else return(row1[minc]-row1[minc-1]<tolerance && row2[minc]-row2[minc-1]<tolerance);
+
+   return(row1[maxc]-row1[minc]<tolerance && row2[maxc]-row2[minc]<tolerance);
+   }
+
+// set the window of data values that is covered by the transfer functions
+void tfunc2D::set_window(float lo,float hi)
+   {
+   if (lo<0.0f || hi>1.0f || lo>=hi) ERRORMSG();
+
+   if (lo!=WINLO || hi!=WINHI)
+      {
+      WINLO=lo;
+      WINHI=hi;
+
+      // the visibility of the data ranges has changed
+      STAMP++;
+      }
+   }
+
+// map a data value into the window
+inline float tfunc2D::window(float v)
+   {
+   v=(v-WINLO)/(WINHI-WINLO);
+
+   if (v<0.0f) v=0.0f;
+   else if (v>1.0f) v=1.0f;
+
+   return(v);
    }
 
 // check visibility via ZOT (Zero Opacity Test)
@@ -1394,9 +1854,15 @@ BOOLINT tfunc2D::zot(float mindata,float maxdata)
    {
    int i;
 
+   mindata=window(mindata);
+   maxdata=window(maxdata);
+
    if (MODE==0) return(TF[0]->zot(mindata,maxdata));
    else if (MODE>=1 && MODE<=9) return(TF[NUM-1]->zot(mindata,maxdata));
 
+   if (ZNUM==NUM)
+      return(zotrange(0,NUM-1,ftrc(ffloor((RES-1)*mindata)),ftrc(fceil((RES-1)*maxdata))));
+
    for (i=0; i<NUM; i++)
       if (!TF[i]->zot(mindata,maxdata)) return(FALSE);
 
@@ -1412,9 +1878,15 @@ BOOLINT tfunc2D::zot(float mindata,float maxdata,
    int minpos=ftrc(ffloor((NUM-1)*minextra));
    int maxpos=ftrc(fceil((NUM-1)*maxextra));
 
+   mindata=window(mindata);
+   maxdata=window(maxdata);
+
    if (MODE==0) return(TF[0]->zot(mindata,maxdata));
    else if (MODE>=1 && MODE<=9) return(TF[maxpos]->zot(mindata,maxdata));
 
+   if (ZNUM==NUM)
+      return(zotrange(minpos,maxpos,ftrc(ffloor((RES-1)*mindata)),ftrc(fceil((RES-1)*maxdata))));
+
    for (i=minpos; i<=maxpos; i++)
       if (!TF[i]->zot(mindata,maxdata)) return(FALSE);
 
@@ -1429,6 +1901,8 @@ void tfunc2D::preint(BOOLINT premult)
    if (MODE==0) TF[0]->preint(premult);
    else if (MODE>=1 && MODE<=9) TF[NUM-1]->preint(premult);
    else for (i=0; i<NUM; i++) TF[i]->preint(premult);
+
+   buildzot();
    }
 
 // check transparency via MOT (Minimum Opacity Test)
@@ -1436,6 +1910,9 @@ BOOLINT tfunc2D::mot(float mindata,float maxdata)
    {
    int i;
 
+   mindata=window(mindata);
+   maxdata=window(maxdata);
+
    if (MODE==0) return(TF[0]->mot(mindata,maxdata));
    else if (MODE>=1 && MODE<=9) return(TF[NUM-1]->mot(mindata,maxdata));
 
@@ -1454,6 +1931,9 @@ BOOLINT tfunc2D::mot(float mindata,float maxdata,
    int minpos=ftrc(ffloor((NUM-1)*minextra));
    int maxpos=ftrc(fceil((NUM-1)*maxextra));
 
+   mindata=window(mindata);
+   maxdata=window(maxdata);
+
    if (MODE==0) return(TF[0]->mot(mindata,maxdata));
    else if (MODE>=1 && MODE<=9) return(TF[maxpos]->mot(mindata,maxdata));
 
@@ -1889,7 +2369,10 @@ float tfunc2D::get_nonzero_min()
    for (i=0; i<NUM; i++)
       nzmin=fmin(nzmin,TF[i]->get_nonzero_min());
 
-   return(nzmin);
+   // values below the window are visible if the lower boundary is
+   if (nzmin<=0.0f) return(0.0f);
+
+   return(WINLO+nzmin*(WINHI-WINLO));
    }
 
 // get maximum scalar value with non-zero opacity
@@ -1904,7 +2387,10 @@ float tfunc2D::get_nonzero_max()
    for (i=0; i<NUM; i++)
       nzmax=fmax(nzmax,TF[i]->get_nonzero_max());
 
-   return(nzmax);
+   // values above the window are visible if the upper boundary is
+   if (nzmax>=1.0f) return(1.0f);
+
+   return(WINLO+nzmax*(WINHI-WINLO));
    }
 
 // save2file
@@ -1924,6 +2410,8 @@ void tfunc2D::save(FILE *file)
    fprintf(file,"gascale=%g\n",GA_SCALE);
    fprintf(file,"bascale=%g\n",BA_SCALE);
 
+   fprintf(file,"win=%g %g\n",WINLO,WINHI);
+
    for (i=0; i<NUM; i++) TF[i]->save(file);
    }
 
@@ -1932,6 +2420,8 @@ void tfunc2D::load(FILE *file)
    {
    int i,num;
 
+   float lo,hi;
+
    if (fscanf(file,"2DTF:\n")!=0) return;
 
    fscanf(file,"num=%d\n",&num);
@@ -1946,6 +2436,12 @@ void tfunc2D::load(FILE *file)
    fscanf(file,"gascale=%g\n",&GA_SCALE);
    fscanf(file,"bascale=%g\n",&BA_SCALE);
 
+   // the window is optional since older files do not contain it
+   if (fscanf(file,"win=%g %g\n",&lo,&hi)!=2) {lo=0.0f; hi=1.0f;}
+   if (lo<0.0f || hi>1.0f || lo>=hi) {lo=0.0f; hi=1.0f;}
+
+   set_window(lo,hi);
+
    for (i=0; i<NUM; i++) TF[i]->load(file);
 
    IMPORTANT=FALSE;
@@ -2018,56 +2514,58 @@ void tfunc2D::update()
             TF[i]->set_ba(get_ba());
             }
          }
+
+   // the range table is rebuilt with the next refresh
+   ZNUM=0;
+   STAMP++;
    }
 
-// return id of 1D RGB texture map
-int tfunc2D::buildtexmap1DRGB(unsigned char *table,int size)
+// get the texture format of a table
+void tfunc2D::texformat(int components,BOOLINT flt,
+                        GLint *internal,GLenum *format,GLenum *type)
    {
-   GLuint texid;
-
-   unsigned char *table2;
-
-   if (size<2) ERRORMSG();
-
-   if ((table2=(unsigned char *)malloc(6*size))==NULL) ERRORMSG();
-
-   memcpy(table2,table,3*size);
-   memcpy(table2+3*size,table,3*size);
-
-   glGenTextures(1,&texid);
-   glBindTexture(GL_TEXTURE_2D,texid);
-
-   glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-   glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,size,2,0,
-                GL_RGB,GL_UNSIGNED_BYTE,table2);
-
-   glBindTexture(GL_TEXTURE_2D,0);
-
-   free(table2);
+   *format=(components==4)?GL_RGBA:GL_RGB;
+   *type=GL_UNSIGNED_BYTE;
+   *internal=*format;
 
-   return(texid);
+#ifdef GL_ARB_texture_float
+   if (flt)
+      {
+      *internal=(components==4)?GL_RGBA16F_ARB:GL_RGB16F_ARB;
+      *type=GL_FLOAT;
+      }
+#endif
    }
 
-// return id of 1D RGBA texture map
-int tfunc2D::buildtexmap1DRGBA(unsigned char *table,int size)
+// return id of 1D RGB or RGBA texture map
+int tfunc2D::buildtexmap1D(void *table,int size,
+                           int components,BOOLINT flt)
    {
    GLuint texid;
 
+   GLint internal;
+   GLenum format,type;
+
    unsigned char *table2;
+   int bytes;
 
    if (size<2) ERRORMSG();
 
-   if ((table2=(unsigned char *)malloc(8*size))==NULL) ERRORMSG();
+   bytes=components*size*(flt?sizeof(float):1);
+
+   if ((table2=(unsigned char *)malloc(2*bytes))==NULL) ERRORMSG();
 
-   memcpy(table2,table,4*size);
-   memcpy(table2+4*size,table,4*size);
+   memcpy(table2,table,bytes);
+   memcpy(table2+bytes,table,bytes);
+
+   texformat(components,flt,&internal,&format,&type);
 
    glGenTextures(1,&texid);
    glBindTexture(GL_TEXTURE_2D,texid);
 
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-   glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,size,2,0,
-                GL_RGBA,GL_UNSIGNED_BYTE,table2);
+   glTexImage2D(GL_TEXTURE_2D,0,internal,size,2,0,
+                format,type,table2);
 
    glBindTexture(GL_TEXTURE_2D,0);
 
@@ -2076,65 +2574,55 @@ int tfunc2D::buildtexmap1DRGBA(unsigned char *table,int size)
    return(texid);
    }
 
-// return id of 2D RGB texture map
-int tfunc2D::buildtexmap2DRGB(unsigned char *image,
-                              int width,int height)
+// return id of 2D RGB or RGBA texture map
+int tfunc2D::buildtexmap2D(void *image,int width,int height,
+                           int components,BOOLINT flt)
    {
    GLuint texid;
 
-   if (width<2 || height<2) ERRORMSG();
-
-   glGenTextures(1,&texid);
-   glBindTexture(GL_TEXTURE_2D,texid);
-
-   glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-   glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,width,height,0,
-                GL_RGB,GL_UNSIGNED_BYTE,image);
-
-   glBindTexture(GL_TEXTURE_2D,0);
-
-   return(texid);
-   }
-
-// return id of 2D RGBA texture map
-int tfunc2D::buildtexmap2DRGBA(unsigned char *image,
-                               int width,int height)
-   {
-   GLuint texid;
+   GLint internal;
+   GLenum format,type;
 
    if (width<2 || height<2) ERRORMSG();
 
+   texformat(components,flt,&internal,&format,&type);
+
    glGenTextures(1,&texid);
    glBindTexture(GL_TEXTURE_2D,texid);
 
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-   glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width,height,0,
-                GL_RGBA,GL_UNSIGNED_BYTE,image);
+   glTexImage2D(GL_TEXTURE_2D,0,internal,width,height,0,
+                format,type,image);
 
    glBindTexture(GL_TEXTURE_2D,0);
 
    return(texid);
    }
 
-// return id of 3D RGB texture map
-int tfunc2D::buildtexmap3DRGB(unsigned char *volume,
-                              int width,int height,int depth)
+// return id of 3D RGB or RGBA texture map
+int tfunc2D::buildtexmap3D(void *volume,int width,int height,int depth,
+                           int components,BOOLINT flt)
    {
    GLuint texid;
 
+   GLint internal;
+   GLenum format,type;
+
    if (width<2 || height<2 || depth<2) ERRORMSG();
 
+   texformat(components,flt,&internal,&format,&type);
+
    glGenTextures(1,&texid);
    glBindTexture(GL_TEXTURE_3D,texid);
 
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
 #ifndef WINOS
-   glTexImage3D(GL_TEXTURE_3D,0,GL_RGB,width,height,depth,0,
-                GL_RGB,GL_UNSIGNED_BYTE,volume);
+   glTexImage3D(GL_TEXTURE_3D,0,internal,width,height,depth,0,
+                format,type,volume);
 #else
    PFNGLTEXIMAGE3DEXTPROC glTexImage3DEXT=(PFNGLTEXIMAGE3DEXTPROC)wglGetProcAddress("glTexImage3DEXT");
-   glTexImage3DEXT(GL_TEXTURE_3D,0,GL_RGB,width,height,depth,0,
-                   GL_RGB,GL_UNSIGNED_BYTE,volume);
+   glTexImage3DEXT(GL_TEXTURE_3D,0,internal,width,height,depth,0,
+                   format,type,volume);
 #endif
 
    glBindTexture(GL_TEXTURE_3D,0);
@@ -2142,30 +2630,53 @@ int tfunc2D::buildtexmap3DRGB(unsigned char *volume,
    return(texid);
    }
 
-// return id of 3D RGBA texture map
-int tfunc2D::buildtexmap3DRGBA(unsigned char *volume,
-                               int width,int height,int depth)
+// update a sub-rectangle of a 2D texture map
+void tfunc2D::updatetexmap2D(int texid,void *image,int width,int components,BOOLINT flt,
+                             int x,int y,int w,int h,int offset)
    {
-   GLuint texid;
+   GLint internal;
+   GLenum format,type;
 
-   if (width<2 || height<2 || depth<2) ERRORMSG();
+   texformat(components,flt,&internal,&format,&type);
+
+   glBindTexture(GL_TEXTURE_2D,texid);
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH,width);
+   glTexSubImage2D(GL_TEXTURE_2D,0,x,y+offset,w,h,
+                   format,type,
+                   (unsigned char *)image+components*(x+y*width)*(flt?sizeof(float):1));
+   glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+
+   glBindTexture(GL_TEXTURE_2D,0);
+   }
+
+// update a sub-rectangle of one slice of a 3D texture map
+void tfunc2D::updatetexmap3D(int texid,void *image,int width,int components,BOOLINT flt,
+                             int x,int y,int z,int w,int h)
+   {
+   GLint internal;
+   GLenum format,type;
+
+   texformat(components,flt,&internal,&format,&type);
 
-   glGenTextures(1,&texid);
    glBindTexture(GL_TEXTURE_3D,texid);
 
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH,width);
 #ifndef WINOS
-   glTexImage3D(GL_TEXTURE_3D,0,GL_RGBA,width,height,depth,0,
-                GL_RGBA,GL_UNSIGNED_BYTE,volume);
+   glTexSubImage3D(GL_TEXTURE_3D,0,x,y,z,w,h,1,
+                   format,type,
+                   (unsigned char *)image+components*(x+y*width)*(flt?sizeof(float):1));
 #else
-   PFNGLTEXIMAGE3DEXTPROC glTexImage3DEXT=(PFNGLTEXIMAGE3DEXTPROC)wglGetProcAddress("glTexImage3DEXT");
-   glTexImage3DEXT(GL_TEXTURE_3D,0,GL_RGBA,width,height,depth,0,
-                   GL_RGBA,GL_UNSIGNED_BYTE,volume);
+   PFNGLTEXSUBIMAGE3DEXTPROC glTexSubImage3DEXT=(PFNGLTEXSUBIMAGE3DEXTPROC)wglGetProcAddress("glTexSubImage3DEXT");
+   glTexSubImage3DEXT(GL_TEXTURE_3D,0,x,y,z,w,h,1,
+                      format,type,
+                      (unsigned char *)image+components*(x+y*width)*(flt?sizeof(float):1));
 #endif
+   glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
 
    glBindTexture(GL_TEXTURE_3D,0);
-
-   return(texid);
    }
 
 // delete texture map
@@ -2194,15 +2705,47 @@ histo::histo()
    EMIT=new float[256*256];
    ABSORB=new float[256*256];
 
+   LABEL=new int[256*256];
+   CELLS=new int[256*256];
+   REGION=new region[256*256];
+   REGIONS=0;
+
+   ORDER=new int[256*256];
+   ORDERS=0;
+
+   QUANT=new float[3*256*256];
+   QFREQ=0.0f;
+
    MINCNT=0;
    FREQ=0.0f;
 
+   RATE2D=1.0f;
+
    CLICKED=FALSE;
    CLICKs=CLICKt=0;
+
+   NEXT=NULL;
+
+   WORKER=NULL;
+   LOCK=createlock();
+
+   ANALYSIS=NULL;
+   ANALYZER=NULL;
+   ANALYZED=FALSE;
+
+   PRESETS=0;
+
+   AUTOLO=0.0f;
+   AUTOHI=1.0f;
    }
 
 histo::~histo()
    {
+   stop();
+   finish();
+
+   destroylock(LOCK);
+
    delete HIST2D;
    delete HIST2DL;
    delete HIST2DRGBA;
@@ -2215,6 +2758,13 @@ histo::~histo()
    delete STATE;
    delete EMIT;
    delete ABSORB;
+
+   delete[] LABEL;
+   delete[] CELLS;
+   delete[] REGION;
+
+   delete[] ORDER;
+   delete[] QUANT;
    }
 
 // update histograms
@@ -2225,20 +2775,471 @@ void histo::set_histograms(unsigned char *data,
                            int kneigh,float histstep,
                            void (*feedback)(const char *info,float percent,void *obj),void *obj)
    {
+   stop();
+
    inithist(data,width,height,depth,histmin,histfreq,TRUE,feedback,obj);
-   inithist2DQ(data,extra,width,height,depth,histmin,histfreq,kneigh,histstep,TRUE,feedback,obj);
+
+   // large volumes get an estimate from a low-discrepancy sample of the voxels first
+   initcentroids2D(data,extra,width,height,depth,kneigh,histstep,HISTSAMPLES,feedback,obj);
+   inithist2DQ(data,extra,width,height,depth,histmin,histfreq,kneigh,histstep,FALSE,feedback,obj);
+
+   // the estimate is refined to the exact result in the background
+   if (MULTI && RATE2D<1.0f) refine(data,extra,width,height,depth,kneigh,histstep);
+
+   analyze();
    }
 
-// get interpolated scalar value from volume
-unsigned char histo::getscalar(unsigned char *volume,
-                               unsigned int width,unsigned int height,unsigned int depth,
-                               float x,float y,float z)
+// refine the 2D histogram in the background
+void histo::refine(unsigned char *volume,unsigned char *grad,
+                   unsigned int width,unsigned int height,unsigned int depth,
+                   int kneigh,float step)
    {
-   int i,j,k;
+   REFINE.volume=volume;
+   REFINE.grad=grad;
 
-   unsigned char *ptr1,*ptr2;
+   REFINE.width=width;
+   REFINE.height=height;
+   REFINE.depth=depth;
 
-   x*=width-1;
+   REFINE.kneigh=kneigh;
+   REFINE.step=step;
+
+   NEXT=new histo;
+
+   CANCEL=DONE=FALSE;
+
+   WORKER=startthread(refineworker,this);
+   }
+
+// compute the exact 2D histogram
+void histo::refineworker(void *data)
+   {
+   histo *h=(histo *)data;
+   refinement *r=&h->REFINE;
+
+   h->NEXT->initcentroids2D(r->volume,r->grad,r->width,r->height,r->depth,r->kneigh,r->step,0,NULL,NULL,cancelled,h);
+
+   acquirelock(h->LOCK);
+   h->DONE=TRUE;
+   releaselock(h->LOCK);
+   }
+
+// check whether or not the refinement has been stopped
+BOOLINT histo::cancelled(void *data)
+   {
+   BOOLINT cancel;
+
+   histo *h=(histo *)data;
+
+   acquirelock(h->LOCK);
+   cancel=h->CANCEL;
+   releaselock(h->LOCK);
+
+   return(cancel);
+   }
+
+// stop the background refinement
+void histo::stop()
+   {
+   if (NEXT==NULL) return;
+
+   acquirelock(LOCK);
+   CANCEL=TRUE;
+   releaselock(LOCK);
+
+   jointhread(WORKER);
+   WORKER=NULL;
+
+   delete NEXT;
+   NEXT=NULL;
+   }
+
+// adopt the exact 2D histogram once the background refinement has finished
+BOOLINT histo::update()
+   {
+   int n;
+
+   BOOLINT done;
+
+   if (NEXT==NULL) return(FALSE);
+
+   acquirelock(LOCK);
+   done=DONE;
+   releaselock(LOCK);
+
+   if (!done) return(FALSE);
+
+   jointhread(WORKER);
+   WORKER=NULL;
+
+   for (n=0; n<256*256; n++)
+      {
+      HIST2D[n]=NEXT->HIST2D[n];
+      HIST2DL[n]=NEXT->HIST2DL[n];
+
+      centroid2D[3*n]=NEXT->centroid2D[3*n];
+      centroid2D[3*n+1]=NEXT->centroid2D[3*n+1];
+      centroid2D[3*n+2]=NEXT->centroid2D[3*n+2];
+
+      variance2D[n]=NEXT->variance2D[n];
+      }
+
+   RATE2D=NEXT->RATE2D;
+
+   // the regions marked by the user are kept
+   QFREQ=0.0f;
+   inithist2DQ(NULL,NULL,0,0,0,MINCNT,FREQ,REFINE.kneigh,REFINE.step,FALSE);
+
+   delete NEXT;
+   NEXT=NULL;
+
+   // the presets are derived anew from the exact histogram
+   analyze();
+
+   return(TRUE);
+   }
+
+// return the relative standard error of the least frequent visible 2D histogram bin
+float histo::get_hist2Derror()
+   {
+   if (!MULTI || RATE2D>=1.0f || MINCNT<1) return(0.0f);
+
+   // a visible bin is hit about mincnt*rate times by the samples of the estimate
+   return(fsqrt((1.0f-RATE2D)/(MINCNT*RATE2D)));
+   }
+
+// analyze the histograms in the background
+void histo::analyze()
+   {
+   int i;
+
+   finish();
+
+   ANALYSIS=new analysis;
+
+   for (i=0; i<256; i++) ANALYSIS->hist[i]=HIST[i];
+
+   if (MULTI)
+      {
+      ANALYSIS->hist2D=new double[256*256];
+      for (i=0; i<256*256; i++) ANALYSIS->hist2D[i]=HIST2D[i];
+      }
+   else ANALYSIS->hist2D=NULL;
+
+   ANALYZED=FALSE;
+
+   ANALYZER=startthread(analyzeworker,this);
+   }
+
+// wait for the histogram analysis and adopt its results
+void histo::finish()
+   {
+   int i;
+
+   if (ANALYSIS==NULL) return;
+
+   jointhread(ANALYZER);
+   ANALYZER=NULL;
+
+   for (i=0; i<ANALYSIS->presets; i++) PRESET[i]=ANALYSIS->ranked[i];
+   PRESETS=ANALYSIS->presets;
+
+   AUTOLO=ANALYSIS->lo;
+   AUTOHI=ANALYSIS->hi;
+
+   if (ANALYSIS->hist2D!=NULL) delete[] ANALYSIS->hist2D;
+   delete ANALYSIS;
+
+   ANALYSIS=NULL;
+   }
+
+// check whether or not the histogram analysis has finished
+BOOLINT histo::is_analyzed()
+   {
+   BOOLINT done;
+
+   if (ANALYSIS==NULL) return(TRUE);
+
+   acquirelock(LOCK);
+   done=ANALYZED;
+   releaselock(LOCK);
+
+   if (!done) return(FALSE);
+
+   finish();
+
+   return(TRUE);
+   }
+
+// return the number of ranked transfer function presets
+int histo::get_presets()
+   {
+   if (!is_analyzed()) return(0);
+   return(PRESETS);
+   }
+
+// return a ranked transfer function preset
+histo::preset *histo::get_preset(int rank)
+   {
+   if (!is_analyzed()) return(NULL);
+   if (rank<0 || rank>=PRESETS) return(NULL);
+   return(&PRESET[rank]);
+   }
+
+// return the automatic window of the scalar values
+void histo::get_autowindow(float *lo,float *hi)
+   {
+   if (!is_analyzed())
+      {
+      *lo=0.0f;
+      *hi=1.0f;
+      }
+   else
+      {
+      *lo=AUTOLO;
+      *hi=AUTOHI;
+      }
+   }
+
+// smooth a histogram with a box filter of radius 2
+inline void smoothhist(const float *in,float *out)
+   {
+   int i,j,n;
+
+   for (i=0; i<256; i++)
+      {
+      out[i]=0.0f;
+
+      for (n=0,j=i-2; j<=i+2; j++)
+         if (j>=0 && j<256)
+            {
+            out[i]+=in[j];
+            n++;
+            }
+
+      out[i]/=n;
+      }
+   }
+
+// find the valleys to the left and right of a peak
+inline void findvalleys(const float *h,int i,int *left,int *right)
+   {
+   for (*left=i; *left>0 && h[*left-1]<=h[*left]; (*left)--);
+   for (*right=i; *right<255 && h[*right+1]<=h[*right]; (*right)++);
+   }
+
+// find the prominence of a peak above the minima on either side up to the next higher value
+// without a higher value the minimum on that side is optionally at zero
+inline float findprominence(const float *h,int i,BOOLINT zero)
+   {
+   int j;
+
+   float l,r;
+
+   for (l=h[i],j=i-1; j>=0 && h[j]<=h[i]; j--)
+      if (h[j]<l) l=h[j];
+
+   if (j<0 && zero) l=0.0f;
+
+   for (r=h[i],j=i+1; j<256 && h[j]<=h[i]; j++)
+      if (h[j]<r) r=h[j];
+
+   if (j>255 && zero) r=0.0f;
+
+   return(h[i]-fmax(l,r));
+   }
+
+// find the extent of a peak above a given height
+inline void findextent(const float *h,int i,float height,int *left,int *right)
+   {
+   for (*left=i; *left>0 && h[*left-1]>height; (*left)--);
+   for (*right=i; *right<255 && h[*right+1]>height; (*right)++);
+   }
+
+// rank a preset by decreasing score
+inline void rankpreset(histo::preset *presets,int *count,const histo::preset &p)
+   {
+   int i;
+
+   if (*count==HISTPRESETS)
+      if (p.score<=presets[*count-1].score) return;
+      else (*count)--;
+
+   for (i=*count; i>0 && presets[i-1].score<p.score; i--) presets[i]=presets[i-1];
+
+   presets[i]=p;
+   (*count)++;
+   }
+
+// analyze the histograms
+// material peaks are the prominent maxima of the logarithmic 1D histogram
+// the dominant material at either end of the value range is considered to be background
+// material boundaries show up as arcs in the 2D histogram with a maximum of the mean gradient
+void histo::analyzeworker(void *data)
+   {
+   histo *h=(histo *)data;
+   analysis *a=h->ANALYSIS;
+
+   int i,g,n;
+   int left,right;
+   int bleft,bright;
+
+   float hist[256],loghist[256],smooth[256];
+   float mean[256],grad[256];
+
+   double total,sum,cnt;
+
+   float gmax,prom;
+
+   float rgb[3];
+
+   preset p;
+
+   a->presets=0;
+
+   a->lo=0.0f;
+   a->hi=1.0f;
+
+   for (total=0.0,i=0; i<256; i++)
+      {
+      hist[i]=a->hist[i];
+      loghist[i]=flog(1.0f+hist[i]);
+      total+=hist[i];
+      }
+
+   if (total>0.0)
+      {
+      smoothhist(loghist,smooth);
+
+      // the background is the most frequent material if it touches the value range
+      for (n=0,i=1; i<256; i++)
+         if (hist[i]>hist[n]) n=i;
+
+      while (n>0 && smooth[n-1]>smooth[n]) n--;
+      while (n<255 && smooth[n+1]>smooth[n]) n++;
+
+      findvalleys(smooth,n,&bleft,&bright);
+
+      if (bleft>0 && bright<255) bleft=bright=-1;
+
+      // material peaks
+      for (i=0; i<256; i++)
+         {
+         if (i>0 && smooth[i-1]>=smooth[i]) continue;
+         if (i<255 && smooth[i+1]>smooth[i]) continue;
+
+         if (i>=bleft && i<=bright) continue;
+
+         prom=findprominence(smooth,i,TRUE);
+         if (prom<HISTPROMINENCE) continue;
+
+         // extent of the material at half prominence
+         findextent(smooth,i,smooth[i]-prom/2.0f,&left,&right);
+
+         for (sum=0.0,n=left; n<=right; n++) sum+=hist[n];
+         if (sum==0.0) continue;
+
+         p.center=(left+right)/2.0f/255.0f;
+         p.size=fmax(right-left,2)/255.0f;
+
+         p.boundary=FALSE;
+         p.score=sum/total;
+
+         rankpreset(a->ranked,&a->presets,p);
+         }
+
+      // window of the non-background values without the outlying tails
+      for (sum=0.0,i=0; i<256; i++)
+         if (i<bleft || i>bright) sum+=hist[i];
+
+      if (sum>0.0)
+         {
+         for (cnt=0.0,left=0; left<255; left++)
+            if (left<bleft || left>bright)
+               if ((cnt+=hist[left])>HISTTAIL*sum) break;
+
+         for (cnt=0.0,right=255; right>0; right--)
+            if (right<bleft || right>bright)
+               if ((cnt+=hist[right])>HISTTAIL*sum) break;
+
+         if (right>left)
+            {
+            a->lo=left/255.0f;
+            a->hi=right/255.0f;
+            }
+         }
+      }
+
+   // material boundaries
+   if (a->hist2D!=NULL)
+      {
+      for (total=0.0,i=0; i<256; i++)
+         {
+         for (sum=cnt=0.0,g=0; g<256; g++)
+            {
+            sum+=g*a->hist2D[i+256*g];
+            cnt+=a->hist2D[i+256*g];
+            }
+
+         hist[i]=cnt;
+         mean[i]=(cnt>0.0)?sum/cnt:0.0f;
+
+         total+=cnt;
+         }
+
+      smoothhist(mean,grad);
+
+      for (gmax=0.0f,i=0; i<256; i++)
+         if (grad[i]>gmax) gmax=grad[i];
+
+      if (total>0.0 && gmax>0.0f)
+         for (i=1; i<255; i++)
+            {
+            if (grad[i-1]>=grad[i] || grad[i+1]>grad[i]) continue;
+
+            prom=findprominence(grad,i,FALSE);
+            if (prom<HISTARC*gmax) continue;
+
+            // width of the arc at half prominence
+            findextent(grad,i,grad[i]-prom/2.0f,&left,&right);
+
+            for (sum=0.0,n=left; n<=right; n++) sum+=hist[n];
+
+            p.center=i/255.0f;
+            p.size=fmax(right-left,2)/255.0f;
+
+            p.boundary=TRUE;
+            p.score=sum/total*prom/gmax;
+
+            rankpreset(a->ranked,&a->presets,p);
+            }
+      }
+
+   // the presets are colored from blue to red with increasing scalar value
+   for (i=0; i<a->presets; i++)
+      {
+      tfunc::hsv2rgb(240.0f*(1.0f-a->ranked[i].center),0.5f,1.0f,rgb);
+
+      a->ranked[i].r=rgb[0];
+      a->ranked[i].g=rgb[1];
+      a->ranked[i].b=rgb[2];
+      }
+
+   acquirelock(h->LOCK);
+   h->ANALYZED=TRUE;
+   releaselock(h->LOCK);
+   }
+
+// get interpolated scalar value from volume
+unsigned char histo::getscalar(unsigned char *volume,
+                               unsigned int width,unsigned int height,unsigned int depth,
+                               float x,float y,float z)
+   {
+   int i,j,k;
+
+   unsigned char *ptr1,*ptr2;
+
+   x*=width-1;
    y*=height-1;
    z*=depth-1;
 
@@ -2316,39 +3317,97 @@ void histo::getrgb(float x,float y,float z,float v,
    tfunc::hsv2rgb(hsv[0]+360.0f*freq*v,fsqrt(hsv[1])*(x==0.0f && y==0.0f && z==0.0f?0.0f:1.0f),val,rgb);
    }
 
+// count the voxels of one slice in a partial histogram
+void histo::countslice(int c,void *data)
+   {
+   int i,j,k;
+   int p;
+
+   unsigned char *ptr;
+   long long *cnt;
+
+   counting *b=(counting *)data;
+
+   k=b->k1+c;
+   if (k>=b->k2) return;
+
+   cnt=&b->counts[4*256*c];
+
+   ptr=&b->volume[(long long)k*b->width*b->height];
+
+   for (j=0; j<(int)b->height; j++)
+      for (i=0; i<(int)b->width; i++)
+         {
+         p=4*(*ptr++);
+
+         cnt[p]++;
+
+         cnt[p+1]+=i;
+         cnt[p+2]+=j;
+         cnt[p+3]+=k;
+         }
+   }
+
 // compute the centroids
 void histo::initcentroids(unsigned char *volume,
                           unsigned int width,unsigned int height,unsigned int depth,
                           void (*feedback)(const char *info,float percent,void *obj),void *obj)
    {
-   int i,j,k,p;
+   int i,c;
 
-   unsigned char *ptr;
+   int chunks;
+   counting b;
+
+   long long *cnt;
 
    double hmax,havg;
 
    float alpha;
 
-   for (i=0; i<256; i++) HIST[i]=0.0;
+   b.volume=volume;
+
+   b.width=width;
+   b.height=height;
 
-   for (i=0; i<3*256; i++) centroid1D[i]=0.0f;
+   // one partial histogram per worker thread
+   chunks=getthreads();
+   if (chunks>HISTCHUNKS) chunks=HISTCHUNKS;
+   if (chunks>(int)depth) chunks=depth;
+   if (chunks<1) chunks=1;
 
-   for (ptr=volume,k=0; k<(int)depth; k++)
+   b.counts=new long long[4*256*chunks];
+   for (i=0; i<4*256*chunks; i++) b.counts[i]=0;
+
+   // count the voxels slice by slice
+   for (b.k1=0; b.k1<(int)depth; b.k1+=chunks)
       {
-      if (feedback!=NULL) feedback("calculating histogram",(float)(k+1)/depth,obj);
+      b.k2=b.k1+chunks;
+      if (b.k2>(int)depth) b.k2=depth;
 
-      for (j=0; j<(int)height; j++)
-         for (i=0; i<(int)width; i++,ptr++)
-            {
-            p=*ptr;
-            HIST[p]++;
+      parallelfor(b.k2-b.k1,countslice,&b);
 
-            centroid1D[3*p]+=(float)i/(width-1)-0.5f;
-            centroid1D[3*p+1]+=(float)j/(height-1)-0.5f;
-            centroid1D[3*p+2]+=(float)k/(depth-1)-0.5f;
-            }
+      if (feedback!=NULL) feedback("calculating histogram",(float)b.k2/depth,obj);
       }
 
+   // merge the partial histograms
+   for (c=1; c<chunks; c++)
+      for (i=0; i<4*256; i++) b.counts[i]+=b.counts[4*256*c+i];
+
+   // the voxel index sums are converted into centered coordinate sums
+   for (i=0; i<256; i++)
+      {
+      cnt=&b.counts[4*i];
+
+      HIST[i]=cnt[0];
+
+      centroid1D[3*i]=(double)cnt[1]/(width-1)-0.5*cnt[0];
+      centroid1D[3*i+1]=(double)cnt[2]/(height-1)-0.5*cnt[0];
+      centroid1D[3*i+2]=(double)cnt[3]/(depth-1)-0.5*cnt[0];
+      }
+
+   delete[] b.counts;
+
+   // the remaining post-processing only touches the 256 bins
    hmax=2.0;
    havg=0.0;
 
@@ -2415,181 +3474,358 @@ void histo::inithist(unsigned char *volume,
       }
    }
 
+// accumulate one sample into a partial 2D histogram
+inline void binsample(double *bin,int s,int g,float x,float y,float z)
+   {
+   long long idx;
+
+   x-=0.5f;
+   y-=0.5f;
+   z-=0.5f;
+
+   idx=5*(s+g*256);
+
+   bin[idx]++;
+
+   bin[idx+1]+=x;
+   bin[idx+2]+=y;
+   bin[idx+3]+=z;
+
+   bin[idx+4]+=x*x+y*y+z*z;
+   }
+
+// accumulate one slice of samples into a partial 2D histogram
+void histo::binslice(int c,void *data)
+   {
+   int i,j,k;
+   int s,g;
+
+   long long n,n1,n2;
+
+   long long idx;
+   double *bin;
+
+   double t;
+   float x,y,z;
+
+   // powers of the inverse of the 2D golden ratio
+   static const double a1=0.7548776662466927;
+   static const double a2=0.5698402909980532;
+
+   binning *b=(binning *)data;
+
+   k=b->k1+c;
+   if (k>=b->k2) return;
+
+   bin=&b->bins[5*256*256*c];
+
+   // a block of rows at the points of a low-discrepancy sequence
+   if (b->samples>0)
+      {
+      n1=(long long)k*b->rows;
+      n2=n1+b->rows;
+      if (n2>b->samples) n2=b->samples;
+
+      for (n=n1; n<n2; n++)
+         {
+         t=0.5+n*a1;
+         j=ftrc((t-ffloor(t))*b->height);
+         t=0.5+n*a2;
+         k=ftrc((t-ffloor(t))*b->depth);
+
+         idx=(j+(long long)k*b->height)*b->width;
+
+         y=(float)j/(b->height-1);
+         z=(float)k/(b->depth-1);
+
+         for (i=0; i<(int)b->width; i++)
+            binsample(bin,b->volume[idx+i],b->grad[idx+i],b->xs[i],y,z);
+         }
+
+      return;
+      }
+
+   for (j=0; j<b->ny; j++)
+      for (i=0; i<b->nx; i++)
+         {
+         x=b->xs[i];
+         y=b->ys[j];
+         z=b->zs[k];
+
+         if (b->step==1.0f)
+            {
+            idx=i+(j+(long long)k*b->height)*b->width;
+
+            s=b->volume[idx];
+            g=b->grad[idx];
+            }
+         else
+            {
+            s=b->h->getscalar(b->volume,b->width,b->height,b->depth,x,y,z);
+            g=b->h->getscalar(b->grad,b->width,b->height,b->depth,x,y,z);
+            }
+
+         binsample(bin,s,g,x,y,z);
+         }
+   }
+
+// sum the 2D histogram over the k-neighbourhood of each cell
+// the box filter is separated into running sums along both axes
+void histo::boxfilter(double *bins,int kneigh)
+   {
+   int m,n,l;
+   int m1,m2;
+
+   double sum[5*257];
+
+   double *ptr;
+   int stride;
+
+   int pass;
+
+   if (kneigh==0) return;
+
+   for (pass=0; pass<2; pass++)
+      for (n=0; n<256; n++)
+         {
+         // rows in the first and columns in the second pass
+         if (pass==0)
+            {
+            ptr=&bins[5*256*n];
+            stride=5;
+            }
+         else
+            {
+            ptr=&bins[5*n];
+            stride=5*256;
+            }
+
+         for (l=0; l<5; l++) sum[l]=0.0;
+
+         for (m=0; m<256; m++)
+            for (l=0; l<5; l++)
+               sum[5*(m+1)+l]=sum[5*m+l]+ptr[m*stride+l];
+
+         for (m=0; m<256; m++)
+            {
+            m1=m-kneigh;
+            m2=m+kneigh+1;
+
+            if (m1<0) m1=0;
+            if (m2>256) m2=256;
+
+            for (l=0; l<5; l++)
+               ptr[m*stride+l]=sum[5*m2+l]-sum[5*m1+l];
+            }
+         }
+   }
+
 // compute the centroids
-void histo::initcentroids2D(unsigned char *volume,unsigned char *grad,
-                            unsigned int width,unsigned int height,unsigned int depth,
-                            int kneigh,float step,
-                            void (*feedback)(const char *info,float percent,void *obj),void *obj)
+// with a number of samples only the voxel rows at the points of a low-discrepancy sequence are visited
+// the counts of such an estimate are scaled to the number of sample positions
+// returns FALSE if the computation was aborted
+BOOLINT histo::initcentroids2D(unsigned char *volume,unsigned char *grad,
+                               unsigned int width,unsigned int height,unsigned int depth,
+                               int kneigh,float step,long long samples,
+                               void (*feedback)(const char *info,float percent,void *obj),void *obj,
+                               BOOLINT (*abort)(void *abortdata),void *abortdata)
    {
-   int m,n;
-   int s,g,p;
+   int c,n;
+
+   double positions,scale;
 
    double hmax,havg;
 
    float alpha;
 
-   if (kneigh<0 || step<=0.0f) ERRORMSG();
+   int chunks;
+   binning b;
+
+   double *bin;
+   double cnt,cx,cy,cz,var;
+
+   float x;
+
+   if (kneigh<0 || step<=0.0f || samples<0) ERRORMSG();
+
+   RATE2D=1.0f;
+   QFREQ=0.0f;
+
+   if (grad==NULL)
+      {
+      MULTI=FALSE;
+      return(TRUE);
+      }
+
+   clear();
+
+   b.h=this;
+
+   b.volume=volume;
+   b.grad=grad;
+
+   b.width=width;
+   b.height=height;
+   b.depth=depth;
+
+   b.step=step;
 
-   if (grad==NULL)
+   // count the sample positions along each axis
+   if (step==1.0f)
       {
-      MULTI=FALSE;
-      return;
+      b.nx=width;
+      b.ny=height;
+      b.nz=depth;
+      }
+   else
+      {
+      for (b.nx=0,x=0.0f; x<=1.0f; x+=step/(width-1)) b.nx++;
+      for (b.ny=0,x=0.0f; x<=1.0f; x+=step/(height-1)) b.ny++;
+      for (b.nz=0,x=0.0f; x<=1.0f; x+=step/(depth-1)) b.nz++;
       }
 
-   clear();
+   b.xs=new float[b.nx];
+   b.ys=new float[b.ny];
+   b.zs=new float[b.nz];
 
-   for (n=0; n<256*256; n++) HIST2D[n]=0.0;
+   // the sample positions are the same as with a voxel by voxel traversal
+   if (step==1.0f)
+      {
+      for (n=0; n<b.nx; n++) b.xs[n]=(float)n/(width-1);
+      for (n=0; n<b.ny; n++) b.ys[n]=(float)n/(height-1);
+      for (n=0; n<b.nz; n++) b.zs[n]=(float)n/(depth-1);
+      }
+   else
+      {
+      for (n=0,x=0.0f; n<b.nx; n++,x+=step/(width-1)) b.xs[n]=x;
+      for (n=0,x=0.0f; n<b.ny; n++,x+=step/(height-1)) b.ys[n]=x;
+      for (n=0,x=0.0f; n<b.nz; n++,x+=step/(depth-1)) b.zs[n]=x;
+      }
 
-   for (n=0; n<3*256*256; n++) centroid2D[n]=0.0f;
+   positions=(double)b.nx*b.ny*b.nz;
 
-   if (step==1.0f)
+   // estimate from a sample of the voxel rows
+   if (samples>0 && samples<positions)
       {
-      int i,j,k;
+      delete[] b.xs;
+      b.xs=new float[width];
 
-      unsigned char *ptr1,*ptr2;
+      for (n=0; n<(int)width; n++) b.xs[n]=(float)n/(width-1);
 
-      for (ptr1=volume,ptr2=grad,k=0; k<(int)depth; k++)
-         {
-         if (feedback!=NULL) feedback("calculating 2D histogram",0.5f*(k+1)/depth,obj);
+      b.samples=(samples+width-1)/width;
+      b.rows=(HISTBLOCK+width-1)/width;
+      b.nz=(b.samples+b.rows-1)/b.rows;
 
-         for (j=0; j<(int)height; j++)
-            for (i=0; i<(int)width; i++)
-               {
-               s=*ptr1++;
-               g=*ptr2++;
-
-               for (n=g-kneigh; n<=g+kneigh; n++)
-                  for (m=s-kneigh; m<=s+kneigh; m++)
-                     if (m>=0 && m<256 && n>=0 && n<256)
-                        {
-                        p=m+n*256;
-                        HIST2D[p]++;
-
-                        centroid2D[3*p]+=(float)i/(width-1)-0.5f;
-                        centroid2D[3*p+1]+=(float)j/(height-1)-0.5f;
-                        centroid2D[3*p+2]+=(float)k/(depth-1)-0.5f;
-                        }
-               }
-         }
+      scale=positions/(b.samples*width);
+      RATE2D=1.0f/scale;
       }
    else
       {
-      float i,j,k;
+      b.samples=0;
+      scale=1.0;
+      }
 
-      for (k=0.0f; k<=1.0f; k+=step/(depth-1))
-         {
-         if (feedback!=NULL) feedback("calculating 2D histogram",0.5f*k,obj);
+   // one partial histogram per worker thread
+   chunks=getthreads();
+   if (chunks>HISTCHUNKS) chunks=HISTCHUNKS;
+   if (chunks>b.nz) chunks=b.nz;
+   if (chunks<1) chunks=1;
 
-         for (j=0.0f; j<=1.0f; j+=step/(height-1))
-            for (i=0.0f; i<=1.0f; i+=step/(width-1))
-               {
-               s=getscalar(volume,width,height,depth,i,j,k);
-               g=getscalar(grad,width,height,depth,i,j,k);
-
-               for (n=g-kneigh; n<=g+kneigh; n++)
-                  for (m=s-kneigh; m<=s+kneigh; m++)
-                     if (m>=0 && m<256 && n>=0 && n<256)
-                        {
-                        p=m+n*256;
-                        HIST2D[p]++;
-
-                        centroid2D[3*p]+=i-0.5f;
-                        centroid2D[3*p+1]+=j-0.5f;
-                        centroid2D[3*p+2]+=k-0.5f;
-                        }
-               }
-         }
+   b.bins=new double[5*256*256*chunks];
+   for (n=0; n<5*256*256*chunks; n++) b.bins[n]=0.0;
+
+   // bin the samples slice by slice
+   for (b.k1=0; b.k1<b.nz; b.k1+=chunks)
+      {
+      b.k2=b.k1+chunks;
+      if (b.k2>b.nz) b.k2=b.nz;
+
+      parallelfor(b.k2-b.k1,binslice,&b);
+
+      if (feedback!=NULL) feedback("calculating 2D histogram",(float)b.k2/b.nz,obj);
+
+      if (abort!=NULL)
+         if (abort(abortdata))
+            {
+            delete[] b.xs;
+            delete[] b.ys;
+            delete[] b.zs;
+
+            delete[] b.bins;
+
+            MULTI=FALSE;
+            return(FALSE);
+            }
       }
 
+   // merge the partial histograms
+   for (c=1; c<chunks; c++)
+      for (n=0; n<5*256*256; n++) b.bins[n]+=b.bins[5*256*256*c+n];
+
+   boxfilter(b.bins,kneigh);
+
+   if (scale!=1.0)
+      for (n=0; n<5*256*256; n++) b.bins[n]*=scale;
+
    hmax=2.0;
    havg=0.0;
 
    for (n=0; n<256*256; n++)
       {
-      if (HIST2D[n]>hmax) hmax=HIST2D[n];
-      havg+=HIST2D[n];
-      }
+      bin=&b.bins[5*n];
 
-   havg/=256.0*256.0;
-   hmax=fmin(hmax,10.0*havg);
-   if (hmax==0.0) hmax++;
+      cnt=bin[0];
 
-   for (n=0; n<256*256; n++)
-      {
-      if (HIST2D[n]>1.0)
+      cx=bin[1];
+      cy=bin[2];
+      cz=bin[3];
+
+      if (cnt>1.0)
          {
-         centroid2D[3*n]/=HIST2D[n];
-         centroid2D[3*n+1]/=HIST2D[n];
-         centroid2D[3*n+2]/=HIST2D[n];
+         cx/=cnt;
+         cy/=cnt;
+         cz/=cnt;
          }
 
-      alpha=fpow(HIST2D[n]/hmax,1.0f/3);
-      if (alpha>1.0f) alpha=1.0f;
-
-      HIST2DL[n]=fsqrt(alpha);
-      }
+      // squared distances to the centroid
+      var=bin[4]-2.0*(cx*bin[1]+cy*bin[2]+cz*bin[3])+cnt*(cx*cx+cy*cy+cz*cz);
 
-   for (n=0; n<256*256; n++) variance2D[n]=0.0f;
+      if (cnt>1.0) var/=cnt;
+      if (var<0.0) var=0.0;
 
-   if (step==1.0f)
-      {
-      int i,j,k;
+      HIST2D[n]=cnt;
 
-      unsigned char *ptr1,*ptr2;
+      centroid2D[3*n]=cx;
+      centroid2D[3*n+1]=cy;
+      centroid2D[3*n+2]=cz;
 
-      for (ptr1=volume,ptr2=grad,k=0; k<(int)depth; k++)
-         {
-         if (feedback!=NULL) feedback("calculating 2D histogram",0.5f*(k+1)/depth+0.5f,obj);
+      variance2D[n]=var;
 
-         for (j=0; j<(int)height; j++)
-            for (i=0; i<(int)width; i++)
-               {
-               s=*ptr1++;
-               g=*ptr2++;
-
-               for (n=g-kneigh; n<=g+kneigh; n++)
-                  for (m=s-kneigh; m<=s+kneigh; m++)
-                     if (m>=0 && m<256 && n>=0 && n<256)
-                        {
-                        p=m+n*256;
-                        variance2D[p]+=fsqr((float)i/(width-1)-0.5f-centroid2D[3*p])+
-                                       fsqr((float)j/(height-1)-0.5f-centroid2D[3*p+1])+
-                                       fsqr((float)k/(depth-1)-0.5f-centroid2D[3*p+2]);
-                        }
-               }
-         }
+      if (cnt>hmax) hmax=cnt;
+      havg+=cnt;
       }
-   else
-      {
-      float i,j,k;
 
-      for (k=0.0f; k<=1.0f; k+=step/(depth-1))
-         {
-         if (feedback!=NULL) feedback("calculating 2D histogram",0.5f*k+0.5f,obj);
+   havg/=256.0*256.0;
+   hmax=fmin(hmax,10.0*havg);
+   if (hmax==0.0) hmax++;
 
-         for (j=0.0f; j<=1.0f; j+=step/(height-1))
-            for (i=0.0f; i<=1.0f; i+=step/(width-1))
-               {
-               s=getscalar(volume,width,height,depth,i,j,k);
-               g=getscalar(grad,width,height,depth,i,j,k);
-
-               for (n=g-kneigh; n<=g+kneigh; n++)
-                  for (m=s-kneigh; m<=s+kneigh; m++)
-                     if (m>=0 && m<256 && n>=0 && n<256)
-                        {
-                        p=m+n*256;
-                        variance2D[p]+=fsqr(i-0.5f-centroid2D[3*p])+
-                                       fsqr(j-0.5f-centroid2D[3*p+1])+
-                                       fsqr(k-0.5f-centroid2D[3*p+2]);
-                        }
-               }
-         }
+   for (n=0; n<256*256; n++)
+      {
+      alpha=fpow(HIST2D[n]/hmax,1.0f/3);
+      if (alpha>1.0f) alpha=1.0f;
+
+      HIST2DL[n]=fsqrt(alpha);
       }
 
-   for (n=0; n<256*256; n++)
-      if (HIST2D[n]>1.0) variance2D[n]/=HIST2D[n];
+   delete[] b.xs;
+   delete[] b.ys;
+   delete[] b.zs;
+
+   delete[] b.bins;
 
    MULTI=TRUE;
+
+   return(TRUE);
    }
 
 // compute the scatter plot
@@ -2607,7 +3843,7 @@ void histo::inithist2D(unsigned char *volume,unsigned char *grad,
 
    if (mincnt<1 || kneigh<0 || step<=0.0f) ERRORMSG();
 
-   if (init) initcentroids2D(volume,grad,width,height,depth,kneigh,step,feedback,obj);
+   if (init) initcentroids2D(volume,grad,width,height,depth,kneigh,step,0,feedback,obj);
 
    if (!MULTI) return;
 
@@ -2640,170 +3876,277 @@ void histo::inithist2D(unsigned char *volume,unsigned char *grad,
       HIST2DTFRGBA[4*n+2]=rgb[2];
       HIST2DTFRGBA[4*n+3]=HIST2DL[n];
       }
+
+   label();
    }
 
-// Shellsort as proposed by Robert Sedgewick in "Algorithms"
-template <class Item>
-void shellsort(Item a[],const int n)
+// sort the non-empty cells of the scatter plot by decreasing count
+// the counts are positive so that their bit patterns sort like the counts themselves
+// a stable radix sort keeps equal counts in the order of the cells
+void histo::sortcells()
    {
-   int i,j,h;
+   int n,i;
+   int pass;
 
-   Item v;
+   union {double d; unsigned long long u;} key;
 
-   for (h=1; h<=(n-1)/9; h=3*h+1);
+   unsigned short *digit;
+   int *count,*cells,*sorted,*swap;
 
-   while (h>0)
-      {
-      for (i=h; i<n; i++)
+   digit=new unsigned short[4*256*256];
+   count=new int[256*256+1];
+
+   cells=new int[256*256];
+   sorted=new int[256*256];
+
+   ORDERS=0;
+
+   for (n=0; n<256*256; n++)
+      if (HIST2D[n]>0.0)
          {
-         j=i;
-         v=a[i];
-         while (j>=h && v>a[j-h])
-            {
-            a[j]=a[j-h];
-            j-=h;
-            }
-         a[j]=v;
+         key.d=HIST2D[n];
+         key.u=~key.u;
+
+         digit[4*n]=key.u&0xffff;
+         digit[4*n+1]=(key.u>>16)&0xffff;
+         digit[4*n+2]=(key.u>>32)&0xffff;
+         digit[4*n+3]=(key.u>>48)&0xffff;
+
+         cells[ORDERS++]=n;
          }
-      h/=3;
+
+   for (pass=0; pass<4; pass++)
+      {
+      for (i=0; i<=256*256; i++) count[i]=0;
+      for (n=0; n<ORDERS; n++) count[digit[4*cells[n]+pass]+1]++;
+      for (i=0; i<256*256; i++) count[i+1]+=count[i];
+
+      for (n=0; n<ORDERS; n++) sorted[count[digit[4*cells[n]+pass]]++]=cells[n];
+
+      swap=cells;
+      cells=sorted;
+      sorted=swap;
       }
-   }
 
-typedef struct{double *ptr; int index; BOOLINT flag;} histo_item;
+   for (n=0; n<ORDERS; n++) ORDER[n]=cells[n];
 
-inline int operator > (const histo_item &A,const histo_item &B)
-   {return(*(A.ptr)>*(B.ptr) || (!A.flag && B.flag));}
+   delete[] digit;
+   delete[] count;
 
-// compute the scatter plot using vector quantization
-void histo::inithist2DQ(unsigned char *volume,unsigned char *grad,
-                        unsigned int width,unsigned int height,unsigned int depth,
-                        int mincnt,float freq,int kneigh,float step,
-                        BOOLINT init,
-                        void (*feedback)(const char *info,float percent,void *obj),void *obj)
-   {
-   int m,n,p,i;
+   delete[] cells;
+   delete[] sorted;
+   }
 
-   float rgb[3];
+// cluster the non-empty cells of the scatter plot
+// in the order of decreasing count each unclustered cell gathers the unclustered cells
+// that lie within the distance 1/freq in the space of the centroids and variances
+// the candidates are kept in a uniform grid over the centroids with a cell size of at least 1/freq
+void histo::cluster(float freq)
+   {
+   int n,m,p,q,i;
+   int gx,gy,gz;
+   int x1,x2,y1,y2,z1,z2;
+   int x,y,z,g;
 
-   float cx,cy,cz,
-         cx2,cy2,cz2,
-         var,var2,d2;
+   float cx,cy,cz,var,
+         cx2,cy2,cz2,var2,d2;
 
-   histo_item *counter;
+   float minx,miny,minz,
+         maxx,maxy,maxz;
 
-   if (mincnt<1 || kneigh<0 || step<=0.0f) ERRORMSG();
+   float size,rad;
 
-   if (freq<1.0f) freq=1.0f;
+   float rgb[3];
 
-   if (init) initcentroids2D(volume,grad,width,height,depth,kneigh,step,feedback,obj);
+   int *cell,*first,*last,*slot,*item;
 
-   if (!MULTI) return;
+   if (freq==QFREQ) return;
 
-   if (mincnt!=MINCNT || freq!=FREQ)
+   if (ORDERS==0)
       {
-      clear();
-
-      MINCNT=mincnt;
-      FREQ=freq;
+      QFREQ=freq;
+      return;
       }
 
-   counter=new histo_item[256*256];
+   minx=maxx=centroid2D[3*ORDER[0]];
+   miny=maxy=centroid2D[3*ORDER[0]+1];
+   minz=maxz=centroid2D[3*ORDER[0]+2];
 
-   for (n=0; n<256*256; n++)
+   for (n=1; n<ORDERS; n++)
       {
-      counter[n].ptr=&HIST2D[n];
-      counter[n].index=n;
-      counter[n].flag=FALSE;
+      p=ORDER[n];
+
+      if (centroid2D[3*p]<minx) minx=centroid2D[3*p];
+      else if (centroid2D[3*p]>maxx) maxx=centroid2D[3*p];
+
+      if (centroid2D[3*p+1]<miny) miny=centroid2D[3*p+1];
+      else if (centroid2D[3*p+1]>maxy) maxy=centroid2D[3*p+1];
+
+      if (centroid2D[3*p+2]<minz) minz=centroid2D[3*p+2];
+      else if (centroid2D[3*p+2]>maxz) maxz=centroid2D[3*p+2];
       }
 
-   shellsort(counter,256*256);
+   // search radius with a safety margin for the rounding of the distances
+   rad=1.001f/freq;
 
-   for (n=0; n<256*256; n++)
+   size=fmax(fmax(maxx-minx,maxy-miny),maxz-minz)/HISTGRID;
+   if (size<rad) size=rad;
+
+   gx=ftrc((maxx-minx)/size)+1;
+   gy=ftrc((maxy-miny)/size)+1;
+   gz=ftrc((maxz-minz)/size)+1;
+
+   cell=new int[ORDERS];
+   first=new int[gx*gy*gz+1];
+   last=new int[gx*gy*gz];
+   slot=new int[256*256];
+   item=new int[ORDERS];
+
+   // sort the candidates into the grid
+   for (g=0; g<=gx*gy*gz; g++) first[g]=0;
+
+   for (n=0; n<ORDERS; n++)
       {
-      p=counter[n].index;
+      p=ORDER[n];
 
-      if (HIST2D[p]<mincnt)
-         {
-         HIST2DRGBA[4*p]=0.0f;
-         HIST2DRGBA[4*p+1]=0.0f;
-         HIST2DRGBA[4*p+2]=0.0f;
-         HIST2DRGBA[4*p+3]=0.0f;
-
-         HIST2DQRGBA[4*p]=0.0f;
-         HIST2DQRGBA[4*p+1]=0.0f;
-         HIST2DQRGBA[4*p+2]=0.0f;
-         HIST2DQRGBA[4*p+3]=0.0f;
-
-         HIST2DTFRGBA[4*p]=0.0f;
-         HIST2DTFRGBA[4*p+1]=0.0f;
-         HIST2DTFRGBA[4*p+2]=0.0f;
-         HIST2DTFRGBA[4*p+3]=0.0f;
-
-         counter[n].flag=TRUE;
-         }
-      }
+      x=ftrc((centroid2D[3*p]-minx)/size);
+      y=ftrc((centroid2D[3*p+1]-miny)/size);
+      z=ftrc((centroid2D[3*p+2]-minz)/size);
 
-   shellsort(counter,256*256);
+      if (x>=gx) x=gx-1;
+      if (y>=gy) y=gy-1;
+      if (z>=gz) z=gz-1;
 
-   for (m=256*256-1; m>0 && counter[m].flag; m--);
+      cell[n]=x+(y+z*gy)*gx;
+      first[cell[n]+1]++;
+      }
 
-   for (n=0; n<=m; n++)
-      if (!counter[n].flag)
-         {
-         p=counter[n].index;
+   for (g=0; g<gx*gy*gz; g++) first[g+1]+=first[g];
+   for (g=0; g<gx*gy*gz; g++) last[g]=first[g];
 
-         cx=centroid2D[3*p];
-         cy=centroid2D[3*p+1];
-         cz=centroid2D[3*p+2];
-         var=variance2D[p];
+   for (n=0; n<ORDERS; n++)
+      {
+      p=ORDER[n];
 
-         getrgb(cx,cy,cz,var,2.0f*freq,1.0f,rgb);
+      slot[p]=last[cell[n]];
+      item[last[cell[n]]++]=p;
+      }
 
-         for (i=n; i<=m; i++)
-            if (!counter[i].flag)
+   for (n=0; n<ORDERS; n++)
+      {
+      p=ORDER[n];
+
+      // skip clustered cells
+      if (slot[p]<0) continue;
+
+      cx=centroid2D[3*p];
+      cy=centroid2D[3*p+1];
+      cz=centroid2D[3*p+2];
+      var=variance2D[p];
+
+      getrgb(cx,cy,cz,var,2.0f*freq,1.0f,rgb);
+
+      x1=ftrc((cx-rad-minx)/size);
+      x2=ftrc((cx+rad-minx)/size);
+      y1=ftrc((cy-rad-miny)/size);
+      y2=ftrc((cy+rad-miny)/size);
+      z1=ftrc((cz-rad-minz)/size);
+      z2=ftrc((cz+rad-minz)/size);
+
+      if (x1<0) x1=0;
+      if (x2>=gx) x2=gx-1;
+      if (y1<0) y1=0;
+      if (y2>=gy) y2=gy-1;
+      if (z1<0) z1=0;
+      if (z2>=gz) z2=gz-1;
+
+      for (z=z1; z<=z2; z++)
+         for (y=y1; y<=y2; y++)
+            for (x=x1; x<=x2; x++)
                {
-               p=counter[i].index;
+               g=x+(y+z*gy)*gx;
 
-               cx2=centroid2D[3*p];
-               cy2=centroid2D[3*p+1];
-               cz2=centroid2D[3*p+2];
-               var2=variance2D[p];
+               // clustered cells are swapped out of the grid cell
+               for (i=last[g]-1; i>=first[g]; i--)
+                  {
+                  q=item[i];
 
-               d2=fsqr(cx-cx2)+fsqr(cy-cy2)+fsqr(cz-cz2)+fsqr(var-var2);
+                  cx2=centroid2D[3*q];
+                  cy2=centroid2D[3*q+1];
+                  cz2=centroid2D[3*q+2];
+                  var2=variance2D[q];
 
-               if (d2*fsqr(freq)<=1.0f)
-                  {
-                  HIST2DRGBA[4*p]=rgb[0];
-                  HIST2DRGBA[4*p+1]=rgb[1];
-                  HIST2DRGBA[4*p+2]=rgb[2];
-                  HIST2DRGBA[4*p+3]=HIST2DL[p];
+                  d2=fsqr(cx-cx2)+fsqr(cy-cy2)+fsqr(cz-cz2)+fsqr(var-var2);
 
-                  if (STATE[p]==1)
-                     {
-                     HIST2DQRGBA[4*p]=rgb[0];
-                     HIST2DQRGBA[4*p+1]=rgb[1];
-                     HIST2DQRGBA[4*p+2]=rgb[2];
-                     HIST2DQRGBA[4*p+3]=HIST2DL[p];
-                     }
-                  else
+                  if (d2*fsqr(freq)<=1.0f)
                      {
-                     HIST2DQRGBA[4*p]=rgb[0]/2.0f;
-                     HIST2DQRGBA[4*p+1]=rgb[1]/2.0f;
-                     HIST2DQRGBA[4*p+2]=rgb[2]/2.0f;
-                     HIST2DQRGBA[4*p+3]=HIST2DL[p];
-                     }
+                     QUANT[3*q]=rgb[0];
+                     QUANT[3*q+1]=rgb[1];
+                     QUANT[3*q+2]=rgb[2];
 
-                  HIST2DTFRGBA[4*p]=rgb[0]*EMIT[p];
-                  HIST2DTFRGBA[4*p+1]=rgb[1]*EMIT[p];
-                  HIST2DTFRGBA[4*p+2]=rgb[2]*EMIT[p];
-                  HIST2DTFRGBA[4*p+3]=ABSORB[p];
+                     m=item[--last[g]];
+                     item[i]=m;
+                     slot[m]=i;
 
-                  counter[i].flag=TRUE;
+                     slot[q]=-1;
+                     }
                   }
                }
+      }
+
+   delete[] cell;
+   delete[] first;
+   delete[] last;
+   delete[] slot;
+   delete[] item;
+
+   QFREQ=freq;
+   }
+
+// compute the scatter plot using vector quantization
+// the clustering is kept as long as the histogram and the frequency do not change
+// so that a changing minimum count only affects the visibility of the clusters
+void histo::inithist2DQ(unsigned char *volume,unsigned char *grad,
+                        unsigned int width,unsigned int height,unsigned int depth,
+                        int mincnt,float freq,int kneigh,float step,
+                        BOOLINT init,
+                        void (*feedback)(const char *info,float percent,void *obj),void *obj)
+   {
+   int n;
+
+   if (mincnt<1 || kneigh<0 || step<=0.0f) ERRORMSG();
+
+   if (freq<1.0f) freq=1.0f;
+
+   if (init) initcentroids2D(volume,grad,width,height,depth,kneigh,step,0,feedback,obj);
+
+   if (!MULTI) return;
+
+   if (mincnt!=MINCNT || freq!=FREQ)
+      {
+      clear();
+
+      MINCNT=mincnt;
+      FREQ=freq;
+      }
+
+   if (QFREQ==0.0f) sortcells();
+
+   cluster(freq);
+
+   for (n=0; n<256*256; n++)
+      if (HIST2D[n]>=mincnt)
+         {
+         HIST2DRGBA[4*n]=QUANT[3*n];
+         HIST2DRGBA[4*n+1]=QUANT[3*n+1];
+         HIST2DRGBA[4*n+2]=QUANT[3*n+2];
+         HIST2DRGBA[4*n+3]=HIST2DL[n];
          }
+      else
+         HIST2DRGBA[4*n]=HIST2DRGBA[4*n+1]=HIST2DRGBA[4*n+2]=HIST2DRGBA[4*n+3]=0.0f;
 
-   delete counter;
+   label();
+   recolor();
    }
 
 // clear regions
@@ -2903,33 +4246,21 @@ void histo::click(float x,float y,float rad)
          }
       }
 
-   inithist2DQ(NULL,NULL,0,0,0,MINCNT,FREQ,0,1.0f,FALSE);
+   recolor();
    }
 
 // select a region
 void histo::click(int s,int t)
    {
-   float r,g,b;
-
-   int mins,maxs,mint,maxt;
+   int r;
 
    if (!MULTI) return;
 
-   r=HIST2DRGBA[4*(s+256*t)];
-   g=HIST2DRGBA[4*(s+256*t)+1];
-   b=HIST2DRGBA[4*(s+256*t)+2];
+   r=LABEL[s+256*t];
+   if (r<0) return;
 
-   if (r>0.0f && g>0.0f && b>0.0f)
-      if (STATE[s+256*t]==0)
-         {
-         detect(s,t,2,r,g,b,&mins,&maxs,&mint,&maxt);
-         mark(s,t,2,1,mins,maxs,mint,maxt);
-         }
-      else
-         {
-         detect(s,t,2,r,g,b,&mins,&maxs,&mint,&maxt);
-         clear(s,t,2,0);
-         }
+   if (STATE[s+256*t]==0) mark(r);
+   else unmark(r);
    }
 
 // render the histogram points
@@ -2995,127 +4326,214 @@ float *histo::get_hist2DTFRGBA()
    return(HIST2DTFRGBA);
    }
 
-// detect a region
-int histo::detect(const int s,const int t,const int v,
-                  const float r,const float g,const float b,
-                  int *mins,int *maxs,int *mint,int *maxt,
-                  BOOLINT flag)
+// find the root of a union-find tree with path halving
+inline int findroot(int *parent,int n)
    {
-   int count=0;
+   while (parent[n]!=n) n=parent[n]=parent[parent[n]];
+   return(n);
+   }
+
+// join two union-find trees at the smaller root
+inline void unite(int *parent,int n,int m)
+   {
+   n=findroot(parent,n);
+   m=findroot(parent,m);
 
-   if (STATE[s+t*256]==v) return(0);
+   if (n<m) parent[m]=n;
+   else if (m<n) parent[n]=m;
+   }
 
-   if (HIST2DRGBA[4*(s+t*256)]!=r) return(0);
-   if (HIST2DRGBA[4*(s+t*256)+1]!=g) return(0);
-   if (HIST2DRGBA[4*(s+t*256)+2]!=b) return(0);
+// label the 4-connected regions of equally colored cells in the scatter plot
+void histo::label()
+   {
+   int s,t,n,r;
 
-   STATE[s+t*256]=v;
+   int *parent;
 
-   if (flag)
-      {
-      *mins=*maxs=s;
-      *mint=*maxt=t;
-      }
-   else
+   float *rgba;
+
+   region *reg;
+
+   parent=CELLS;
+
+   for (n=0; n<256*256; n++)
       {
-      if (s<*mins) *mins=s;
-      else if (s>*maxs) *maxs=s;
+      rgba=&HIST2DRGBA[4*n];
 
-      if (t<*mint) *mint=t;
-      else if (t>*maxt) *maxt=t;
+      if (rgba[0]>0.0f && rgba[1]>0.0f && rgba[2]>0.0f) parent[n]=n;
+      else parent[n]=-1;
       }
 
-   if (s>0) count+=detect(s-1,t,v,r,g,b,mins,maxs,mint,maxt,FALSE);
-   if (s<255) count+=detect(s+1,t,v,r,g,b,mins,maxs,mint,maxt,FALSE);
-   if (t>0) count+=detect(s,t-1,v,r,g,b,mins,maxs,mint,maxt,FALSE);
-   if (t<255) count+=detect(s,t+1,v,r,g,b,mins,maxs,mint,maxt,FALSE);
+   // join with the left and the lower neighbour
+   for (t=0; t<256; t++)
+      for (s=0; s<256; s++)
+         {
+         n=s+256*t;
+
+         if (parent[n]<0) continue;
+
+         rgba=&HIST2DRGBA[4*n];
 
-   return(count+1);
+         if (s>0)
+            if (parent[n-1]>=0)
+               if (rgba[-4]==rgba[0] && rgba[-3]==rgba[1] && rgba[-2]==rgba[2]) unite(parent,n,n-1);
+
+         if (t>0)
+            if (parent[n-256]>=0)
+               if (rgba[-4*256]==rgba[0] && rgba[-4*256+1]==rgba[1] && rgba[-4*256+2]==rgba[2]) unite(parent,n,n-256);
+         }
+
+   // the root of each region is its first cell
+   REGIONS=0;
+
+   for (n=0; n<256*256; n++)
+      if (parent[n]<0) LABEL[n]=-1;
+      else
+         {
+         s=n%256;
+         t=n/256;
+
+         r=findroot(parent,n);
+
+         if (r==n)
+            {
+            r=LABEL[n]=REGIONS++;
+
+            reg=&REGION[r];
+
+            reg->mins=reg->maxs=s;
+            reg->mint=reg->maxt=t;
+
+            reg->count=0;
+            }
+         else
+            {
+            r=LABEL[n]=LABEL[r];
+
+            reg=&REGION[r];
+
+            if (s<reg->mins) reg->mins=s;
+            if (s>reg->maxs) reg->maxs=s;
+
+            if (t<reg->mint) reg->mint=t;
+            if (t>reg->maxt) reg->maxt=t;
+            }
+
+         reg->count++;
+         }
+
+   // sort the cells by region
+   for (n=r=0; r<REGIONS; r++)
+      {
+      REGION[r].first=n;
+      n+=REGION[r].count;
+      REGION[r].count=0;
+      }
+
+   for (n=0; n<256*256; n++)
+      if ((r=LABEL[n])>=0) CELLS[REGION[r].first+REGION[r].count++]=n;
    }
 
-// mark a region
-void histo::mark(const int s,const int t,const int v1,const int v2)
+// color the quantized scatter plot and transfer function by the state of the regions
+void histo::recolor()
    {
-   if (STATE[s+t*256]!=v1) return;
+   int n;
+
+   float *rgba;
+
+   if (!MULTI) return;
+
+   for (n=0; n<256*256; n++)
+      {
+      rgba=&HIST2DRGBA[4*n];
 
-   STATE[s+t*256]=v2;
+      if (HIST2D[n]>=MINCNT)
+         {
+         if (STATE[n]==1)
+            {
+            HIST2DQRGBA[4*n]=rgba[0];
+            HIST2DQRGBA[4*n+1]=rgba[1];
+            HIST2DQRGBA[4*n+2]=rgba[2];
+            }
+         else
+            {
+            HIST2DQRGBA[4*n]=rgba[0]/2.0f;
+            HIST2DQRGBA[4*n+1]=rgba[1]/2.0f;
+            HIST2DQRGBA[4*n+2]=rgba[2]/2.0f;
+            }
 
-   EMIT[s+t*256]=1.0f;
-   ABSORB[s+t*256]=1.0f;
+         HIST2DQRGBA[4*n+3]=rgba[3];
 
-   if (s>0) mark(s-1,t,v1,v2);
-   if (s<255) mark(s+1,t,v1,v2);
-   if (t>0) mark(s,t-1,v1,v2);
-   if (t<255) mark(s,t+1,v1,v2);
+         HIST2DTFRGBA[4*n]=rgba[0]*EMIT[n];
+         HIST2DTFRGBA[4*n+1]=rgba[1]*EMIT[n];
+         HIST2DTFRGBA[4*n+2]=rgba[2]*EMIT[n];
+         HIST2DTFRGBA[4*n+3]=ABSORB[n];
+         }
+      else
+         {
+         HIST2DQRGBA[4*n]=HIST2DQRGBA[4*n+1]=HIST2DQRGBA[4*n+2]=HIST2DQRGBA[4*n+3]=0.0f;
+         HIST2DTFRGBA[4*n]=HIST2DTFRGBA[4*n+1]=HIST2DTFRGBA[4*n+2]=HIST2DTFRGBA[4*n+3]=0.0f;
+         }
+      }
    }
 
 // mark a region with gradient
-void histo::mark(const int s,const int t,const int v1,const int v2,
-                 const int mins,const int maxs,const int mint,const int maxt)
+void histo::mark(int r)
    {
+   int i,n;
+   int s,t;
+
    float x,y;
 
-   if (STATE[s+t*256]!=v1) return;
+   region *reg=&REGION[r];
+
+   for (i=reg->first; i<reg->first+reg->count; i++)
+      {
+      n=CELLS[i];
 
-   STATE[s+t*256]=v2;
+      s=n%256;
+      t=n/256;
 
-   if (mins>=maxs) x=1.0f;
-   else x=(float)(s-mins)/(maxs-mins);
+      if (reg->mins>=reg->maxs) x=1.0f;
+      else x=(float)(s-reg->mins)/(reg->maxs-reg->mins);
 
-   if (mint>=maxt) y=1.0f;
-   else y=(float)(t-mint)/(maxt-mint);
+      if (reg->mint>=reg->maxt) y=1.0f;
+      else y=(float)(t-reg->mint)/(reg->maxt-reg->mint);
 
-   EMIT[s+t*256]=x;
-   ABSORB[s+t*256]=(1.0f-x)*y;
+      STATE[n]=1;
 
-   if (s>0) mark(s-1,t,v1,v2,mins,maxs,mint,maxt);
-   if (s<255) mark(s+1,t,v1,v2,mins,maxs,mint,maxt);
-   if (t>0) mark(s,t-1,v1,v2,mins,maxs,mint,maxt);
-   if (t<255) mark(s,t+1,v1,v2,mins,maxs,mint,maxt);
+      EMIT[n]=x;
+      ABSORB[n]=(1.0f-x)*y;
+      }
    }
 
 // mark all regions with gradient
 void histo::markall()
    {
-   int s,t;
-
-   float r,g,b;
-
-   int mins,maxs,mint,maxt;
+   int r;
 
    if (!MULTI) return;
 
    if (clear(TRUE))
-      for (s=0; s<256; s++)
-         for (t=0; t<256; t++)
-            if (STATE[s+t*256]==0)
-               {
-               r=HIST2DRGBA[4*(s+256*t)];
-               g=HIST2DRGBA[4*(s+256*t)+1];
-               b=HIST2DRGBA[4*(s+256*t)+2];
-
-               if (r>0.0f && g>0.0f && b>0.0f)
-                  {
-                  detect(s,t,2,r,g,b,&mins,&maxs,&mint,&maxt);
-                  mark(s,t,2,1,mins,maxs,mint,maxt);
-                  }
-               }
+      for (r=0; r<REGIONS; r++) mark(r);
    }
 
-// clear a region
-void histo::clear(const int s,const int t,const int v1,const int v2)
+// unmark a region
+void histo::unmark(int r)
    {
-   if (STATE[s+t*256]!=v1) return;
+   int i,n;
+
+   region *reg=&REGION[r];
 
-   STATE[s+t*256]=v2;
+   for (i=reg->first; i<reg->first+reg->count; i++)
+      {
+      n=CELLS[i];
 
-   EMIT[s+t*256]=0.0f;
-   ABSORB[s+t*256]=0.0f;
+      STATE[n]=0;
 
-   if (s>0) clear(s-1,t,v1,v2);
-   if (s<255) clear(s+1,t,v1,v2);
-   if (t>0) clear(s,t-1,v1,v2);
-   if (t<255) clear(s,t+1,v1,v2);
+      EMIT[n]=0.0f;
+      ABSORB[n]=0.0f;
+      }
    }
 
 // save2file
@@ -7,6 +7,19 @@
 #include "ddsbase.h" // volume file reader
 #include "oglbase.h" // OpenGL base and window handling
 
+#define TFPACKET 64 // table entries per evaluation packet
+#define TFROWS 4 // table rows per worker task
+
+#define HISTCHUNKS 16 // maximum number of partial histograms
+#define HISTSAMPLES (1<<24) // number of voxel samples of a progressive 2D histogram estimate
+#define HISTBLOCK (1<<16) // minimum number of voxel samples per worker task
+#define HISTGRID 32 // maximum grid resolution of the scatter plot clustering
+
+#define HISTPRESETS 8 // maximum number of transfer function presets
+#define HISTPROMINENCE 0.5f // minimum prominence of a material peak in the logarithmic histogram
+#define HISTARC 0.1f // minimum height of a boundary arc relative to the maximum mean gradient
+#define HISTTAIL 0.005f // fraction of the values outside of the automatic window at either end
+
 // a transfer function:
 
 class tfunc
@@ -24,7 +37,8 @@ class tfunc
                      const float density, // global density
                      const float slab, // slab thickness
                      BOOLINT premult=FALSE, // pre-multiplied optical model on/off
-                     BOOLINT RGBA=TRUE); // use RGBA or RGB mode
+                     BOOLINT RGBA=TRUE, // use RGBA or RGB mode
+                     BOOLINT flt=FALSE); // slab-independent float tables on/off
 
    // pre-integrate the actual transfer function
    BOOLINT refresh2D(const float emission, // global emission
@@ -32,7 +46,8 @@ class tfunc
                      const float slab, // slab thickness
                      BOOLINT premult=FALSE, // pre-multiplied optical model on/off
                      BOOLINT preint=TRUE, // pre-integration on/off
-                     BOOLINT RGBA=TRUE); // use RGBA or RGB mode
+                     BOOLINT RGBA=TRUE, // use RGBA or RGB mode
+                     BOOLINT flt=FALSE); // slab-independent float tables on/off
 
    // check visibility via ZOT (Zero Opacity Test)
    BOOLINT zot(float mindata,float maxdata);
@@ -40,6 +55,9 @@ class tfunc
    // preintegrate transfer function (needed by ZOT)
    void preint(BOOLINT premult=FALSE);
 
+   // get the maximum emission and absorption of each entry (as used by ZOT)
+   void get_vis(float *vis);
+
    // check transparency via MOT (Minimum Opacity Test)
    BOOLINT mot(float mindata,float maxdata);
 
@@ -115,6 +133,10 @@ class tfunc
    unsigned char *get_pre_e() {return(EDATA);} // get pre-integrated emission table
    unsigned char *get_pre_a() {return(ADATA);} // get pre-integrated absorption table
 
+   // the float tables hold the emission and the optical depth per unit slab thickness
+   float *get_pre_fe() {return(FEDATA);} // get slab-independent emission table
+   float *get_pre_fa() {return(FADATA);} // get slab-independent absorption table
+
    // check whether or not the absorption is equal for all channels
    BOOLINT checkRGBA();
 
@@ -124,6 +146,15 @@ class tfunc
    // get dimension of tables (FALSE=1D/TRUE=2D)
    BOOLINT get_dim() {return(LAST_DIM);}
 
+   // get the range of entries that were updated by the last refresh
+   void get_dirty(int *minpos,int *maxpos) {*minpos=UPDMIN; *maxpos=UPDMAX;}
+
+   // check whether or not entries have been edited since the last refresh
+   BOOLINT is_edited() {return(DIRTYMIN<=DIRTYMAX);}
+
+   // distribute the table rows over the worker threads on/off
+   void set_threaded(BOOLINT on=TRUE) {THREADED=on;}
+
    // save2file
    void save(FILE *file);
 
@@ -145,28 +176,62 @@ class tfunc
    BOOLINT INVMODE; // inverse mode flag
 
    unsigned char *EDATA,*ADATA; // pre-integration tables
+   float *FEDATA,*FADATA; // slab-independent float pre-integration tables
 
    float LAST_EMS,LAST_DNS,LAST_SLB;
-   BOOLINT LAST_MLT,LAST_INT,LAST_RGBA,LAST_DIM;
+   BOOLINT LAST_MLT,LAST_INT,LAST_RGBA,LAST_DIM,LAST_FLT;
 
    BOOLINT CHANGED;
 
+   int DIRTYMIN,DIRTYMAX; // range of edited entries
+   int UPDMIN,UPDMAX; // range of entries updated by the last refresh
+
+   void touch(int i) {CHANGED=TRUE; if (i<DIRTYMIN) DIRTYMIN=i; if (i>DIRTYMAX) DIRTYMAX=i;}
+   void touchall() {CHANGED=TRUE; DIRTYMIN=0; DIRTYMAX=RES-1;}
+
+   BOOLINT THREADED; // table rows are calculated in parallel
+
    private:
 
    float *PRE,*PGE,*PBE;
    float *PRA,*PGA,*PBA;
 
-   float *PMIN;
+   float *POPA; // maximum opacity of the rgb channels
+   float *PMIN; // sparse table of the minimum opacity
+   int *PLOG; // binary logarithm of the range length
+   int PLEVELS;
+   BOOLINT PVALID;
 
-   int PPSIZE;
-   float *TABLE1,*TABLE2,*TABLE3;
-   float LAST1,LAST2,LAST3;
+   static inline void fexp2(float *x,int n);
+   static inline unsigned char quant(float x);
 
-   float prepow1(float x,float p);
-   float prepow2(float x,float p);
-   float prepow3(float x,float p);
+   struct table
+      {
+      tfunc *tf;
 
-   inline unsigned char quant(float x);
+      float scale_re,scale_ge,scale_be;
+      float log_ra,log_ga,log_ba;
+      float scale_ra,scale_ga,scale_ba;
+
+      BOOLINT premult,preint,RGBA,flt;
+
+      int rows;
+      };
+
+   void rebuild(const float emission,const float density,const float slab,
+                BOOLINT premult,BOOLINT preint,BOOLINT RGBA,BOOLINT flt,
+                int rows);
+
+   static void calcrows(int b,void *data);
+   static void calcrow(int r,table *t);
+
+   void sample(int c,int n,BOOLINT premult,
+               float *re,float *ge,float *be,
+               float *ra,float *ga,float *ba);
+
+   void average(int r,int c,int n,
+                float *re,float *ge,float *be,
+                float *ra,float *ga,float *ba);
 
    void invert1D(BOOLINT RGBA);
    void invert2D(BOOLINT RGBA);
@@ -247,6 +312,10 @@ class tfunc2D
    // precompute minimum opacity (needed by MOT)
    void premin();
 
+   // get modification stamp of the ZOT
+   // the stamp changes whenever the visibility of the data range may change
+   unsigned int get_stamp() {return(STAMP);}
+
    // get resolution of transfer functions
    int get_res() {return(RES);}
 
@@ -312,6 +381,35 @@ class tfunc2D
 
    int get_eid() {return(EID);} // get texture id of pre-integrated emission
    int get_aid() {return(AID);} // get texture id of pre-integrated absorption
+   int get_cid(int c) {return(CID[c]);} // get texture id of the emission/absorption of one channel
+
+   unsigned char *get_pre_e() {return(TF[0]->get_pre_e());} // get pre-integrated emission table
+   unsigned char *get_pre_a() {return(TF[0]->get_pre_a());} // get pre-integrated absorption table
+
+   float *get_pre_fe() {return(TF[0]->get_pre_fe());} // get slab-independent emission table
+   float *get_pre_fa() {return(TF[0]->get_pre_fa());} // get slab-independent absorption table
+
+   // enable slab-independent float tables (if supported)
+   // the emission is then scaled and the opacity is corrected per fragment
+   void set_float(BOOLINT on=TRUE) {FLOATREQ=on;}
+
+   // get whether or not the textures hold slab-independent float tables
+   BOOLINT get_float() {return(TEXFLOAT);}
+
+   // get the emission and optical depth scale of the float tables
+   float get_ecorr() {return(ECORR);}
+   float get_acorr() {return(ACORR);}
+
+   // set the window of data values that is covered by the transfer functions
+   // values outside of the window are classified like the window boundaries
+   void set_window(float lo=0.0f,float hi=1.0f);
+
+   // get the window of data values that is covered by the transfer functions
+   void get_window(float *lo,float *hi) {*lo=WINLO; *hi=WINHI;}
+
+   // get scale and bias of the windowing transform
+   float get_wscale() {return(1.0f/(WINHI-WINLO));}
+   float get_wbias() {return(-WINLO/(WINHI-WINLO));}
 
    // check whether or not the absorption is equal for all channels
    BOOLINT checkRGBA();
@@ -346,31 +444,92 @@ class tfunc2D
    int MODE; // transfer function setup mode
 
    int EID,AID; // texture ids of pre-integrated tables
+   int CID[3]; // texture ids of the per-channel emission/absorption tables
+
+   int TEXDIM; // texture layout (1=1D 2=2D 3=layered 1D 4=layered 2D)
+   BOOLINT TEXRGBA; // texture format
+   BOOLINT TEXFLOAT; // float texture format
+
+   BOOLINT FLOATREQ; // float tables requested
+   int FLOATSUP; // float textures supported (-1=unknown)
+
+   float ECORR,ACORR; // emission and optical depth scale of the float tables
+
+   float WINLO,WINHI; // window of data values covered by the transfer functions
+
+   unsigned int STAMP; // modification stamp of the ZOT
 
    private:
 
+   float *ZTAB; // sparse table of the summed visibility of transfer function ranges
+   int ZNUM,ZLEVELS;
+
    // update the transfer functions
    void update();
 
-   // return id of 1D RGB texture map
-   int buildtexmap1DRGB(unsigned char *table,int size);
+   // build the range table of the ZOT
+   void buildzot();
+
+   // map a data value into the window
+   inline float window(float v);
+
+   // check visibility of a range of transfer functions via the range table
+   inline BOOLINT zotrange(int minpos,int maxpos,int minc,int maxc);
+
+   struct layers
+      {
+      tfunc2D *tf;
+
+      float emission,density,slab;
+      BOOLINT premult,preint,RGBA,flt;
+
+      int dim;
+      BOOLINT *changed;
+      };
+
+   // refresh the table of one transfer function
+   static void refreshlayer(int i,void *data);
+
+   // get the table of one transfer function as bytes or floats
+   void *gettable(int i,BOOLINT absorption,BOOLINT flt);
+
+   // interleave the emission and the absorption of one channel into an RGBA table
+   unsigned char *getchannel(int i,int c,int dim,BOOLINT flt);
+
+   // build the emission or absorption texture of all transfer functions
+   // or the combined emission/absorption texture of one channel
+   int buildtex(int dim,BOOLINT absorption,int components,BOOLINT flt,int channel=-1);
 
-   // return id of 1D RGBA texture map
-   int buildtexmap1DRGBA(unsigned char *table,int size);
+   // get the texture format of a table
+   static void texformat(int components,BOOLINT flt,
+                         GLint *internal,GLenum *format,GLenum *type);
 
-   // return id of 2D RGB texture map
-   int buildtexmap2DRGB(unsigned char *image,int width,int height);
+   // return id of 1D RGB or RGBA texture map
+   int buildtexmap1D(void *table,int size,
+                     int components,BOOLINT flt=FALSE);
 
-   // return id of 2D RGBA texture map
-   int buildtexmap2DRGBA(unsigned char *image,int width,int height);
+   // return id of 2D RGB or RGBA texture map
+   int buildtexmap2D(void *image,int width,int height,
+                     int components,BOOLINT flt=FALSE);
 
-   // return id of 3D RGB texture map
-   int buildtexmap3DRGB(unsigned char *volume,
-                        int width,int height,int depth);
+   // return id of 3D RGB or RGBA texture map
+   int buildtexmap3D(void *volume,int width,int height,int depth,
+                     int components,BOOLINT flt=FALSE);
 
-   // return id of 3D RGBA texture map
-   int buildtexmap3DRGBA(unsigned char *volume,
-                         int width,int height,int depth);
+   // update a sub-rectangle of a 2D texture map
+   // the rectangle is read from an image with the given width and written with a vertical offset
+   void updatetexmap2D(int texid,void *image,int width,int components,BOOLINT flt,
+                       int x,int y,int w,int h,int offset=0);
+
+   // update a sub-rectangle of one slice of a 3D texture map
+   void updatetexmap3D(int texid,void *image,int width,int components,BOOLINT flt,
+                       int x,int y,int z,int w,int h);
+
+   // update the dirty part of the textures of one transfer function
+   void updatetex(int i,int dim,BOOLINT preint,BOOLINT RGBA,BOOLINT flt);
+
+   // update one dirty rectangle of the texture of one transfer function
+   void updatetexrect(int texid,void *data,int components,BOOLINT flt,int dim,int i,int rect[4]);
 
    // delete texture map
    void deletetexmap(int texid);
@@ -396,6 +555,44 @@ class histo
                        int kneigh=1,float histstep=1.0f,
                        void (*feedback)(const char *info,float percent,void *obj)=NULL,void *obj=NULL);
 
+   // adopt the exact 2D histogram once the background refinement has finished
+   // returns TRUE if the histograms have changed
+   BOOLINT update();
+
+   // stop the background refinement
+   void stop();
+
+   // check whether or not the 2D histogram is being refined
+   BOOLINT is_refining() {return(NEXT!=NULL);}
+
+   // return the sampling rate of the 2D histogram relative to the histogram step (1=exact)
+   float get_hist2Drate() {return(RATE2D);}
+
+   // return the relative standard error of the least frequent visible 2D histogram bin
+   float get_hist2Derror();
+
+   // a ranked transfer function preset
+   struct preset
+      {
+      float center,size; // linear ramp of the scalar values as with volren::set_tfunc
+      float r,g,b; // color of the material
+      BOOLINT boundary; // material boundary instead of a material
+      float score; // fraction of the voxels weighted by the height of a boundary arc
+      };
+
+   // check whether or not the histogram analysis has finished
+   BOOLINT is_analyzed();
+
+   // return the number of ranked transfer function presets
+   // returns 0 while the analysis is still running and if no presets were found
+   int get_presets();
+
+   // return a ranked transfer function preset (0=best)
+   preset *get_preset(int rank);
+
+   // return the automatic window of the scalar values
+   void get_autowindow(float *lo,float *hi);
+
    // init 1D histogram
    void inithist(unsigned char *volume,
                  unsigned int width,unsigned int height,unsigned int depth,
@@ -463,6 +660,8 @@ class histo
    int MINCNT;
    float FREQ;
 
+   float RATE2D;
+
    private:
 
    BOOLINT CLICKED;
@@ -484,24 +683,118 @@ class histo
                       unsigned int width,unsigned int height,unsigned int depth,
                       void (*feedback)(const char *info,float percent,void *obj)=NULL,void *obj=NULL);
 
-   void initcentroids2D(unsigned char *volume,unsigned char *grad,
-                        unsigned int width,unsigned int height,unsigned int depth,
-                        int kneigh,float step,
-                        void (*feedback)(const char *info,float percent,void *obj)=NULL,void *obj=NULL);
+   struct counting
+      {
+      unsigned char *volume;
+      unsigned int width,height;
+
+      int k1,k2; // slice range of the actual batch
+      long long *counts; // partial histograms with count and voxel index sums
+      };
+
+   static void countslice(int c,void *data);
+
+   BOOLINT initcentroids2D(unsigned char *volume,unsigned char *grad,
+                           unsigned int width,unsigned int height,unsigned int depth,
+                           int kneigh,float step,long long samples=0,
+                           void (*feedback)(const char *info,float percent,void *obj)=NULL,void *obj=NULL,
+                           BOOLINT (*abort)(void *abortdata)=NULL,void *abortdata=NULL);
+
+   struct binning
+      {
+      histo *h;
+
+      unsigned char *volume,*grad;
+      unsigned int width,height,depth;
+      float step;
+
+      float *xs,*ys,*zs; // sample positions
+      int nx,ny,nz;
+
+      long long samples; // number of low-discrepancy rows (0=all sample positions)
+      int rows; // low-discrepancy rows per slice
+
+      int k1,k2; // slice range of the actual batch
+      double *bins; // partial histograms with count, position sum and squared distance sum
+      };
+
+   static void binslice(int c,void *data);
+   static void boxfilter(double *bins,int kneigh);
+
+   struct refinement
+      {
+      unsigned char *volume,*grad;
+      unsigned int width,height,depth;
+
+      int kneigh;
+      float step;
+      };
+
+   refinement REFINE; // parameters of the exact 2D histogram
+   histo *NEXT; // exact 2D histogram being computed in the background
+
+   void *WORKER; // background thread
+   void *LOCK; // lock of the refinement state
+   BOOLINT CANCEL,DONE;
+
+   void refine(unsigned char *volume,unsigned char *grad,
+               unsigned int width,unsigned int height,unsigned int depth,
+               int kneigh,float step);
+
+   static void refineworker(void *data);
+   static BOOLINT cancelled(void *data);
+
+   struct analysis
+      {
+      double hist[256],*hist2D; // copies of the histograms
+
+      preset ranked[HISTPRESETS]; // ranked presets
+      int presets;
+
+      float lo,hi; // automatic window
+      };
+
+   analysis *ANALYSIS; // histogram analysis running in the background
+   void *ANALYZER; // background thread
+   BOOLINT ANALYZED;
+
+   preset PRESET[HISTPRESETS];
+   int PRESETS;
+
+   float AUTOLO,AUTOHI;
+
+   void analyze();
+   void finish();
+
+   static void analyzeworker(void *data);
+
+   struct region
+      {
+      int mins,maxs,mint,maxt; // bounding box
+      int first,count; // range of the region cells
+      };
+
+   int *LABEL; // region of each cell of the scatter plot (-1=none)
+   int *CELLS; // cells ordered by region
+   region *REGION;
+   int REGIONS;
+
+   int *ORDER; // non-empty cells by decreasing count
+   int ORDERS;
 
-   int detect(const int s,const int t,const int v,
-              const float r,const float g,const float b,
-              int *mins,int *maxs,int *mint,int *maxt,
-              BOOLINT flag=TRUE);
+   float *QUANT; // color of the cluster of each cell
+   float QFREQ; // frequency of the clustering (0=none)
 
-   void mark(const int s,const int t,const int v1,const int v2);
+   void sortcells();
+   void cluster(float freq);
 
-   void mark(const int s,const int t,const int v1,const int v2,
-             const int mins,const int maxs,const int mint,const int maxt);
+   void label();
+   void recolor();
 
+   void mark(int r);
    void markall();
 
-   void clear(const int s,const int t,const int v1,const int v2);
+   void unmark(int r);
    };
 
 #endif
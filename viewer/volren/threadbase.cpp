@@ -0,0 +1,419 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#include "codebase.h"
+
+#include "threadbase.h"
+
+#ifdef UNIX
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#define MAXTHREADS 64
+
+int threadcount=0;
+
+struct parallelinfo
+   {
+   int n,next;
+
+   void (*func)(int i,void *data);
+   void *data;
+
+   int active,maxactive;
+
+   parallelinfo *link;
+   };
+
+struct parallelpool
+   {
+   void *lock;
+   void *work,*done;
+
+   int workers;
+
+   parallelinfo *jobs;
+   };
+
+struct backgroundinfo
+   {
+   void (*func)(void *data);
+   void *data;
+
+#ifdef UNIX
+   pthread_t thread;
+#endif
+#ifdef WINOS
+   HANDLE thread;
+#endif
+   };
+
+// return the number of available processor cores
+int getcores()
+   {
+   int cores=1;
+
+#ifdef UNIX
+#ifdef _SC_NPROCESSORS_ONLN
+   cores=sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#endif
+
+#ifdef WINOS
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   cores=info.dwNumberOfProcessors;
+#endif
+
+   if (cores<1) cores=1;
+   if (cores>MAXTHREADS) cores=MAXTHREADS;
+
+   return(cores);
+   }
+
+// specify the number of worker threads (0=number of cores)
+void setthreads(int threads)
+   {
+   if (threads<0) threads=0;
+   if (threads>MAXTHREADS) threads=MAXTHREADS;
+
+   threadcount=threads;
+   }
+
+// return the number of worker threads
+int getthreads()
+   {
+   if (threadcount==0) threadcount=getcores();
+   return(threadcount);
+   }
+
+// create the worker pool shared by all parallel loops
+parallelpool *createpool()
+   {
+   parallelpool *pool=new parallelpool;
+
+   pool->lock=createlock();
+
+   pool->work=createcondition();
+   pool->done=createcondition();
+
+   pool->workers=0;
+
+   pool->jobs=NULL;
+
+   return(pool);
+   }
+
+// return the worker pool
+parallelpool *getpool()
+   {
+   static parallelpool *pool=createpool();
+   return(pool);
+   }
+
+// fetch the next index from the shared counter
+inline int parallelnext(parallelpool *pool,parallelinfo *info)
+   {
+   int i;
+
+   acquirelock(pool->lock);
+   i=info->next++;
+   releaselock(pool->lock);
+
+   return(i);
+   }
+
+// process indices until the counter is exhausted
+void parallelwork(parallelpool *pool,parallelinfo *info)
+   {
+   int i;
+
+   while ((i=parallelnext(pool,info))<info->n) info->func(i,info->data);
+   }
+
+// find a queued loop that still has indices and room for another worker
+parallelinfo *parallelfind(parallelpool *pool)
+   {
+   parallelinfo *job;
+
+   for (job=pool->jobs; job!=NULL; job=job->link)
+      if (job->next<job->n && job->active<job->maxactive) return(job);
+
+   return(NULL);
+   }
+
+// worker thread that waits for queued loops and helps to process them
+void parallelworker(void *data)
+   {
+   parallelpool *pool=(parallelpool *)data;
+   parallelinfo *job;
+
+   acquirelock(pool->lock);
+
+   for (;;)
+      {
+      while ((job=parallelfind(pool))==NULL) waitcondition(pool->work,pool->lock);
+
+      job->active++;
+      releaselock(pool->lock);
+
+      parallelwork(pool,job);
+
+      acquirelock(pool->lock);
+      if (--job->active==0) signalcondition(pool->done);
+      }
+   }
+
+// call func(i,data) for i=0..n-1 distributed over the worker threads
+void parallelfor(int n,void (*func)(int i,void *data),void *data)
+   {
+   int i;
+
+   int threads;
+
+   parallelpool *pool;
+   parallelinfo info,**job;
+
+   threads=getthreads();
+   if (threads>n) threads=n;
+
+   // run serially if there is nothing to distribute
+   if (threads<=1)
+      {
+      for (i=0; i<n; i++) func(i,data);
+      return;
+      }
+
+   pool=getpool();
+
+   info.n=n;
+   info.next=0;
+
+   info.func=func;
+   info.data=data;
+
+   info.active=0;
+   info.maxactive=threads-1;
+
+   acquirelock(pool->lock);
+
+   // start persistent workers once and reuse them for all later loops
+   while (pool->workers<threads-1)
+      {
+      if (createthread(parallelworker,pool)==NULL) break;
+      pool->workers++;
+      }
+
+   // queue the loop and wake the idle workers
+   info.link=pool->jobs;
+   pool->jobs=&info;
+
+   signalcondition(pool->work);
+   releaselock(pool->lock);
+
+   // the calling thread acts as the first worker
+   parallelwork(pool,&info);
+
+   acquirelock(pool->lock);
+
+   for (job=&pool->jobs; *job!=&info; job=&(*job)->link);
+   *job=info.link;
+
+   // wait for the workers that are still processing an index
+   while (info.active>0) waitcondition(pool->done,pool->lock);
+
+   releaselock(pool->lock);
+   }
+
+#ifdef UNIX
+void *backgroundthread(void *info)
+   {
+   ((backgroundinfo *)info)->func(((backgroundinfo *)info)->data);
+   return(NULL);
+   }
+#endif
+
+#ifdef WINOS
+DWORD WINAPI backgroundthread(LPVOID info)
+   {
+   ((backgroundinfo *)info)->func(((backgroundinfo *)info)->data);
+   return(0);
+   }
+#endif
+
+// call func(data) on a background thread (returns NULL if no thread can be started)
+void *createthread(void (*func)(void *data),void *data)
+   {
+   backgroundinfo *info;
+
+   info=new backgroundinfo;
+
+   info->func=func;
+   info->data=data;
+
+#ifdef UNIX
+   if (pthread_create(&info->thread,NULL,backgroundthread,info)==0) return(info);
+#endif
+
+#ifdef WINOS
+   if ((info->thread=CreateThread(NULL,0,backgroundthread,info,0,NULL))!=NULL) return(info);
+#endif
+
+   delete info;
+
+   return(NULL);
+   }
+
+// call func(data) on a background thread (runs immediately if no thread can be started)
+void *startthread(void (*func)(void *data),void *data)
+   {
+   void *thread;
+
+   if ((thread=createthread(func,data))!=NULL) return(thread);
+
+   func(data);
+
+   return(NULL);
+   }
+
+// wait for a background thread to finish
+void jointhread(void *thread)
+   {
+   backgroundinfo *info=(backgroundinfo *)thread;
+
+   if (info==NULL) return;
+
+#ifdef UNIX
+   pthread_join(info->thread,NULL);
+#endif
+
+#ifdef WINOS
+   WaitForSingleObject(info->thread,INFINITE);
+   CloseHandle(info->thread);
+#endif
+
+   delete info;
+   }
+
+// create a lock
+void *createlock()
+   {
+#ifdef UNIX
+   pthread_mutex_t *mutex=new pthread_mutex_t;
+   pthread_mutex_init(mutex,NULL);
+   return(mutex);
+#endif
+
+#ifdef WINOS
+   CRITICAL_SECTION *mutex=new CRITICAL_SECTION;
+   InitializeCriticalSection(mutex);
+   return(mutex);
+#endif
+
+   return(NULL);
+   }
+
+// destroy a lock
+void destroylock(void *lock)
+   {
+   if (lock==NULL) return;
+
+#ifdef UNIX
+   pthread_mutex_destroy((pthread_mutex_t *)lock);
+   delete (pthread_mutex_t *)lock;
+#endif
+
+#ifdef WINOS
+   DeleteCriticalSection((CRITICAL_SECTION *)lock);
+   delete (CRITICAL_SECTION *)lock;
+#endif
+   }
+
+// acquire a lock
+void acquirelock(void *lock)
+   {
+   if (lock==NULL) return;
+
+#ifdef UNIX
+   pthread_mutex_lock((pthread_mutex_t *)lock);
+#endif
+
+#ifdef WINOS
+   EnterCriticalSection((CRITICAL_SECTION *)lock);
+#endif
+   }
+
+// release a lock
+void releaselock(void *lock)
+   {
+   if (lock==NULL) return;
+
+#ifdef UNIX
+   pthread_mutex_unlock((pthread_mutex_t *)lock);
+#endif
+
+#ifdef WINOS
+   LeaveCriticalSection((CRITICAL_SECTION *)lock);
+#endif
+   }
+
+// create a condition variable
+void *createcondition()
+   {
+#ifdef UNIX
+   pthread_cond_t *cond=new pthread_cond_t;
+   pthread_cond_init(cond,NULL);
+   return(cond);
+#endif
+
+#ifdef WINOS
+   CONDITION_VARIABLE *cond=new CONDITION_VARIABLE;
+   InitializeConditionVariable(cond);
+   return(cond);
+#endif
+
+   return(NULL);
+   }
+
+// destroy a condition variable
+void destroycondition(void *cond)
+   {
+   if (cond==NULL) return;
+
+#ifdef UNIX
+   pthread_cond_destroy((pthread_cond_t *)cond);
+   delete (pthread_cond_t *)cond;
+#endif
+
+#ifdef WINOS
+   delete (CONDITION_VARIABLE *)cond;
+#endif
+   }
+
+// wait for a condition variable while holding its lock
+void waitcondition(void *cond,void *lock)
+   {
+   if (cond==NULL || lock==NULL) return;
+
+#ifdef UNIX
+   pthread_cond_wait((pthread_cond_t *)cond,(pthread_mutex_t *)lock);
+#endif
+
+#ifdef WINOS
+   SleepConditionVariableCS((CONDITION_VARIABLE *)cond,(CRITICAL_SECTION *)lock,INFINITE);
+#endif
+   }
+
+// wake all threads waiting for a condition variable
+void signalcondition(void *cond)
+   {
+   if (cond==NULL) return;
+
+#ifdef UNIX
+   pthread_cond_broadcast((pthread_cond_t *)cond);
+#endif
+
+#ifdef WINOS
+   WakeAllConditionVariable((CONDITION_VARIABLE *)cond);
+#endif
+   }
@@ -0,0 +1,51 @@
+// (c) by Stefan Roettger, licensed under GPL 2+
+
+#ifndef THREADBASE_H
+#define THREADBASE_H
+
+// return the number of available processor cores
+int getcores();
+
+// specify the number of worker threads (0=number of cores)
+void setthreads(int threads=0);
+
+// return the number of worker threads
+int getthreads();
+
+// call func(i,data) for i=0..n-1 distributed over the worker threads
+void parallelfor(int n,void (*func)(int i,void *data),void *data);
+
+// call func(data) on a background thread (returns NULL if no thread can be started)
+void *createthread(void (*func)(void *data),void *data);
+
+// call func(data) on a background thread (runs immediately if no thread can be started)
+void *startthread(void (*func)(void *data),void *data);
+
+// wait for a background thread to finish
+void jointhread(void *thread);
+
+// create a lock
+void *createlock();
+
+// destroy a lock
+void destroylock(void *lock);
+
+// acquire a lock
+void acquirelock(void *lock);
+
+// release a lock
+void releaselock(void *lock);
+
+// create a condition variable
+void *createcondition();
+
+// destroy a condition variable
+void destroycondition(void *cond);
+
+// wait for a condition variable while holding its lock
+void waitcondition(void *cond,void *lock);
+
+// wake all threads waiting for a condition variable
+void signalcondition(void *cond);
+
+#endif
@@ -3,32 +3,173 @@
 #include "tilebase.h"
 
 #include "progs.h"
+#include "ray_progs.h"
+
+#include "shaderbase.h"
+
+// a texture atlas:
+
+atlas::atlas(int bricksize,int count)
+   {
+   GLint maxsize;
+
+   int maxslots;
+
+   if (bricksize<2 || count<1) ERRORMSG();
+
+   glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE,&maxsize);
+
+   // limit the number of slots per axis and in total
+   maxslots=maxsize/bricksize;
+   if (maxslots<1) maxslots=1;
+
+   if ((long long)count*bricksize*bricksize*bricksize>ATLASSIZE)
+      count=ATLASSIZE/bricksize/bricksize/bricksize;
+
+   if (count<1) count=1;
+
+   NX=min((int)fceil(pow((double)count,1.0/3)),maxslots);
+   NY=min((int)fceil(sqrt((double)count/NX)),maxslots);
+   NZ=min((count+NX*NY-1)/(NX*NY),maxslots);
+
+   BSIZE=bricksize;
+   COUNT=0;
+
+   glGenTextures(1,&TEXID);
+   glBindTexture(GL_TEXTURE_3D,TEXID);
+
+#ifndef WINOS
+   glTexImage3D(GL_TEXTURE_3D,0,GL_LUMINANCE,get_width(),get_height(),get_depth(),0,
+                GL_LUMINANCE,GL_UNSIGNED_BYTE,NULL);
+#else
+   glTexImage3DEXT(GL_TEXTURE_3D,0,GL_LUMINANCE,get_width(),get_height(),get_depth(),0,
+                   GL_LUMINANCE,GL_UNSIGNED_BYTE,NULL);
+#endif
+
+   glBindTexture(GL_TEXTURE_3D,0);
+   }
+
+atlas::~atlas()
+   {if (TEXID>0) glDeleteTextures(1,&TEXID);}
+
+// insert a brick and return its position in voxels
+BOOLINT atlas::insert(unsigned char *volume,
+                      int *px,int *py,int *pz)
+   {
+   if (is_full()) return(FALSE);
+
+   *px=(COUNT%NX)*BSIZE;
+   *py=((COUNT/NX)%NY)*BSIZE;
+   *pz=(COUNT/(NX*NY))*BSIZE;
+
+   COUNT++;
+
+   glBindTexture(GL_TEXTURE_3D,TEXID);
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+#ifndef WINOS
+   glTexSubImage3D(GL_TEXTURE_3D,0,*px,*py,*pz,BSIZE,BSIZE,BSIZE,
+                   GL_LUMINANCE,GL_UNSIGNED_BYTE,volume);
+#else
+   glTexSubImage3DEXT(GL_TEXTURE_3D,0,*px,*py,*pz,BSIZE,BSIZE,BSIZE,
+                      GL_LUMINANCE,GL_UNSIGNED_BYTE,volume);
+#endif
+
+   glBindTexture(GL_TEXTURE_3D,0);
+
+   return(TRUE);
+   }
 
 // a texture brick:
 
+brick *brick::HEAD=NULL;
+brick *brick::TAIL=NULL;
+
+long long brick::BUDGET=0;
+long long brick::USAGE=0;
+
+unsigned int brick::FRAME=0;
+
 brick::brick()
-   {TEXID=0;}
+   {
+   TEXID=0;
+
+   WIDTH=HEIGHT=DEPTH=0;
+   DATA=NULL;
+
+   ATLAS=NULL;
+   OX=OY=OZ=0;
+
+   PREV=NEXT=NULL;
+   STAMP=0;
+   }
 
 brick::~brick()
-   {deletetexmap3D();}
+   {
+   deletetexmap3D();
+   if (DATA!=NULL) free(DATA);
+   }
 
 // generate 3D texture map
 void brick::buildtexmap3D(unsigned char *volume,
-                          int width,int height,int depth)
+                          int width,int height,int depth,
+                          atlas *pack)
    {
    if (width<2 || height<2 || depth<2) ERRORMSG();
 
    deletetexmap3D();
 
+   if (DATA!=NULL)
+      {
+      free(DATA);
+      DATA=NULL;
+      }
+
+   WIDTH=width;
+   HEIGHT=height;
+   DEPTH=depth;
+
+   // managed bricks keep a host copy and are uploaded on demand
+   if (BUDGET>0)
+      {
+      if ((DATA=(unsigned char *)malloc(get_size()))==NULL) ERRORMSG();
+      memcpy(DATA,volume,get_size());
+      }
+   else if (pack!=NULL)
+      {
+      if (pack->insert(volume,&OX,&OY,&OZ)) ATLAS=pack;
+      else uploadtexmap3D(volume);
+      }
+   else uploadtexmap3D(volume);
+   }
+
+// multiply texture matrix with the atlas transform
+void brick::multexmatrix()
+   {
+   if (ATLAS!=NULL)
+      {
+      glTranslatef((float)OX/ATLAS->get_width(),
+                   (float)OY/ATLAS->get_height(),
+                   (float)OZ/ATLAS->get_depth());
+
+      glScalef((float)WIDTH/ATLAS->get_width(),
+               (float)HEIGHT/ATLAS->get_height(),
+               (float)DEPTH/ATLAS->get_depth());
+      }
+   }
+
+// upload 3D texture map
+void brick::uploadtexmap3D(unsigned char *volume)
+   {
    glGenTextures(1,&TEXID);
    glBindTexture(GL_TEXTURE_3D,TEXID);
 
    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
 #ifndef WINOS
-   glTexImage3D(GL_TEXTURE_3D,0,GL_LUMINANCE,width,height,depth,0,
+   glTexImage3D(GL_TEXTURE_3D,0,GL_LUMINANCE,WIDTH,HEIGHT,DEPTH,0,
                 GL_LUMINANCE,GL_UNSIGNED_BYTE,volume);
 #else
-   glTexImage3DEXT(GL_TEXTURE_3D,0,GL_LUMINANCE,width,height,depth,0,
+   glTexImage3DEXT(GL_TEXTURE_3D,0,GL_LUMINANCE,WIDTH,HEIGHT,DEPTH,0,
                    GL_LUMINANCE,GL_UNSIGNED_BYTE,volume);
 #endif
 
@@ -37,7 +178,87 @@ void brick::buildtexmap3D(unsigned char *volume,
 
 // delete 3D texture map
 void brick::deletetexmap3D()
-   {if (TEXID>0) glDeleteTextures(1,&TEXID);}
+   {
+   ATLAS=NULL;
+
+   if (TEXID>0)
+      {
+      glDeleteTextures(1,&TEXID);
+      TEXID=0;
+
+      if (DATA!=NULL)
+         {
+         unlink();
+         USAGE-=get_size();
+         }
+      }
+   }
+
+// make the texture map resident
+BOOLINT brick::make_resident()
+   {
+   // unmanaged bricks are always resident
+   if (DATA==NULL) return(get_id()!=0);
+
+   if (TEXID!=0)
+      {
+      // move to the front of the lru list
+      unlink();
+      link();
+      }
+   else
+      {
+      // evict least recently used bricks not needed in this frame
+      if (BUDGET>0)
+         while (USAGE+get_size()>BUDGET && TAIL!=NULL)
+            if (TAIL->STAMP!=FRAME) TAIL->deletetexmap3D();
+            else break;
+
+      if (BUDGET>0 && USAGE+get_size()>BUDGET) return(FALSE);
+
+      uploadtexmap3D(DATA);
+
+      USAGE+=get_size();
+      link();
+      }
+
+   STAMP=FRAME;
+
+   return(TRUE);
+   }
+
+// set graphics memory budget for managed bricks
+void brick::set_budget(long long budget)
+   {
+   BUDGET=budget;
+
+   if (BUDGET>0)
+      while (USAGE>BUDGET && TAIL!=NULL) TAIL->deletetexmap3D();
+   }
+
+// insert at the front of the lru list
+void brick::link()
+   {
+   PREV=NULL;
+   NEXT=HEAD;
+
+   if (HEAD!=NULL) HEAD->PREV=this;
+   else TAIL=this;
+
+   HEAD=this;
+   }
+
+// remove from the lru list
+void brick::unlink()
+   {
+   if (PREV!=NULL) PREV->NEXT=NEXT;
+   else HEAD=NEXT;
+
+   if (NEXT!=NULL) NEXT->PREV=PREV;
+   else TAIL=PREV;
+
+   PREV=NEXT=NULL;
+   }
 
 // a tile of the volume:
 
@@ -47,6 +268,17 @@ GLuint tile::PROGID[PROGNUM];
 
 int tile::SFXMODE=0;
 
+int tile::PROJMODE=PROJ_NONE;
+
+BOOLINT tile::RAYMODE=FALSE;
+float tile::RAYTHRES=0.95f;
+BOOLINT tile::RAYLOADED=FALSE;
+int tile::RAYPROG[RAYPROGNUM];
+
+GLuint tile::RAYOCCTEX=0;
+int tile::RAYOCCX=0,tile::RAYOCCY=0;
+int tile::RAYOCCWIDTH=0,tile::RAYOCCHEIGHT=0;
+
 tile::tile(tfunc2D *tf,char *base)
    {
    BRICK=new brick();
@@ -54,6 +286,21 @@ tile::tile(tfunc2D *tf,char *base)
 
    TFUNC=tf;
 
+   VERTS=NULL;
+   VERTMAX=VERTCNT=0;
+   VSIZE=3;
+
+   SLICED=FALSE;
+   VFIRST=-1;
+
+   RAYS=FALSE;
+
+   EMPTY=FALSE;
+   EMPTYSTAMP=0;
+   EMPTYMODE=PROJ_NONE;
+
+   OCCLUDED=FALSE;
+
    NOISE=0.01f;
    AMBNT=0.3f;
    DIFUS=0.5f;
@@ -68,6 +315,8 @@ tile::~tile()
    delete BRICK;
    if (EXTRA!=NULL) delete EXTRA;
 
+   if (VERTS!=NULL) free(VERTS);
+
    destroy();
    }
 
@@ -75,6 +324,94 @@ tile::~tile()
 void tile::setSFXmode(int sfxmode)
    {SFXMODE=sfxmode;}
 
+// set ray casting mode with early ray termination threshold
+void tile::setRAYmode(BOOLINT raymode,float thres)
+   {
+   RAYMODE=raymode;
+   RAYTHRES=thres;
+   }
+
+// set the opacity composited in front of the following tiles
+void tile::setRAYoccluder(GLuint tex,int x,int y,int width,int height)
+   {
+   RAYOCCTEX=tex;
+
+   RAYOCCX=x;
+   RAYOCCY=y;
+
+   RAYOCCWIDTH=width;
+   RAYOCCHEIGHT=height;
+   }
+
+// set intensity projection mode
+void tile::setPROJmode(int projmode)
+   {PROJMODE=projmode;}
+
+// compile ray casting shaders on demand
+void tile::setupray()
+   {
+   int i;
+
+   char *version;
+
+   char *vtxprog,*frgprog;
+   int len;
+
+   if (!RAYMODE || RAYLOADED) return;
+
+   for (i=0; i<RAYPROGNUM; i++) RAYPROG[i]=0;
+
+   RAYLOADED=TRUE;
+
+   if ((version=(char *)glGetString(GL_VERSION))==NULL) ERRORMSG();
+
+   if (atoi(version)<2)
+      {
+      WARNMSG("ray casting unsupported");
+      return;
+      }
+
+   len=strlen(ray_frgprg)+MAXSTR;
+
+   if ((vtxprog=(char *)malloc(strlen(ray_vtxprg)+MAXSTR))==NULL) ERRORMSG();
+   if ((frgprog=(char *)malloc(len))==NULL) ERRORMSG();
+
+   snprintf(vtxprog,strlen(ray_vtxprg)+MAXSTR,"#version 120\n%s",ray_vtxprg);
+
+   for (i=0; i<RAYPROGNUM; i++)
+      {
+      snprintf(frgprog,len,"#version 120\n#define RAYMODE %d\n%s",i,ray_frgprg);
+
+      // fall back to slicing if any variant is unavailable
+      if ((RAYPROG[i]=buildglslprog(vtxprog,frgprog))==0)
+         {
+         destroyray();
+         RAYLOADED=TRUE;
+         break;
+         }
+      }
+
+   free(vtxprog);
+   free(frgprog);
+   }
+
+// destroy ray casting shaders
+void tile::destroyray()
+   {
+   int i;
+
+   if (RAYLOADED)
+      {
+      for (i=0; i<RAYPROGNUM; i++)
+         {
+         deleteglslprog(RAYPROG[i]);
+         RAYPROG[i]=0;
+         }
+
+      RAYLOADED=FALSE;
+      }
+   }
+
 // load fragment programs
 void tile::setup(char *base)
    {
@@ -180,6 +517,8 @@ void tile::destroy()
             glDeleteProgramsARB(1,&PROGID[i]);
 
          LOADED=FALSE;
+
+         destroyray();
          }
 
 #endif
@@ -191,7 +530,8 @@ void tile::set_data(unsigned char *data,
                     float mx,float my,float mz,
                     float sx,float sy,float sz,
                     int px,int py,int pz,
-                    int bricksize,int border)
+                    int bricksize,int border,
+                    atlas *pack)
    {
    int i,j,k;
 
@@ -207,7 +547,7 @@ void tile::set_data(unsigned char *data,
                 k<0 || k>=(int)depth) *ptr++=0;
             else *ptr++=data[((unsigned int)i)+(((unsigned int)j)+((unsigned int)k)*height)*width];
 
-   BRICK->buildtexmap3D(volume,bricksize,bricksize,bricksize);
+   BRICK->buildtexmap3D(volume,bricksize,bricksize,bricksize,pack);
 
    BSIZE=bricksize;
 
@@ -234,6 +574,8 @@ void tile::set_data(unsigned char *data,
 
    free(volume);
 
+   EMPTYSTAMP=0;
+
    if (EXTRA!=NULL)
       {
       delete EXTRA;
@@ -245,7 +587,8 @@ void tile::set_data(unsigned char *data,
 void tile::set_extra(unsigned char *extra,
                      unsigned int width,unsigned int height,unsigned int depth,
                      int px,int py,int pz,
-                     int bricksize)
+                     int bricksize,
+                     atlas *pack)
    {
    int i,j,k;
 
@@ -265,7 +608,7 @@ void tile::set_extra(unsigned char *extra,
 
    if (EXTRA==NULL) EXTRA=new brick();
 
-   EXTRA->buildtexmap3D(volume,bricksize,bricksize,bricksize);
+   EXTRA->buildtexmap3D(volume,bricksize,bricksize,bricksize,pack);
 
    MINEXTRA=255;
    MAXEXTRA=0;
@@ -279,6 +622,8 @@ void tile::set_extra(unsigned char *extra,
             }
 
    free(volume);
+
+   EMPTYSTAMP=0;
    }
 
 // set the tile size
@@ -304,6 +649,58 @@ void tile::set_light(float noise,float ambnt,float difus,float specl,float specx
    SPECX=specx;
    }
 
+// check whether or not the tile is invisible with respect to the tf
+BOOLINT tile::is_empty()
+   {
+   // the visibility is cached until the tf or the data changes
+   if (EMPTYSTAMP==TFUNC->get_stamp() && EMPTYMODE==PROJMODE) return(EMPTY);
+
+   // intensity projections only need samples that do not clamp to the neutral element
+   // which is the upper end of the tf window for minimum intensity projections
+   if (PROJMODE==PROJ_MINIP)
+      EMPTY=MINDATA/255.0f>fmax(TFUNC->get_nonzero_max(),TFUNC->get_nonzero_min()+1.0f/255.0f);
+   else if (PROJMODE!=PROJ_NONE)
+      EMPTY=MAXDATA/255.0f<TFUNC->get_nonzero_min();
+   else if (EXTRA==NULL || TFUNC->get_num()==1)
+      EMPTY=TFUNC->zot(MINDATA/255.0f,MAXDATA/255.0f);
+   else
+      EMPTY=TFUNC->zot(MINDATA/255.0f,MAXDATA/255.0f,MINEXTRA/255.0f,MAXEXTRA/255.0f);
+
+   EMPTYSTAMP=TFUNC->get_stamp();
+   EMPTYMODE=PROJMODE;
+
+   return(EMPTY);
+   }
+
+// check whether or not the tile bricks are resident
+BOOLINT tile::is_resident()
+   {
+   if (!BRICK->is_resident()) return(FALSE);
+   if (EXTRA!=NULL) return(EXTRA->is_resident());
+
+   return(TRUE);
+   }
+
+// make the tile bricks resident
+BOOLINT tile::make_resident()
+   {
+   if (!BRICK->make_resident()) return(FALSE);
+   if (EXTRA!=NULL) return(EXTRA->make_resident());
+
+   return(TRUE);
+   }
+
+// return graphics memory of the tile bricks in bytes
+long long tile::get_memory()
+   {
+   long long memory;
+
+   memory=BRICK->get_size();
+   if (EXTRA!=NULL) memory+=EXTRA->get_size();
+
+   return(memory);
+   }
+
 // get ambient/diffuse/specular lighting coefficients
 void tile::get_light(float *noise,float *ambnt,float *difus,float *specl,float *specx)
    {
@@ -314,6 +711,24 @@ void tile::get_light(float *noise,float *ambnt,float *difus,float *specl,float *
    *specx=SPECX;
    }
 
+// load texture matrix of brick
+inline void tile::loadtexmatrix(brick *b)
+   {
+   glPushMatrix();
+   glLoadIdentity();
+
+   b->multexmatrix();
+
+   glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
+   glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
+            (float)(BSIZE-1-2*BORDER)/BSIZE,
+            (float)(BSIZE-1-2*BORDER)/BSIZE);
+
+   glTranslatef(0.5f,0.5f,0.5f);
+   glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
+   glTranslatef(-MX,-MY,-MZ);
+   }
+
 // intersect a line with a plane
 inline void tile::intersect(const float px,const float py,const float pz,
                             const float dx,const float dy,const float dz,
@@ -332,10 +747,11 @@ inline void tile::intersect(const float px,const float py,const float pz,
    }
 
 // project the texcoords onto the back and the front of the slab
-inline void tile::projtexcoords(const float x,const float y,const float z,const float slab2)
+inline void tile::projtexcoords(const float x,const float y,const float z,const float slab2,float *v)
    {
-   float pp1x,pp1y,pp1z,
-         pp2x,pp2y,pp2z;
+   v[0]=x;
+   v[1]=y;
+   v[2]=z;
 
    if (TFUNC->get_dim())
       {
@@ -343,27 +759,32 @@ inline void tile::projtexcoords(const float x,const float y,const float z,const
                 x-EX,y-EY,z-EZ,
                 x+slab2*DX,y+slab2*DY,z+slab2*DZ,
                 DX,DY,DZ,
-                &pp1x,&pp1y,&pp1z);
+                &v[3],&v[4],&v[5]);
 
       intersect(EX,EY,EZ,
                 x-EX,y-EY,z-EZ,
                 x-slab2*DX,y-slab2*DY,z-slab2*DZ,
                 DX,DY,DZ,
-                &pp2x,&pp2y,&pp2z);
-
-#ifdef GL_ARB_multitexture
-      glMultiTexCoord3fARB(GL_TEXTURE0_ARB,pp1x,pp1y,pp1z);
-      glMultiTexCoord3fARB(GL_TEXTURE1_ARB,pp2x,pp2y,pp2z);
-      if (TFUNC->get_num()!=1) glMultiTexCoord3fARB(GL_TEXTURE2_ARB,x,y,z);
-#endif
+                &v[6],&v[7],&v[8]);
       }
-   else
+   }
+
+// append a polygon with count vertices to the vertex array
+inline float *tile::addpolygon(int count)
+   {
+   float *v;
+
+   if ((VERTCNT+count)*VSIZE>VERTMAX)
       {
-#ifdef GL_ARB_multitexture
-      glMultiTexCoord3fARB(GL_TEXTURE0_ARB,x,y,z);
-      if (TFUNC->get_num()!=1) glMultiTexCoord3fARB(GL_TEXTURE1_ARB,x,y,z);
-#endif
+      VERTMAX=2*VERTMAX+count*VSIZE;
+      if ((VERTS=(float *)realloc(VERTS,VERTMAX*sizeof(float)))==NULL) ERRORMSG();
       }
+
+   v=&VERTS[VERTCNT*VSIZE];
+
+   VERTCNT+=count;
+
+   return(v);
    }
 
 // extract triangle from tetrahedron
@@ -373,12 +794,12 @@ inline void tile::slicetetra1(const float p1x,const float p1y,const float p1z,co
                               const float p4x,const float p4y,const float p4z,const float d4,
                               const float slab)
    {
-#ifdef GL_ARB_multitexture
-
    float pp1x,pp1y,pp1z,
          pp2x,pp2y,pp2z,
          pp3x,pp3y,pp3z;
 
+   float *v;
+
    pp1x=(d2*p1x+d1*p2x)/(d1+d2);
    pp1y=(d2*p1y+d1*p2y)/(d1+d2);
    pp1z=(d2*p1z+d1*p2z)/(d1+d2);
@@ -389,110 +810,11 @@ inline void tile::slicetetra1(const float p1x,const float p1y,const float p1z,co
    pp3y=(d4*p1y+d1*p4y)/(d1+d4);
    pp3z=(d4*p1z+d1*p4z)/(d1+d4);
 
-   if (TFUNC->get_num()==1)
-      if (TFUNC->get_aid()!=0)
-         {
-         glBindTexture(GL_TEXTURE_2D,TFUNC->get_aid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,1.0f,0.0f,0.0f,1.0f);
-#endif
-
-         glBlendFunc(GL_ZERO,GL_ONE_MINUS_SRC_COLOR);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-
-         glBindTexture(GL_TEXTURE_2D,TFUNC->get_eid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,AMBNT,DIFUS,SPECL,SPECX);
-#endif
-
-         glBlendFunc(GL_ONE,GL_ONE);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-      else
-         {
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-   else
-      if (TFUNC->get_aid()!=0)
-         {
-         if (TFUNC->get_dim()) glBindTexture(GL_TEXTURE_3D,TFUNC->get_aid());
-         else glBindTexture(GL_TEXTURE_2D,TFUNC->get_aid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,1.0f,0.0f,0.0f,1.0f);
-#endif
-
-         glBlendFunc(GL_ZERO,GL_ONE_MINUS_SRC_COLOR);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-
-         if (TFUNC->get_dim()) glBindTexture(GL_TEXTURE_3D,TFUNC->get_eid());
-         else glBindTexture(GL_TEXTURE_2D,TFUNC->get_eid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,AMBNT,DIFUS,SPECL,SPECX);
-#endif
-
-         glBlendFunc(GL_ONE,GL_ONE);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-      else
-         {
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
+   v=addpolygon(3);
 
-#endif
+   projtexcoords(pp1x,pp1y,pp1z,slab/2.0f,v);
+   projtexcoords(pp2x,pp2y,pp2z,slab/2.0f,v+VSIZE);
+   projtexcoords(pp3x,pp3y,pp3z,slab/2.0f,v+2*VSIZE);
    }
 
 // extract quad from tetrahedron
@@ -502,142 +824,35 @@ inline void tile::slicetetra2(const float p1x,const float p1y,const float p1z,co
                               const float p4x,const float p4y,const float p4z,const float d4,
                               const float slab)
    {
-#ifdef GL_ARB_multitexture
-
    float pp1x,pp1y,pp1z,
          pp2x,pp2y,pp2z,
          pp3x,pp3y,pp3z,
          pp4x,pp4y,pp4z;
 
+   float *v;
+
    pp1x=(d3*p1x+d1*p3x)/(d1+d3);
    pp1y=(d3*p1y+d1*p3y)/(d1+d3);
    pp1z=(d3*p1z+d1*p3z)/(d1+d3);
-   pp2x=(d3*p2x+d2*p3x)/(d2+d3);
-   pp2y=(d3*p2y+d2*p3y)/(d2+d3);
-   pp2z=(d3*p2z+d2*p3z)/(d2+d3);
-   pp3x=(d4*p1x+d1*p4x)/(d1+d4);
-   pp3y=(d4*p1y+d1*p4y)/(d1+d4);
-   pp3z=(d4*p1z+d1*p4z)/(d1+d4);
-   pp4x=(d4*p2x+d2*p4x)/(d2+d4);
-   pp4y=(d4*p2y+d2*p4y)/(d2+d4);
-   pp4z=(d4*p2z+d2*p4z)/(d2+d4);
-
-   if (TFUNC->get_num()==1)
-      if (TFUNC->get_aid()!=0)
-         {
-         glBindTexture(GL_TEXTURE_2D,TFUNC->get_aid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,1.0f,0.0f,0.0f,1.0f);
-#endif
-
-         glBlendFunc(GL_ZERO,GL_ONE_MINUS_SRC_COLOR);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-
-         glBindTexture(GL_TEXTURE_2D,TFUNC->get_eid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,AMBNT,DIFUS,SPECL,SPECX);
-#endif
-
-         glBlendFunc(GL_ONE,GL_ONE);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-      else
-         {
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-   else
-      if (TFUNC->get_aid()!=0)
-         {
-         if (TFUNC->get_dim()) glBindTexture(GL_TEXTURE_3D,TFUNC->get_aid());
-         else glBindTexture(GL_TEXTURE_2D,TFUNC->get_aid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,1.0f,0.0f,0.0f,1.0f);
-#endif
-
-         glBlendFunc(GL_ZERO,GL_ONE_MINUS_SRC_COLOR);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-
-         if (TFUNC->get_dim()) glBindTexture(GL_TEXTURE_3D,TFUNC->get_eid());
-         else glBindTexture(GL_TEXTURE_2D,TFUNC->get_eid());
-
-#ifdef GL_ARB_fragment_program
-         if (LIGHTING)
-            glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,AMBNT,DIFUS,SPECL,SPECX);
-#endif
+   pp2x=(d3*p2x+d2*p3x)/(d2+d3);
+   pp2y=(d3*p2y+d2*p3y)/(d2+d3);
+   pp2z=(d3*p2z+d2*p3z)/(d2+d3);
+   pp3x=(d4*p1x+d1*p4x)/(d1+d4);
+   pp3y=(d4*p1y+d1*p4y)/(d1+d4);
+   pp3z=(d4*p1z+d1*p4z)/(d1+d4);
+   pp4x=(d4*p2x+d2*p4x)/(d2+d4);
+   pp4y=(d4*p2y+d2*p4y)/(d2+d4);
+   pp4z=(d4*p2z+d2*p4z)/(d2+d4);
 
-         glBlendFunc(GL_ONE,GL_ONE);
-
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
-      else
-         {
-         glBegin(GL_TRIANGLE_FAN);
-         projtexcoords(pp1x,pp1y,pp1z,slab/2.0f);
-         glVertex3f(pp1x,pp1y,pp1z);
-         projtexcoords(pp2x,pp2y,pp2z,slab/2.0f);
-         glVertex3f(pp2x,pp2y,pp2z);
-         projtexcoords(pp4x,pp4y,pp4z,slab/2.0f);
-         glVertex3f(pp4x,pp4y,pp4z);
-         projtexcoords(pp3x,pp3y,pp3z,slab/2.0f);
-         glVertex3f(pp3x,pp3y,pp3z);
-         glEnd();
-         }
+   // split the quad 1-2-4-3 into the triangles 1-2-4 and 1-4-3
+   v=addpolygon(6);
 
-#endif
+   projtexcoords(pp1x,pp1y,pp1z,slab/2.0f,v);
+   projtexcoords(pp2x,pp2y,pp2z,slab/2.0f,v+VSIZE);
+   projtexcoords(pp4x,pp4y,pp4z,slab/2.0f,v+2*VSIZE);
+   memcpy(v+3*VSIZE,v,VSIZE*sizeof(float));
+   memcpy(v+4*VSIZE,v+2*VSIZE,VSIZE*sizeof(float));
+   projtexcoords(pp3x,pp3y,pp3z,slab/2.0f,v+5*VSIZE);
    }
 
 // slice tetrahedron from back to front at distances given by the slab thickness
@@ -758,6 +973,196 @@ void tile::drawhexa(const float p1x,const float p1y,const float p1z,
    if (f4) slicetetra(p8x,p8y,p8z,p3x,p3y,p3z,p1x,p1y,p1z,p4x,p4y,p4z,slab);
    }
 
+// slice the tile into its vertex array
+void tile::slice(float ex,float ey,float ez,
+                 float dx,float dy,float dz,
+                 float ux,float uy,float uz,
+                 float nearp,float slab,
+                 BOOLINT front2back)
+   {
+   EX=ex; EY=ey; EZ=ez;
+   DX=dx; DY=dy; DZ=dz;
+   UX=ux; UY=uy; UZ=uz;
+
+   NEARP=nearp;
+
+   VERTCNT=0;
+   VSIZE=(TFUNC->get_dim())?9:3;
+
+   SLICED=TRUE;
+   VFIRST=-1;
+
+   RAYS=FALSE;
+
+   // try the ZOT
+   if (is_empty()) return;
+
+   // cast rays instead of slicing
+   if (PROJMODE==PROJ_NONE && castrays())
+      {
+      RAYS=TRUE;
+      return;
+      }
+
+   drawhexa(MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
+            MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
+            MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
+            MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
+            MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
+            MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
+            MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
+            MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
+            slab);
+
+   // the slices are generated back-to-front
+   if (front2back) reverse();
+   }
+
+// reverse the order of the sliced polygons
+void tile::reverse()
+   {
+   int i,j,k;
+
+   float *t1,*t2,tmp;
+   int tsize,tcnt;
+
+   tsize=3*VSIZE;
+   tcnt=VERTCNT/3;
+
+   // a sliced quad consists of two disjoint triangles
+   for (i=0,j=tcnt-1; i<j; i++,j--)
+      for (t1=&VERTS[i*tsize],t2=&VERTS[j*tsize],k=0; k<tsize; k++)
+         {
+         tmp=t1[k];
+         t1[k]=t2[k];
+         t2[k]=tmp;
+         }
+   }
+
+// set the blending mode for back-to-front or front-to-back compositing
+inline void tile::setblend(BOOLINT front2back)
+   {
+   if (!front2back) glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+   else glBlendFunc(GL_ONE_MINUS_DST_ALPHA,GL_ONE);
+   }
+
+// draw the sliced vertex array
+void tile::drawslices()
+   {
+#ifdef GL_ARB_multitexture
+
+   int i;
+
+   float *base;
+   int stride;
+
+   GLenum target;
+   GLboolean depthmask,alphatest;
+
+   // vertices are either sourced from a bound vertex buffer or from client memory
+   if (VFIRST<0) base=VERTS;
+   else base=(float *)((size_t)VFIRST*VSIZE*sizeof(float));
+
+   stride=VSIZE*sizeof(float);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3,GL_FLOAT,stride,base);
+
+   if (TFUNC->get_dim())
+      {
+      glClientActiveTextureARB(GL_TEXTURE0_ARB);
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer(3,GL_FLOAT,stride,base+3);
+
+      glClientActiveTextureARB(GL_TEXTURE1_ARB);
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer(3,GL_FLOAT,stride,base+6);
+
+      if (TFUNC->get_num()!=1)
+         {
+         glClientActiveTextureARB(GL_TEXTURE2_ARB);
+         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+         glTexCoordPointer(3,GL_FLOAT,stride,base);
+         }
+      }
+   else
+      {
+      glClientActiveTextureARB(GL_TEXTURE0_ARB);
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer(3,GL_FLOAT,stride,base);
+
+      if (TFUNC->get_num()!=1)
+         {
+         glClientActiveTextureARB(GL_TEXTURE1_ARB);
+         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+         glTexCoordPointer(3,GL_FLOAT,stride,base);
+         }
+      }
+
+   if (TFUNC->get_aid()!=0)
+      {
+      // each channel absorbs and emits like an RGBA table with the opacity of that channel
+      // so the channels are drawn in one masked pass each instead of alternating per polygon
+#ifdef GL_ARB_fragment_program
+      setprogparTF(0);
+#endif
+
+      glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+
+      // the tables are looked up from texture unit 3
+      glActiveTextureARB(GL_TEXTURE3_ARB);
+
+      target=(TFUNC->get_num()==1 || !TFUNC->get_dim())?GL_TEXTURE_2D:GL_TEXTURE_3D;
+
+      glGetBooleanv(GL_DEPTH_WRITEMASK,&depthmask);
+
+      // a channel may emit without absorbing so its fragments must pass the alpha test
+      alphatest=glIsEnabled(GL_ALPHA_TEST);
+      glDisable(GL_ALPHA_TEST);
+
+      for (i=0; i<3; i++)
+         {
+         glBindTexture(target,TFUNC->get_cid(i));
+         glTexParameteri(target,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+         glTexParameteri(target,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+         if (target==GL_TEXTURE_3D) glTexParameteri(target,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
+         glTexParameteri(target,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+         glTexParameteri(target,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+
+         glColorMask(i==0,i==1,i==2,GL_FALSE);
+
+         // only the last pass may write depth or the other passes would be occluded
+         glDepthMask((i==2)?depthmask:GL_FALSE);
+
+         glDrawArrays(GL_TRIANGLES,0,VERTCNT);
+         }
+
+      glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+
+      if (alphatest) glEnable(GL_ALPHA_TEST);
+
+      glActiveTextureARB(GL_TEXTURE0_ARB);
+      }
+   else
+      {
+#ifdef GL_ARB_fragment_program
+      setprogparTF(0);
+#endif
+
+      glDrawArrays(GL_TRIANGLES,0,VERTCNT);
+      }
+
+   for (i=2; i>=0; i--)
+      {
+      glClientActiveTextureARB(GL_TEXTURE0_ARB+i);
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+      }
+
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+#endif
+   }
+
 // bind 3D texture map
 void tile::bindtexmap(int texid3D)
    {
@@ -1119,35 +1524,247 @@ void tile::bindtexmaps3D(int texid3D,int texid3DG,int texid3DE,int texid3DA,floa
 
 void tile::setprogparSFX(int sfxmode)
    {
-   float a=0.0f,b=0.0f,c=0.5f,d=0.5f;
+   float a,b,c,d;
 
-   if (sfxmode==1) {a=0.5f; c=0.5f;}
-   else if (sfxmode==2) {a=0.5f; c=0.0f;}
-   else if (sfxmode==3) {b=0.5f; d=0.0f;}
-   else if (sfxmode==4) {b=0.5f; d=0.5f;}
+   getparSFX(sfxmode,&a,&b,&c,&d);
 
    glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,2,a,b,c,d);
    }
 
+void tile::getparSFX(int sfxmode,float *a,float *b,float *c,float *d)
+   {
+   *a=0.0f; *b=0.0f; *c=0.5f; *d=0.5f;
+
+   if (sfxmode==1) {*a=0.5f; *c=0.5f;}
+   else if (sfxmode==2) {*a=0.5f; *c=0.0f;}
+   else if (sfxmode==3) {*b=0.5f; *d=0.0f;}
+   else if (sfxmode==4) {*b=0.5f; *d=0.5f;}
+   }
+
+// set the emission and opacity correction and the windowing transform of the tf tables
+// pass 0 draws an rgba table, pass 1 and 2 draw separate absorption and emission tables
+void tile::setprogparTF(int pass)
+   {
+   float lin[4],ex[4];
+
+   getparTF(pass,lin,ex);
+
+   glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,3,lin[0],lin[1],lin[2],lin[3]);
+   glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,4,ex[0],ex[1],ex[2],ex[3]);
+
+   glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,5,TFUNC->get_wscale(),TFUNC->get_wbias(),0.0f,0.0f);
+   }
+
+// the channels are scaled linearly (emission) or exponentially (opacity)
+void tile::getparTF(int pass,float lin[4],float ex[4])
+   {
+   float ke,ka;
+
+   int i;
+
+   for (i=0; i<4; i++)
+      {
+      lin[i]=1.0f;
+      ex[i]=0.0f;
+      }
+
+   // quantized tables already contain the slab thickness
+   if (!TFUNC->get_float()) return;
+
+   ke=TFUNC->get_ecorr();
+   ka=TFUNC->get_acorr()/flog(2.0f);
+
+   for (i=0; i<3; i++)
+      if (pass==1)
+         {
+         lin[i]=0.0f;
+         ex[i]=ka;
+         }
+      else lin[i]=ke;
+
+   if (pass==0)
+      {
+      lin[3]=0.0f;
+      ex[3]=ka;
+      }
+   }
+
+// check whether or not the tile can be ray casted
+BOOLINT tile::castrays()
+   {
+   if (!RAYMODE || !RAYLOADED) return(FALSE);
+   if (RAYPROG[0]==0) return(FALSE);
+
+   // separate absorption needs two passes
+   return(TFUNC->get_aid()==0);
+   }
+
+// cast rays through the visible tile
+void tile::drawrays(int mode,float slab,float rslab)
+   {
+   int i;
+
+   int prog;
+   int planes;
+
+   float a,b,c,d;
+   float lin[4],ex[4];
+
+   float v[8][3];
+
+   GLubyte faces[6*4];
+   int count;
+
+   static const GLubyte hexa[6][4]={{0,2,6,4},{1,3,7,5},
+                                    {0,1,5,4},{2,3,7,6},
+                                    {0,1,3,2},{4,5,7,6}};
+
+   float minx,maxx,miny,maxy,minz,maxz;
+   BOOLINT inside;
+
+   BOOLINT occ;
+   GLint unit;
+
+   prog=RAYPROG[mode];
+
+   minx=MX2-0.5f*SX2; maxx=MX2+0.5f*SX2;
+   miny=MY2-0.5f*SY2; maxy=MY2+0.5f*SY2;
+   minz=MZ2-0.5f*SZ2; maxz=MZ2+0.5f*SZ2;
+
+   for (i=0; i<8; i++)
+      {
+      v[i][0]=(i&1)?maxx:minx;
+      v[i][1]=(i&2)?maxy:miny;
+      v[i][2]=(i&4)?maxz:minz;
+      }
+
+   // check whether or not the near plane cuts the visible tile
+   inside=FALSE;
+   for (i=0; i<8; i++)
+      if ((v[i][0]-EX)*DX+(v[i][1]-EY)*DY+(v[i][2]-EZ)*DZ<=NEARP) inside=TRUE;
+
+   // rasterize the front faces or the back faces if the front faces are clipped
+   count=0;
+   for (i=0; i<6; i++)
+      {
+      BOOLINT front;
+
+      if (i==0) front=(EX<minx);
+      else if (i==1) front=(EX>maxx);
+      else if (i==2) front=(EY<miny);
+      else if (i==3) front=(EY>maxy);
+      else if (i==4) front=(EZ<minz);
+      else front=(EZ>maxz);
+
+      if (front!=inside)
+         {
+         faces[count++]=hexa[i][0];
+         faces[count++]=hexa[i][1];
+         faces[count++]=hexa[i][2];
+         faces[count++]=hexa[i][3];
+         }
+      }
+
+   if (count==0) return;
+
+   // the shader clips the rays against the enabled clip planes
+   for (planes=0; planes<6; planes++)
+      if (glIsEnabled(GL_CLIP_PLANE0+planes)) glDisable(GL_CLIP_PLANE0+planes);
+      else break;
+
+   getparSFX(SFXMODE,&a,&b,&c,&d);
+
+#ifdef GL_ARB_fragment_program
+   glDisable(GL_FRAGMENT_PROGRAM_ARB);
+#endif
+
+   bindglslprog(prog);
+
+   setglslprogtex(prog,"vol",0);
+   setglslprogtex(prog,"grad",(mode>=3)?2:1);
+   setglslprogtex(prog,"tf",3);
+
+   setglslprogpar(prog,"eye",EX,EY,EZ,NEARP);
+   setglslprogpar(prog,"dir",DX,DY,DZ,slab);
+   setglslprogpar(prog,"boxmin",minx,miny,minz,0.0f);
+   setglslprogpar(prog,"boxmax",maxx,maxy,maxz,0.0f);
+   setglslprogpar(prog,"param",RAYTHRES,planes,1.0f/(slab*rslab),NOISE);
+   setglslprogpar(prog,"light",AMBNT,DIFUS,SPECL,SPECX);
+   setglslprogpar(prog,"sfx",a,b,c,d);
+
+   getparTF(0,lin,ex);
+
+   setglslprogpar(prog,"tflin",lin[0],lin[1],lin[2],lin[3]);
+   setglslprogpar(prog,"tfexp",ex[0],ex[1],ex[2],ex[3]);
+
+   setglslprogpar(prog,"window",TFUNC->get_wscale(),TFUNC->get_wbias(),0.0f,0.0f);
+
+   // rays start with the opacity in front of the tile
+   setglslprogtex(prog,"occ",4);
+
+   occ=(RAYOCCTEX!=0 && RAYOCCWIDTH>0 && RAYOCCHEIGHT>0);
+
+#ifdef GL_ARB_multitexture
+   if (occ)
+      {
+      glGetIntegerv(GL_ACTIVE_TEXTURE_ARB,&unit);
+      glActiveTextureARB(GL_TEXTURE4_ARB);
+      glBindTexture(GL_TEXTURE_2D,RAYOCCTEX);
+      glActiveTextureARB(unit);
+      }
+#else
+   occ=FALSE;
+#endif
+
+   if (occ) setglslprogpar(prog,"occwin",RAYOCCX,RAYOCCY,1.0f/RAYOCCWIDTH,1.0f/RAYOCCHEIGHT);
+   else setglslprogpar(prog,"occwin",0.0f,0.0f,0.0f,0.0f);
+
+   // ray segments do not have a single depth
+   glDepthMask(GL_FALSE);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3,GL_FLOAT,0,v);
+
+   glDrawElements(GL_QUADS,count,GL_UNSIGNED_BYTE,faces);
+
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+   glDepthMask(GL_TRUE);
+
+   bindglslprog(0);
+
+#ifdef GL_ARB_multitexture
+   if (occ)
+      {
+      glActiveTextureARB(GL_TEXTURE4_ARB);
+      glBindTexture(GL_TEXTURE_2D,0);
+      glActiveTextureARB(unit);
+      }
+#endif
+
+   for (i=0; i<planes; i++)
+      glEnable(GL_CLIP_PLANE0+i);
+   }
+
 // render the tile
 void tile::render(float ex,float ey,float ez,
                   float dx,float dy,float dz,
                   float ux,float uy,float uz,
                   float nearp,float slab,float rslab,
                   BOOLINT lighting,
-                  BOOLINT depth)
+                  BOOLINT depth,
+                  BOOLINT front2back)
    {
-   EX=ex; EY=ey; EZ=ez;
-   DX=dx; DY=dy; DZ=dz;
-   UX=ux; UY=uy; UZ=uz;
+   // slice the tile unless it has been sliced for this frame already
+   if (!SLICED) slice(ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,front2back);
+   SLICED=FALSE;
 
-   NEARP=nearp;
+   // skip tiles that failed the ZOT or have no slices
+   if (!RAYS && VERTCNT==0) return;
 
-   // try the ZOT
-   if (EXTRA==NULL || TFUNC->get_num()==1)
-      {if (TFUNC->zot(MINDATA/255.0f,MAXDATA/255.0f)) return;}
-   else
-      {if (TFUNC->zot(MINDATA/255.0f,MAXDATA/255.0f,MINEXTRA/255.0f,MAXEXTRA/255.0f)) return;}
+   // skip bricks that have not been streamed in yet
+   if (brick::get_budget()>0 && !is_resident()) return;
+   make_resident();
 
    glEnable(GL_BLEND);
 
@@ -1169,17 +1786,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1187,17 +1794,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1205,17 +1802,10 @@ void tile::render(float ex,float ey,float ez,
 
          glActiveTextureARB(GL_TEXTURE3_ARB);
 
-         glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+         setblend(front2back);
 
-         drawhexa(MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  slab);
+         if (RAYS) drawrays(1,slab,rslab);
+         else drawslices();
 
          glActiveTextureARB(GL_TEXTURE1_ARB);
 
@@ -1246,17 +1836,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1264,17 +1844,10 @@ void tile::render(float ex,float ey,float ez,
 
          glActiveTextureARB(GL_TEXTURE3_ARB);
 
-         glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+         setblend(front2back);
 
-         drawhexa(MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  slab);
+         if (RAYS) drawrays(0,slab,rslab);
+         else drawslices();
 
          glActiveTextureARB(GL_TEXTURE0_ARB);
 
@@ -1300,17 +1873,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(EXTRA);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1318,17 +1881,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1336,17 +1889,10 @@ void tile::render(float ex,float ey,float ez,
 
          glActiveTextureARB(GL_TEXTURE3_ARB);
 
-         glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+         setblend(front2back);
 
-         drawhexa(MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  slab);
+         if (RAYS) drawrays(2,slab,rslab);
+         else drawslices();
 
          glActiveTextureARB(GL_TEXTURE1_ARB);
 
@@ -1381,17 +1927,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(EXTRA);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1399,17 +1935,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1417,17 +1943,7 @@ void tile::render(float ex,float ey,float ez,
 
          glMatrixMode(GL_TEXTURE);
 
-         glPushMatrix();
-         glLoadIdentity();
-
-         glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-         glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE,
-                  (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-         glTranslatef(0.5f,0.5f,0.5f);
-         glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-         glTranslatef(-MX,-MY,-MZ);
+         loadtexmatrix(BRICK);
 
          glMatrixMode(GL_MODELVIEW);
 
@@ -1435,17 +1951,10 @@ void tile::render(float ex,float ey,float ez,
 
          glActiveTextureARB(GL_TEXTURE3_ARB);
 
-         glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+         setblend(front2back);
 
-         drawhexa(MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2-0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2+0.5f*SZ2,
-                  MX2+0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  MX2-0.5f*SX2,MY2+0.5f*SY2,MZ2-0.5f*SZ2,
-                  slab);
+         if (RAYS) drawrays((lighting && TFUNC->get_imode())?4:3,slab,rslab);
+         else drawslices();
 
          glActiveTextureARB(GL_TEXTURE2_ARB);
 
@@ -1608,6 +2117,78 @@ void tile::intersecthexa(const float p1x,const float p1y,const float p1z,
    intersecttetra(p8x,p8y,p8z,p3x,p3y,p3z,p1x,p1y,p1z,p4x,p4y,p4z,ox,oy,oz,nx,ny,nz);
    }
 
+// render the sliced tile as an order-independent intensity projection
+void tile::project(float scale,float bias,float alpha)
+   {
+#if defined(GL_ARB_multitexture) && defined(GL_ARB_fragment_program)
+
+   float tfmin,tfmax;
+
+   float *base;
+   int stride;
+
+   if (VERTCNT==0) return;
+
+   // skip bricks that have not been streamed in yet
+   if (brick::get_budget()>0 && !is_resident()) return;
+   make_resident();
+
+   // get non-zero tf range
+   tfmin=TFUNC->get_nonzero_min();
+   tfmax=TFUNC->get_nonzero_max();
+   if (tfmax<=tfmin) tfmax=tfmin+1.0f/255.0f;
+
+   // activate fragment program
+   glEnable(GL_FRAGMENT_PROGRAM_ARB);
+   if (!SFXMODE) glBindProgramARB(GL_FRAGMENT_PROGRAM_ARB,PROGID[10]);
+   else
+      {
+      glBindProgramARB(GL_FRAGMENT_PROGRAM_ARB,PROGID[11]);
+      setprogparSFX(SFXMODE);
+      }
+
+   glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,0,tfmin,1.0f/(tfmax-tfmin),0.0f,0.0f);
+   glProgramEnvParameter4fARB(GL_FRAGMENT_PROGRAM_ARB,1,scale,bias,alpha,0.0f);
+
+   glActiveTextureARB(GL_TEXTURE0_ARB);
+
+   bindtexmap(BRICK->get_id());
+
+   glMatrixMode(GL_TEXTURE);
+   loadtexmatrix(BRICK);
+   glMatrixMode(GL_MODELVIEW);
+
+   // vertices are either sourced from a bound vertex buffer or from client memory
+   if (VFIRST<0) base=VERTS;
+   else base=(float *)((size_t)VFIRST*VSIZE*sizeof(float));
+
+   stride=VSIZE*sizeof(float);
+
+   // the slice vertices are used as texture coordinates
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3,GL_FLOAT,stride,base);
+
+   glClientActiveTextureARB(GL_TEXTURE0_ARB);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+   glTexCoordPointer(3,GL_FLOAT,stride,base);
+
+   glDrawArrays(GL_TRIANGLES,0,VERTCNT);
+
+   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+   glMatrixMode(GL_TEXTURE);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+
+   bindtexmap(0);
+
+   glBindProgramARB(GL_FRAGMENT_PROGRAM_ARB,0);
+   glDisable(GL_FRAGMENT_PROGRAM_ARB);
+
+#endif
+   }
+
 // render a tile slice
 void tile::renderslice(float ox,float oy,float oz,
                        float nx,float ny,float nz)
@@ -1618,17 +2199,7 @@ void tile::renderslice(float ox,float oy,float oz,
 
    glMatrixMode(GL_TEXTURE);
 
-   glPushMatrix();
-   glLoadIdentity();
-
-   glTranslatef((0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE,(0.5f+BORDER)/BSIZE);
-   glScalef((float)(BSIZE-1-2*BORDER)/BSIZE,
-            (float)(BSIZE-1-2*BORDER)/BSIZE,
-            (float)(BSIZE-1-2*BORDER)/BSIZE);
-
-   glTranslatef(0.5f,0.5f,0.5f);
-   glScalef(1.0f/SX,1.0f/SY,1.0f/SZ);
-   glTranslatef(-MX,-MY,-MZ);
+   loadtexmatrix(BRICK);
 
    glMatrixMode(GL_MODELVIEW);
 
@@ -11,7 +11,56 @@
 
 #define MAXSTR 256
 
-#define PROGNUM 10
+#define PROGNUM 12
+
+#define RAYPROGNUM 5
+
+#define ATLASSIZE (1<<28)
+
+// intensity projection modes
+#define PROJ_NONE 0 // emission and absorption compositing
+#define PROJ_MIP 1 // maximum intensity projection
+#define PROJ_MINIP 2 // minimum intensity projection
+#define PROJ_AVERAGE 3 // average intensity projection
+
+// a texture atlas holding bricks of equal size
+class atlas
+   {
+   public:
+
+   // default constructor
+   atlas(int bricksize,int count);
+
+   // destructor
+   ~atlas();
+
+   // insert a brick and return its position in voxels
+   BOOLINT insert(unsigned char *volume,
+                  int *px,int *py,int *pz);
+
+   // check whether or not the atlas has free slots
+   BOOLINT is_full() {return(COUNT>=NX*NY*NZ);}
+
+   // return texture id
+   int get_id() {return(TEXID);}
+
+   // return atlas size in voxels
+   int get_width() {return(NX*BSIZE);}
+   int get_height() {return(NY*BSIZE);}
+   int get_depth() {return(NZ*BSIZE);}
+
+   protected:
+
+   GLuint TEXID;
+
+   int BSIZE; // brick size in voxels
+   int NX,NY,NZ; // number of slots
+   int COUNT; // number of used slots
+
+   private:
+   };
+
+typedef atlas *atlasptr;
 
 // a texture brick
 class brick
@@ -26,19 +75,64 @@ class brick
 
    // generate 3D texture map
    void buildtexmap3D(unsigned char *volume,
-                      int width,int height,int depth);
+                      int width,int height,int depth,
+                      atlas *pack=NULL);
 
    // return texture id
-   int get_id() {return(TEXID);}
+   int get_id() {return((ATLAS!=NULL)?ATLAS->get_id():TEXID);}
+
+   // multiply texture matrix with the atlas transform
+   void multexmatrix();
+
+   // return texture size in bytes
+   long long get_size() {return((long long)WIDTH*HEIGHT*DEPTH);}
+
+   // check whether or not the texture map is resident
+   BOOLINT is_resident() {return(get_id()!=0);}
+
+   // make the texture map resident
+   BOOLINT make_resident();
+
+   // set graphics memory budget for managed bricks (0=unlimited)
+   static void set_budget(long long budget);
+
+   // get graphics memory budget and usage of managed bricks
+   static long long get_budget() {return(BUDGET);}
+   static long long get_usage() {return(USAGE);}
+
+   // advance the frame counter of the residency manager
+   static void next_frame() {FRAME++;}
 
    protected:
 
    GLuint TEXID;
 
+   int WIDTH,HEIGHT,DEPTH;
+
+   unsigned char *DATA; // host copy of managed brick
+
+   atlas *ATLAS; // texture atlas of packed brick
+   int OX,OY,OZ; // position in texture atlas
+
+   // upload 3D texture map
+   void uploadtexmap3D(unsigned char *volume);
+
    // delete 3D texture map
    void deletetexmap3D();
 
    private:
+
+   // lru list of resident managed bricks:
+
+   brick *PREV,*NEXT;
+   unsigned int STAMP;
+
+   void link();
+   void unlink();
+
+   static brick *HEAD,*TAIL;
+   static long long BUDGET,USAGE;
+   static unsigned int FRAME;
    };
 
 // a tile of the volume
@@ -55,19 +149,34 @@ class tile
    // set stereo interlacing mode
    static void setSFXmode(int sfxmode);
 
+   // set ray casting mode with early ray termination threshold
+   static void setRAYmode(BOOLINT raymode,float thres=0.95f);
+
+   // set the opacity composited in front of the following tiles (0=none)
+   // front-to-back rays start with this opacity and terminate early across tiles
+   static void setRAYoccluder(GLuint tex=0,int x=0,int y=0,int width=0,int height=0);
+
+   // compile ray casting shaders on demand
+   static void setupray();
+
+   // set intensity projection mode
+   static void setPROJmode(int projmode);
+
    // set the tile data
    void set_data(unsigned char *data,
                  unsigned int width,unsigned int height,unsigned int depth,
                  float mx,float my,float mz,
                  float sx,float sy,float sz,
                  int px,int py,int pz,
-                 int bricksize,int border);
+                 int bricksize,int border,
+                 atlas *pack=NULL);
 
    // set the extra tile data
    void set_extra(unsigned char *extra,
                   unsigned int width,unsigned int height,unsigned int depth,
                   int px,int py,int pz,
-                  int bricksize);
+                  int bricksize,
+                  atlas *pack=NULL);
 
    // set the tile size
    void set_size(float mx,float my,float mz,
@@ -76,6 +185,24 @@ class tile
    // set ambient/diffuse/specular lighting coefficients
    void set_light(float noise,float ambnt,float difus,float specl,float specx);
 
+   // check whether or not the tile is invisible with respect to the tf
+   BOOLINT is_empty();
+
+   // remember whether or not the tile was found occluded
+   void set_occluded(BOOLINT occluded) {OCCLUDED=occluded;}
+
+   // check whether or not the tile was found occluded in the last frame
+   BOOLINT was_occluded() {return(OCCLUDED);}
+
+   // check whether or not the tile bricks are resident
+   BOOLINT is_resident();
+
+   // make the tile bricks resident
+   BOOLINT make_resident();
+
+   // return graphics memory of the tile bricks in bytes
+   long long get_memory();
+
    // get ambient/diffuse/specular lighting coefficients
    void get_light(float *noise,float *ambnt,float *difus,float *specl,float *specx);
 
@@ -95,13 +222,33 @@ class tile
    float get_sy2() {return(SY2);}
    float get_sz2() {return(SZ2);}
 
+   // slice the tile into its vertex array (thread-safe)
+   void slice(float ex,float ey,float ez,
+              float dx,float dy,float dz,
+              float ux,float uy,float uz,
+              float nearp,float slab,
+              BOOLINT front2back=FALSE);
+
+   // return the sliced vertex array
+   float *get_vertices() {return(VERTS);}
+   int get_vertexcount() {return(VERTCNT);}
+   int get_vertexsize() {return(VSIZE);}
+
+   // draw the sliced vertices from a bound vertex buffer at the given offset
+   void set_vertexbuffer(int first) {VFIRST=first;}
+
    // render the tile
    void render(float ex,float ey,float ez,
                float dx,float dy,float dz,
                float ux,float uy,float uz,
                float nearp,float slab,float rslab,
                BOOLINT lighting=FALSE,
-               BOOLINT depth=TRUE);
+               BOOLINT depth=TRUE,
+               BOOLINT front2back=FALSE);
+
+   // render the sliced tile as an order-independent intensity projection
+   // the windowed intensity is scaled and biased, the opacity is constant
+   void project(float scale,float bias,float alpha);
 
    // render a tile slice
    void renderslice(float ox,float oy,float oz,
@@ -122,6 +269,12 @@ class tile
    unsigned char MINDATA,MAXDATA; // range of primary data
    unsigned char MINEXTRA,MAXEXTRA; // range of extra data
 
+   BOOLINT EMPTY; // cached visibility
+   unsigned int EMPTYSTAMP; // tf stamp of the cached visibility
+   int EMPTYMODE; // projection mode of the cached visibility
+
+   BOOLINT OCCLUDED; // last available occlusion query result
+
    brick *BRICK,*EXTRA; // primary and extra data
    tfunc2D *TFUNC; // applied transfer function
 
@@ -129,6 +282,9 @@ class tile
    float NOISE,AMBNT,DIFUS,SPECL,SPECX;
    BOOLINT LIGHTING;
 
+   // load texture matrix of brick
+   inline void loadtexmatrix(brick *b);
+
    // computation of slice planes:
 
    inline void intersect(const float px,const float py,const float pz,
@@ -137,7 +293,9 @@ class tile
                          const float nx,const float ny,const float nz,
                          float *mx,float *my,float *mz);
 
-   inline void projtexcoords(const float x,const float y,const float z,const float slab2);
+   inline void projtexcoords(const float x,const float y,const float z,const float slab2,float *v);
+
+   inline float *addpolygon(int count);
 
    inline void slicetetra1(const float p1x,const float p1y,const float p1z,const float d1,
                            const float p2x,const float p2y,const float p2z,const float d2,
@@ -210,6 +368,26 @@ class tile
 
    float NEARP;
 
+   // sliced vertex array:
+
+   float *VERTS;
+   int VERTMAX,VERTCNT,VSIZE;
+
+   BOOLINT SLICED;
+   int VFIRST;
+
+   void reverse();
+   void drawslices();
+
+   inline void setblend(BOOLINT front2back);
+
+   // ray casting:
+
+   BOOLINT RAYS;
+
+   BOOLINT castrays();
+   void drawrays(int mode,float slab,float rslab);
+
    // texture shader and fragment program setup
    void bindtexmap(int texid3D);
    void bindtexmaps(int texid3D,int texid2DE,int texid2DA,int sfxmode=0);
@@ -217,6 +395,10 @@ class tile
    void bindtexmaps2D(int texid3D,int texid3DG,int texid2DE,int texid2DA,int sfxmode=0);
    void bindtexmaps3D(int texid3D,int texid3DG,int texid3DE,int texid3DA,float rslab,int sfxmode=0);
    void setprogparSFX(int sfxmode=0);
+   void getparSFX(int sfxmode,float *a,float *b,float *c,float *d);
+
+   void setprogparTF(int pass=0);
+   void getparTF(int pass,float lin[4],float ex[4]);
 
    // fragment program loading:
 
@@ -230,6 +412,23 @@ class tile
    // stereo interlacing mode:
 
    static int SFXMODE;
+
+   // intensity projection mode:
+
+   static int PROJMODE;
+
+   // ray casting shaders:
+
+   static BOOLINT RAYMODE;
+   static float RAYTHRES;
+   static BOOLINT RAYLOADED;
+   static int RAYPROG[RAYPROGNUM];
+
+   static GLuint RAYOCCTEX;
+   static int RAYOCCX,RAYOCCY;
+   static int RAYOCCWIDTH,RAYOCCHEIGHT;
+
+   static void destroyray();
    };
 
 typedef tile *tileptr;
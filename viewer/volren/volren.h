@@ -108,6 +108,31 @@ class volren: public volscene
          }
       }
 
+   //! use a ranked transfer function preset of the histogram analysis
+   //! returns FALSE while the analysis is still running or if there is no such preset
+   //! the automatic window replaces the window of the transfer function on demand
+   BOOLINT set_tfpreset(int rank=0,BOOLINT autowindow=TRUE)
+      {
+      histo::preset *preset;
+      float lo,hi;
+
+      if (rank<0 || rank>=get_histo()->get_presets()) return(FALSE);
+      if ((preset=get_histo()->get_preset(rank))==NULL) return(FALSE);
+
+      // the preset is mapped into the window of the transfer function
+      if (autowindow)
+         {
+         get_histo()->get_autowindow(&lo,&hi);
+         get_tfunc()->set_window(lo,hi);
+         }
+      else get_tfunc()->get_window(&lo,&hi);
+
+      set_tfunc((preset->center-lo)/(hi-lo),preset->size/(hi-lo),
+                preset->r,preset->g,preset->b);
+
+      return(TRUE);
+      }
+
    //! extract iso surface
    char *extractsurface(double isovalue,
                         void (*feedback)(const char *info,float percent,void *obj)=NULL,void *obj=NULL)
@@ -7,21 +7,73 @@
 #undef FBOMM
 
 #define TILEINC 1000
+#define ATLASINC 10
 #define QUEUEINC 1000
 
+#define OCCTHRES 0.99f
+
+#define ADAPTHIGH 1.1f
+#define ADAPTLOW 0.75f
+#define ADAPTSTEP 1.5f
+#define ADAPTFRAMES 8
+#define ADAPTMAX 8.0f
+
 #include "volume.h"
 #include "plain_progs.h"
 
+#include "threadbase.h"
+
+BOOLINT volume::ATLASMODE=FALSE;
+
 volume::volume(tfunc2D *tf,char *base)
    {
+   int i;
+
    TILEMAX=TILEINC;
    TILE=new tileptr[TILEMAX];
    TILECNT=0;
 
+   ATLASMAX=ATLASINC;
+   ATLAS=new atlasptr[ATLASMAX];
+   ATLASCNT=0;
+
    TFUNC=tf;
 
    if (base==NULL) strncpy(BASE,"volren",MAXSTR);
    else snprintf(BASE,MAXSTR,"%s/volren",base);
+
+   ORDER=NULL;
+   ORDERMAX=ORDERCNT=0;
+
+   HASVBO=FALSE;
+   VBO=0;
+
+   HASOCC=FALSE;
+   OCCQUERY[0]=0;
+   for (i=0; i<2*OCCBATCH; i++) OCCISSUED[i]=FALSE;
+   OCCTEX=0;
+   OCCX=OCCY=0;
+   OCCWIDTH=OCCHEIGHT=0;
+
+   char *GL_EXTs;
+
+   if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+
+#ifdef GL_ARB_vertex_buffer_object
+   if (strstr(GL_EXTs,"ARB_vertex_buffer_object")!=NULL) HASVBO=TRUE;
+
+#ifdef WINOS
+   if (glGenBuffersARB==NULL) HASVBO=FALSE;
+#endif
+#endif
+
+#ifdef GL_ARB_occlusion_query
+   if (strstr(GL_EXTs,"ARB_occlusion_query")!=NULL) HASOCC=TRUE;
+
+#ifdef WINOS
+   if (glGenQueriesARB==NULL) HASOCC=FALSE;
+#endif
+#endif
    }
 
 volume::~volume()
@@ -30,12 +82,63 @@ volume::~volume()
 
    for (i=0; i<TILECNT; i++) delete TILE[i];
    delete TILE;
+
+   for (i=0; i<ATLASCNT; i++) delete ATLAS[i];
+   delete[] ATLAS;
+
+   if (ORDER!=NULL) delete[] ORDER;
+
+#ifdef GL_ARB_vertex_buffer_object
+   if (VBO!=0) glDeleteBuffersARB(1,&VBO);
+#endif
+
+#ifdef GL_ARB_occlusion_query
+   if (OCCQUERY[0]!=0) glDeleteQueriesARB(2*OCCBATCH,OCCQUERY);
+#endif
+
+   if (OCCTEX!=0) glDeleteTextures(1,&OCCTEX);
    }
 
 // set stereo interlacing mode
 void volume::setSFXmode(int sfxmode)
    {tile::setSFXmode(sfxmode);}
 
+// set brick atlas mode
+void volume::setATLASmode(BOOLINT atlasmode)
+   {ATLASMODE=atlasmode;}
+
+// set ray casting mode
+void volume::setRAYmode(BOOLINT raymode,float thres)
+   {tile::setRAYmode(raymode,thres);}
+
+// set intensity projection mode
+void volume::setPROJmode(int projmode)
+   {tile::setPROJmode(projmode);}
+
+// return texture atlas with a free slot
+atlas *volume::pack(atlas *last,int bricksize,int count)
+   {
+   int i;
+
+   atlasptr *atlases;
+
+   if (!ATLASMODE || brick::get_budget()>0) return(NULL);
+
+   if (last!=NULL)
+      if (!last->is_full()) return(last);
+
+   if (ATLASCNT>=ATLASMAX)
+      {
+      ATLASMAX+=ATLASINC;
+      atlases=new atlasptr[ATLASMAX];
+      for (i=0; i<ATLASCNT; i++) atlases[i]=ATLAS[i];
+      delete[] ATLAS;
+      ATLAS=atlases;
+      }
+
+   return(ATLAS[ATLASCNT++]=new atlas(bricksize,count));
+   }
+
 // check brick size
 BOOLINT volume::check(int bricksize,float overmax)
    {
@@ -65,8 +168,19 @@ void volume::set_data(unsigned char *data,
 
    float newsize;
 
+   int total,totalx,totaly,totalz;
+
+   atlas *datapack=NULL,*extrapack=NULL;
+
    if (bricksize<=2*border) ERRORMSG();
 
+   // count tiles
+   for (totalz=0,pz=-2*border; pz<depth-1+border; pz+=bricksize-1-2*border) totalz++;
+   for (totaly=0,py=-2*border; py<height-1+border; py+=bricksize-1-2*border) totaly++;
+   for (totalx=0,px=-2*border; px<width-1+border; px+=bricksize-1-2*border) totalx++;
+
+   total=totalx*totaly*totalz;
+
    for (TILEZ=0,pz=-2*border; pz<depth-1+border; pz+=bricksize-1-2*border,TILEZ++)
       {
       if (feedback!=NULL)
@@ -97,18 +211,26 @@ void volume::set_data(unsigned char *data,
 
             TILE[TILECNT]=new tile(TFUNC,BASE);
 
+            datapack=pack(datapack,bricksize,total-TILECNT);
+
             TILE[TILECNT]->set_data(data,
                                     width,height,depth,
                                     mx2,my2,mz2,
                                     sx2,sy2,sz2,
                                     px,py,pz,
-                                    bricksize,border);
+                                    bricksize,border,
+                                    datapack);
 
             if (extra!=NULL)
+               {
+               extrapack=pack(extrapack,bricksize,total-TILECNT);
+
                TILE[TILECNT]->set_extra(extra,
                                         width,height,depth,
                                         px,py,pz,
-                                        bricksize);
+                                        bricksize,
+                                        extrapack);
+               }
 
             if (px+bricksize>width+2*border)
                {
@@ -159,19 +281,57 @@ void volume::set_light(float noise,float ambnt,float difus,float specl,float spe
    for (i=0; i<TILECNT; i++) TILE[i]->set_light(noise,ambnt,difus,specl,specx);
    }
 
-// sort tiles
-BOOLINT volume::sort(int x,int y,int z,
-                     int sx,int sy,int sz,
-                     float ex,float ey,float ez,
-                     float dx,float dy,float dz,
-                     float ux,float uy,float uz,
-                     float nearp,float slab,float rslab,
-                     BOOLINT lighting,
-                     BOOLINT (*abort)(void *abortdata),
-                     void *abortdata)
+// check whether or not all visible tiles are resident
+BOOLINT volume::is_resident()
    {
-   BOOLINT aborted=FALSE;
+   int i;
+
+   for (i=0; i<TILECNT; i++)
+      if (!TILE[i]->is_empty())
+         if (!TILE[i]->is_resident()) return(FALSE);
+
+   return(TRUE);
+   }
+
+// make missing visible tiles resident, consuming at most maxload uploads
+int volume::stream(int &maxload)
+   {
+   int i;
 
+   int missing=0;
+
+   for (i=0; i<TILECNT; i++)
+      if (!TILE[i]->is_empty())
+         if (TILE[i]->is_resident()) TILE[i]->make_resident();
+         else if (maxload>0)
+            {
+            if (!TILE[i]->make_resident()) missing++;
+            maxload--;
+            }
+         else missing++;
+
+   return(missing);
+   }
+
+// return graphics memory of the visible tiles in bytes
+long long volume::get_memory()
+   {
+   int i;
+
+   long long memory=0;
+
+   for (i=0; i<TILECNT; i++)
+      if (!TILE[i]->is_empty())
+         memory+=TILE[i]->get_memory();
+
+   return(memory);
+   }
+
+// sort tiles
+void volume::sort(int x,int y,int z,
+                  int sx,int sy,int sz,
+                  float ex,float ey,float ez)
+   {
    tileptr t1,t2;
 
    if (sx>1)
@@ -181,13 +341,13 @@ BOOLINT volume::sort(int x,int y,int z,
 
       if ((t1->get_mx()+t2->get_mx())/2.0f>ex)
          {
-         aborted=sort(x+sx/2,y,z,sx-sx/2,sy,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x,y,z,sx/2,sy,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x+sx/2,y,z,sx-sx/2,sy,sz,ex,ey,ez);
+         sort(x,y,z,sx/2,sy,sz,ex,ey,ez);
          }
       else
          {
-         aborted=sort(x,y,z,sx/2,sy,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x+sx/2,y,z,sx-sx/2,sy,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x,y,z,sx/2,sy,sz,ex,ey,ez);
+         sort(x+sx/2,y,z,sx-sx/2,sy,sz,ex,ey,ez);
          }
       }
    else if (sy>1)
@@ -197,13 +357,13 @@ BOOLINT volume::sort(int x,int y,int z,
 
       if ((t1->get_my()+t2->get_my())/2.0f>ey)
          {
-         aborted=sort(x,y+sy/2,z,sx,sy-sy/2,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x,y,z,sx,sy/2,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x,y+sy/2,z,sx,sy-sy/2,sz,ex,ey,ez);
+         sort(x,y,z,sx,sy/2,sz,ex,ey,ez);
          }
       else
          {
-         aborted=sort(x,y,z,sx,sy/2,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x,y+sy/2,z,sx,sy-sy/2,sz,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x,y,z,sx,sy/2,sz,ex,ey,ez);
+         sort(x,y+sy/2,z,sx,sy-sy/2,sz,ex,ey,ez);
          }
       }
    else if (sz>1)
@@ -213,27 +373,368 @@ BOOLINT volume::sort(int x,int y,int z,
 
       if ((t1->get_mz()+t2->get_mz())/2.0f>ez)
          {
-         aborted=sort(x,y,z+sz/2,sx,sy,sz-sz/2,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x,y,z,sx,sy,sz/2,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x,y,z+sz/2,sx,sy,sz-sz/2,ex,ey,ez);
+         sort(x,y,z,sx,sy,sz/2,ex,ey,ez);
          }
       else
          {
-         aborted=sort(x,y,z,sx,sy,sz/2,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
-         if (!aborted) aborted=sort(x,y,z+sz/2,sx,sy,sz-sz/2,ex,ey,ez,dx,dy,dz,ux,uy,uz,nearp,slab,rslab,lighting,abort,abortdata);
+         sort(x,y,z,sx,sy,sz/2,ex,ey,ez);
+         sort(x,y,z+sz/2,sx,sy,sz-sz/2,ex,ey,ez);
          }
       }
    else
+      ORDER[ORDERCNT++]=TILE[x+(y+z*TILEY)*TILEX];
+   }
+
+// parameters for parallel slicing of the sorted tiles
+struct volumeslicing
+   {
+   tileptr *order;
+
+   float ex,ey,ez,
+         dx,dy,dz,
+         ux,uy,uz;
+
+   float nearp,slab;
+
+   BOOLINT front2back;
+   };
+
+// slice a single tile
+static void volumeslice(int i,void *data)
+   {
+   volumeslicing *s=(volumeslicing *)data;
+
+   s->order[i]->slice(s->ex,s->ey,s->ez,
+                      s->dx,s->dy,s->dz,
+                      s->ux,s->uy,s->uz,
+                      s->nearp,s->slab,
+                      s->front2back);
+   }
+
+// gather the slices of all sorted tiles in a single vertex buffer
+void volume::upload()
+   {
+#ifdef GL_ARB_vertex_buffer_object
+
+   int i;
+
+   int first,count;
+
+   if (!HASVBO) return;
+
+   count=0;
+
+   for (i=0; i<ORDERCNT; i++)
+      count+=ORDER[i]->get_vertexcount()*ORDER[i]->get_vertexsize();
+
+   if (count==0) return;
+
+   if (VBO==0) glGenBuffersARB(1,&VBO);
+
+   glBindBufferARB(GL_ARRAY_BUFFER_ARB,VBO);
+   glBufferDataARB(GL_ARRAY_BUFFER_ARB,count*sizeof(float),NULL,GL_STREAM_DRAW_ARB);
+
+   first=0;
+
+   for (i=0; i<ORDERCNT; i++)
+      if ((count=ORDER[i]->get_vertexcount())>0)
+         {
+         glBufferSubDataARB(GL_ARRAY_BUFFER_ARB,
+                            first*ORDER[i]->get_vertexsize()*sizeof(float),
+                            count*ORDER[i]->get_vertexsize()*sizeof(float),
+                            ORDER[i]->get_vertices());
+
+         ORDER[i]->set_vertexbuffer(first);
+
+         first+=count;
+         }
+
+#endif
+   }
+
+// draw the visible box of a tile
+static void drawbox(tile *t)
+   {
+   float x1,y1,z1,x2,y2,z2;
+
+   x1=t->get_mx2()-0.5f*t->get_sx2();
+   y1=t->get_my2()-0.5f*t->get_sy2();
+   z1=t->get_mz2()-0.5f*t->get_sz2();
+
+   x2=t->get_mx2()+0.5f*t->get_sx2();
+   y2=t->get_my2()+0.5f*t->get_sy2();
+   z2=t->get_mz2()+0.5f*t->get_sz2();
+
+   glBegin(GL_QUADS);
+   glVertex3f(x1,y1,z1); glVertex3f(x1,y2,z1); glVertex3f(x1,y2,z2); glVertex3f(x1,y1,z2);
+   glVertex3f(x2,y1,z1); glVertex3f(x2,y1,z2); glVertex3f(x2,y2,z2); glVertex3f(x2,y2,z1);
+   glVertex3f(x1,y1,z1); glVertex3f(x1,y1,z2); glVertex3f(x2,y1,z2); glVertex3f(x2,y1,z1);
+   glVertex3f(x1,y2,z1); glVertex3f(x2,y2,z1); glVertex3f(x2,y2,z2); glVertex3f(x1,y2,z2);
+   glVertex3f(x1,y1,z1); glVertex3f(x2,y1,z1); glVertex3f(x2,y2,z1); glVertex3f(x1,y2,z1);
+   glVertex3f(x1,y1,z2); glVertex3f(x1,y2,z2); glVertex3f(x2,y2,z2); glVertex3f(x2,y1,z2);
+   glEnd();
+   }
+
+// check whether or not the visible box of a tile is cut by the near plane
+static BOOLINT isnear(tile *t,
+                      float ex,float ey,float ez,
+                      float dx,float dy,float dz,
+                      float nearp)
+   {
+   int i;
+
+   float x,y,z;
+
+   for (i=0; i<8; i++)
       {
-      TILE[x+(y+z*TILEY)*TILEX]->render(ex,ey,ez,
-                                        dx,dy,dz,
-                                        ux,uy,uz,
-                                        nearp,slab,rslab,
-                                        lighting);
+      x=t->get_mx2()+((i&1)?0.5f:-0.5f)*t->get_sx2();
+      y=t->get_my2()+((i&2)?0.5f:-0.5f)*t->get_sy2();
+      z=t->get_mz2()+((i&4)?0.5f:-0.5f)*t->get_sz2();
 
-      if (abort!=NULL) aborted=abort(abortdata);
+      if ((x-ex)*dx+(y-ey)*dy+(z-ez)*dz<=nearp) return(TRUE);
       }
 
-   return(aborted);
+   return(FALSE);
+   }
+
+// extend a window rectangle by the footprint of the visible box of a tile
+static void footprint(tile *t,
+                      const GLfloat *mv,const GLfloat *proj,const GLint *viewport,
+                      float *x1,float *y1,float *x2,float *y2)
+   {
+   int i,j;
+
+   float v[4],e[4],c[4];
+   float wx,wy;
+
+   for (i=0; i<8; i++)
+      {
+      v[0]=t->get_mx2()+((i&1)?0.5f:-0.5f)*t->get_sx2();
+      v[1]=t->get_my2()+((i&2)?0.5f:-0.5f)*t->get_sy2();
+      v[2]=t->get_mz2()+((i&4)?0.5f:-0.5f)*t->get_sz2();
+      v[3]=1.0f;
+
+      for (j=0; j<4; j++) e[j]=mv[j]*v[0]+mv[4+j]*v[1]+mv[8+j]*v[2]+mv[12+j]*v[3];
+      for (j=0; j<4; j++) c[j]=proj[j]*e[0]+proj[4+j]*e[1]+proj[8+j]*e[2]+proj[12+j]*e[3];
+
+      wx=viewport[0]+(0.5f*c[0]/c[3]+0.5f)*viewport[2];
+      wy=viewport[1]+(0.5f*c[1]/c[3]+0.5f)*viewport[3];
+
+      if (wx<*x1) *x1=wx;
+      if (wx>*x2) *x2=wx;
+      if (wy<*y1) *y1=wy;
+      if (wy>*y2) *y2=wy;
+      }
+   }
+
+// issue occlusion queries for a batch of sorted tiles
+// the queries are stored in one of two alternating slots per batch
+void volume::occlude(int first,int count,
+                     float ex,float ey,float ez,
+                     float dx,float dy,float dz,
+                     float nearp)
+   {
+#ifdef GL_ARB_occlusion_query
+
+   int i,slot;
+
+   GLint viewport[4];
+   GLfloat mv[16],proj[16];
+
+   float x1,y1,x2,y2;
+   int px1,py1,px2,py2;
+
+   static const GLfloat planeS[4]={1.0f,0.0f,0.0f,0.0f};
+   static const GLfloat planeT[4]={0.0f,1.0f,0.0f,0.0f};
+   static const GLfloat planeR[4]={0.0f,0.0f,1.0f,0.0f};
+   static const GLfloat planeQ[4]={0.0f,0.0f,0.0f,1.0f};
+
+   if (OCCQUERY[0]==0) glGenQueriesARB(2*OCCBATCH,OCCQUERY);
+
+   slot=first%(2*OCCBATCH);
+
+   // the slots are reused two batches after they were issued
+   retire(slot,count);
+
+   glGetIntegerv(GL_VIEWPORT,viewport);
+
+   glGetFloatv(GL_MODELVIEW_MATRIX,mv);
+   glGetFloatv(GL_PROJECTION_MATRIX,proj);
+
+   // the boxes cut by the near plane are not a conservative footprint
+   x1=y1=MAXFLOAT;
+   x2=y2=-MAXFLOAT;
+
+   for (i=0; i<count; i++)
+      {
+      OCCTILE[slot+i]=ORDER[first+i];
+      OCCISSUED[slot+i]=FALSE;
+
+      if (!isnear(ORDER[first+i],ex,ey,ez,dx,dy,dz,nearp))
+         {
+         footprint(ORDER[first+i],mv,proj,viewport,&x1,&y1,&x2,&y2);
+         OCCISSUED[slot+i]=TRUE;
+         }
+      else ORDER[first+i]->set_occluded(FALSE);
+      }
+
+   // window rectangle covered by the queried boxes
+   x1=fmax(x1,viewport[0]);
+   y1=fmax(y1,viewport[1]);
+   x2=fmin(x2,viewport[0]+viewport[2]-1);
+   y2=fmin(y2,viewport[1]+viewport[3]-1);
+
+   if (x1>x2 || y1>y2)
+      {
+      for (i=0; i<count; i++)
+         {
+         OCCISSUED[slot+i]=FALSE;
+         ORDER[first+i]->set_occluded(FALSE);
+         }
+
+      return;
+      }
+
+   px1=ftrc(x1);
+   py1=ftrc(y1);
+   px2=min(ftrc(x2)+1,viewport[0]+viewport[2]-1);
+   py2=min(ftrc(y2)+1,viewport[1]+viewport[3]-1);
+
+   // copy the opacity of the already composited tiles within the footprint
+
+   if (OCCTEX==0) glGenTextures(1,&OCCTEX);
+   glBindTexture(GL_TEXTURE_2D,OCCTEX);
+
+   OCCX=viewport[0];
+   OCCY=viewport[1];
+
+   if (viewport[2]!=OCCWIDTH || viewport[3]!=OCCHEIGHT)
+      {
+      OCCWIDTH=viewport[2];
+      OCCHEIGHT=viewport[3];
+
+      glCopyTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA8,viewport[0],viewport[1],OCCWIDTH,OCCHEIGHT,0);
+
+      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+      }
+   else glCopyTexSubImage2D(GL_TEXTURE_2D,0,
+                            px1-viewport[0],py1-viewport[1],px1,py1,
+                            px2-px1+1,py2-py1+1);
+
+   glEnable(GL_TEXTURE_2D);
+   glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
+
+   // project the opacity buffer onto the tile boxes in eye coordinates
+   glMatrixMode(GL_TEXTURE);
+   glPushMatrix();
+   glLoadIdentity();
+   glTranslatef(0.5f,0.5f,0.0f);
+   glScalef(0.5f,0.5f,1.0f);
+   glMultMatrixf(proj);
+   glMatrixMode(GL_MODELVIEW);
+
+   glPushMatrix();
+   glLoadIdentity();
+   glTexGeni(GL_S,GL_TEXTURE_GEN_MODE,GL_EYE_LINEAR);
+   glTexGeni(GL_T,GL_TEXTURE_GEN_MODE,GL_EYE_LINEAR);
+   glTexGeni(GL_R,GL_TEXTURE_GEN_MODE,GL_EYE_LINEAR);
+   glTexGeni(GL_Q,GL_TEXTURE_GEN_MODE,GL_EYE_LINEAR);
+   glTexGenfv(GL_S,GL_EYE_PLANE,planeS);
+   glTexGenfv(GL_T,GL_EYE_PLANE,planeT);
+   glTexGenfv(GL_R,GL_EYE_PLANE,planeR);
+   glTexGenfv(GL_Q,GL_EYE_PLANE,planeQ);
+   glPopMatrix();
+
+   glEnable(GL_TEXTURE_GEN_S);
+   glEnable(GL_TEXTURE_GEN_T);
+   glEnable(GL_TEXTURE_GEN_R);
+   glEnable(GL_TEXTURE_GEN_Q);
+
+   // only unsaturated pixels pass
+   glAlphaFunc(GL_LESS,OCCTHRES);
+   glEnable(GL_ALPHA_TEST);
+
+   glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+   glDepthMask(GL_FALSE);
+
+   glDisable(GL_CULL_FACE);
+
+   for (i=0; i<count; i++)
+      if (OCCISSUED[slot+i])
+         {
+         glBeginQueryARB(GL_SAMPLES_PASSED_ARB,OCCQUERY[slot+i]);
+         drawbox(ORDER[first+i]);
+         glEndQueryARB(GL_SAMPLES_PASSED_ARB);
+         }
+
+   glEnable(GL_CULL_FACE);
+
+   glDepthMask(GL_TRUE);
+   glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+
+   glDisable(GL_TEXTURE_GEN_S);
+   glDisable(GL_TEXTURE_GEN_T);
+   glDisable(GL_TEXTURE_GEN_R);
+   glDisable(GL_TEXTURE_GEN_Q);
+
+   glMatrixMode(GL_TEXTURE);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+
+   glBindTexture(GL_TEXTURE_2D,0);
+   glDisable(GL_TEXTURE_2D);
+
+   // restore alpha test for pre-multiplied tfs
+   if (get_tfunc()->get_premult()) glAlphaFunc(GL_GREATER,0.0);
+   else glDisable(GL_ALPHA_TEST);
+
+#endif
+   }
+
+// keep the query results of the issued slots for the next frame and free the slots
+// a tile whose result is still not available is rendered in the next frame
+void volume::retire(int slot,int count)
+   {
+   int i;
+
+   GLuint available,samples;
+
+   for (i=0; i<count; i++)
+      if (OCCISSUED[slot+i])
+         {
+         available=0;
+         samples=1;
+
+#ifdef GL_ARB_occlusion_query
+         glGetQueryObjectuivARB(OCCQUERY[slot+i],GL_QUERY_RESULT_AVAILABLE_ARB,&available);
+         if (available) glGetQueryObjectuivARB(OCCQUERY[slot+i],GL_QUERY_RESULT_ARB,&samples);
+#endif
+
+         OCCTILE[slot+i]->set_occluded(samples==0);
+         OCCISSUED[slot+i]=FALSE;
+         }
+   }
+
+// check whether or not a queried tile is hidden behind saturated pixels
+// a tile keeps the result of the last frame if its query result is not available yet
+BOOLINT volume::is_occluded(int i)
+   {
+   GLuint available=0,samples=1;
+
+   if (!OCCISSUED[i%(2*OCCBATCH)]) return(FALSE);
+
+#ifdef GL_ARB_occlusion_query
+   glGetQueryObjectuivARB(OCCQUERY[i%(2*OCCBATCH)],GL_QUERY_RESULT_AVAILABLE_ARB,&available);
+   if (available) glGetQueryObjectuivARB(OCCQUERY[i%(2*OCCBATCH)],GL_QUERY_RESULT_ARB,&samples);
+#endif
+
+   if (available) ORDER[i]->set_occluded(samples==0);
+
+   return(ORDER[i]->was_occluded());
    }
 
 // render the volume
@@ -242,10 +743,57 @@ BOOLINT volume::render(float ex,float ey,float ez,
                        float ux,float uy,float uz,
                        float nearp,float slab,float rslab,
                        BOOLINT lighting,
+                       BOOLINT front2back,
                        BOOLINT (*abort)(void *abortdata),
                        void *abortdata)
    {
-   BOOLINT aborted;
+   int i,j;
+
+   tileptr t;
+
+   BOOLINT aborted=FALSE;
+
+   volumeslicing slicing;
+
+   if (ORDERMAX<TILECNT)
+      {
+      if (ORDER!=NULL) delete[] ORDER;
+      ORDER=new tileptr[TILECNT];
+      ORDERMAX=TILECNT;
+      }
+
+   // sort tiles back-to-front
+   ORDERCNT=0;
+   sort(0,0,0,TILEX,TILEY,TILEZ,ex,ey,ez);
+
+   // reverse the order for front-to-back compositing
+   if (front2back)
+      for (i=0,j=ORDERCNT-1; i<j; i++,j--)
+         {
+         t=ORDER[i];
+         ORDER[i]=ORDER[j];
+         ORDER[j]=t;
+         }
+
+   slicing.order=ORDER;
+
+   slicing.ex=ex; slicing.ey=ey; slicing.ez=ez;
+   slicing.dx=dx; slicing.dy=dy; slicing.dz=dz;
+   slicing.ux=ux; slicing.uy=uy; slicing.uz=uz;
+
+   slicing.nearp=nearp;
+   slicing.slab=slab;
+
+   slicing.front2back=front2back;
+
+   // compile ray casting shaders before slicing
+   tile::setupray();
+
+   // slice the sorted tiles in parallel
+   parallelfor(ORDERCNT,volumeslice,&slicing);
+
+   // upload the slices of all tiles at once
+   upload();
 
    // enable alpha test for pre-multiplied tfs
    if (get_tfunc()->get_premult())
@@ -254,17 +802,146 @@ BOOLINT volume::render(float ex,float ey,float ez,
       glEnable(GL_ALPHA_TEST);
       }
 
-   // render tiles in back-to-front sorted order
-   aborted=sort(0,0,0,TILEX,TILEY,TILEZ,
-                ex,ey,ez,dx,dy,dz,ux,uy,uz,
-                nearp,slab,rslab,
-                lighting,
-                abort,abortdata);
+   // keep the query results of the last frame
+   retire(0,2*OCCBATCH);
+
+   // query the first batch before drawing
+   if (front2back && HASOCC)
+      occlude(0,(ORDERCNT<OCCBATCH)?ORDERCNT:OCCBATCH,
+              ex,ey,ez,dx,dy,dz,nearp);
+
+   // render tiles in sorted order
+   for (i=0; i<ORDERCNT && !aborted; i++)
+      {
+      // skip tiles whose footprint is already saturated
+      // the queries run one batch ahead so that the results are ready when needed
+      if (front2back && HASOCC)
+         {
+         if (i%OCCBATCH==0 && i+OCCBATCH<ORDERCNT)
+            occlude(i+OCCBATCH,(ORDERCNT-i-OCCBATCH<OCCBATCH)?ORDERCNT-i-OCCBATCH:OCCBATCH,
+                    ex,ey,ez,dx,dy,dz,nearp);
+
+         if (is_occluded(i)) continue;
+
+         // rays start with the opacity copied within the footprint of a queried tile
+         if (OCCISSUED[i%(2*OCCBATCH)]) tile::setRAYoccluder(OCCTEX,OCCX,OCCY,OCCWIDTH,OCCHEIGHT);
+         else tile::setRAYoccluder();
+         }
+
+      ORDER[i]->render(ex,ey,ez,
+                       dx,dy,dz,
+                       ux,uy,uz,
+                       nearp,slab,rslab,
+                       lighting,
+                       !front2back,front2back);
+
+      if (abort!=NULL) aborted=abort(abortdata);
+      }
+
+   tile::setRAYoccluder();
 
    // disable alpha test for pre-multiplied tfs
    if (get_tfunc()->get_premult())
       glDisable(GL_ALPHA_TEST);
 
+#ifdef GL_ARB_vertex_buffer_object
+   if (VBO!=0) glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+#endif
+
+   return(aborted);
+   }
+
+// render the volume as an order-independent intensity projection
+BOOLINT volume::project(float ex,float ey,float ez,
+                        float dx,float dy,float dz,
+                        float ux,float uy,float uz,
+                        float nearp,float slab,
+                        int projmode,
+                        BOOLINT (*abort)(void *abortdata),
+                        void *abortdata)
+   {
+   int i;
+
+   BOOLINT aborted=FALSE;
+
+   volumeslicing slicing;
+
+   float l,weight;
+
+   if (ORDERMAX<TILECNT)
+      {
+      if (ORDER!=NULL) delete[] ORDER;
+      ORDER=new tileptr[TILECNT];
+      ORDERMAX=TILECNT;
+      }
+
+   // the blending is order-independent so the tiles need not be sorted
+   // tiles whose maximum lies below the tf window cannot contribute
+   for (i=ORDERCNT=0; i<TILECNT; i++)
+      if (!TILE[i]->is_empty()) ORDER[ORDERCNT++]=TILE[i];
+
+   slicing.order=ORDER;
+
+   slicing.ex=ex; slicing.ey=ey; slicing.ez=ez;
+   slicing.dx=dx; slicing.dy=dy; slicing.dz=dz;
+   slicing.ux=ux; slicing.uy=uy; slicing.uz=uz;
+
+   slicing.nearp=nearp;
+   slicing.slab=slab;
+
+   slicing.front2back=FALSE;
+
+   // slice the visible tiles in parallel
+   parallelfor(ORDERCNT,volumeslice,&slicing);
+
+   // upload the slices of all tiles at once
+   upload();
+
+   // the average is taken over the depth of the bounding box
+   l=fsqrt(dx*dx+dy*dy+dz*dz);
+   weight=slab*l/(fabs(dx)*BX+fabs(dy)*BY+fabs(dz)*BZ);
+
+#ifdef GL_EXT_blend_minmax
+
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_ONE,GL_ONE);
+
+   glDisable(GL_CULL_FACE);
+   glDepthMask(GL_FALSE);
+
+   // reset the pixels covered by the volume to the neutral element of the projection
+   glBlendEquationEXT((projmode==PROJ_MINIP)?GL_MAX_EXT:GL_MIN_EXT);
+
+   for (i=0; i<ORDERCNT; i++)
+      if (projmode==PROJ_MINIP) ORDER[i]->project(0.0f,1.0f,1.0f);
+      else ORDER[i]->project(0.0f,0.0f,0.0f);
+
+   // accumulate the projection
+   if (projmode==PROJ_MIP) glBlendEquationEXT(GL_MAX_EXT);
+   else if (projmode==PROJ_MINIP) glBlendEquationEXT(GL_MIN_EXT);
+   else glBlendEquationEXT(GL_FUNC_ADD_EXT);
+
+   for (i=0; i<ORDERCNT && !aborted; i++)
+      {
+      if (projmode==PROJ_AVERAGE) ORDER[i]->project(weight,0.0f,weight);
+      else ORDER[i]->project(1.0f,0.0f,1.0f);
+
+      if (abort!=NULL) aborted=abort(abortdata);
+      }
+
+   glBlendEquationEXT(GL_FUNC_ADD_EXT);
+
+   glDepthMask(GL_TRUE);
+   glEnable(GL_CULL_FACE);
+
+   glDisable(GL_BLEND);
+
+#endif
+
+#ifdef GL_ARB_vertex_buffer_object
+   if (VBO!=0) glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+#endif
+
    return(aborted);
    }
 
@@ -379,159 +1056,638 @@ mipmap::mipmap(char *base,int res)
    set_vol_maxsize(512);
    set_iso_maxsize(256);
 
+   vol_maxload_=16;
+   vol_occlusion_=FALSE;
+   vol_raycast_=FALSE;
+   vol_level_=0;
+   vol_fps_=0.0f;
+   vol_scale_=1.0f;
+   vol_mode_=PROJ_NONE;
+
+   vol_cpu_=NULL;
+   vol_cpu_thres_=0.95f;
+
+   MPRENGINE=NULL;
+
    CACHE=NULL;
 
-   CSIZEX=0;
-   CSIZEY=0;
-   CSLICE=0;
-   CSLICES=0;
+   CSIZEX=0;
+   CSIZEY=0;
+   CSLICE=0;
+   CSLICES=0;
+
+   QUEUEMAX=QUEUEINC;
+
+   QUEUEX=new int[QUEUEMAX];
+   QUEUEY=new int[QUEUEMAX];
+   QUEUEZ=new int[QUEUEMAX];
+
+   disable_clip();
+
+   SHADERID1=0;
+   SHADERID2=0;
+   SHADERID3=0;
+
+   SFXMODE=0;
+
+   HASFBO=FALSE;
+   fboWidth=fboHeight=0;
+   textureId=rboId=fboId=0;
+   geoTextureId=0;
+   targetFboId=0;
+
+   HASLOW=FALSE;
+   lowWidth=lowHeight=0;
+   lowTextureId=lowDepthId=lowFboId=0;
+   depthTextureId=0;
+
+   LOWLOADED=FALSE;
+   DOWNSHADER=UPSHADER=0;
+
+   ADAPTOVER=1.0f;
+   ADAPTLEVEL=0;
+   ADAPTCOUNT=0;
+
+   ADAPTSTART=ADAPTCPU=ADAPTGPU=0.0;
+
+   HASTIMER=FALSE;
+
+   for (int i=0; i<ADAPTQUERIES; i++)
+      {
+      ADAPTQUERY[i]=0;
+      ADAPTISSUED[i]=FALSE;
+      }
+
+   ADAPTNEXT=0;
+   ADAPTACTIVE=FALSE;
+   }
+
+mipmap::~mipmap()
+   {
+   int i;
+
+   for (i=0; i<VOLCNT; i++) delete VOL[i];
+   if (VOLCNT>0) delete VOL;
+
+   if (vol_cpu_!=NULL) delete vol_cpu_;
+
+   if (MPRENGINE!=NULL) delete MPRENGINE;
+
+   delete TFUNC;
+   delete HISTO;
+
+   if (VOLUME!=NULL) free(VOLUME);
+   if (GRAD!=NULL) free(GRAD);
+
+   if (CACHE!=NULL) delete CACHE;
+
+   delete QUEUEX;
+   delete QUEUEY;
+   delete QUEUEZ;
+
+   if (SHADERID1!=0) deletefrgprog(SHADERID1);
+   if (SHADERID2!=0) deletefrgprog(SHADERID2);
+   if (SHADERID3!=0) deletefrgprog(SHADERID3);
+
+   destroy();
+   destroylow();
+
+   if (DOWNSHADER!=0) deleteglslprog(DOWNSHADER);
+   if (UPSHADER!=0) deleteglslprog(UPSHADER);
+
+#ifdef GL_EXT_timer_query
+   if (ADAPTQUERY[0]!=0) glDeleteQueriesARB(ADAPTQUERIES,ADAPTQUERY);
+#endif
+   }
+
+// create fbo
+void mipmap::setup(int width,int height)
+   {
+   char *GL_EXTs;
+
+   if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+
+   if (strstr(GL_EXTs,"EXT_framebuffer_object")!=NULL)
+      if (width>0 && height>0)
+         if (!HASFBO || width!=fboWidth || height!=fboHeight)
+            {
+#ifdef GL_EXT_framebuffer_object
+
+            destroy();
+
+            HASFBO=TRUE;
+
+            // save actual size
+            fboWidth=width;
+            fboHeight=height;
+
+            // create a texture object
+            glGenTextures(1, &textureId);
+            glBindTexture(GL_TEXTURE_2D, textureId);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#ifdef FBOMM
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+#else
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#endif
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#ifdef FBOMM
+            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE); // automatic mipmap
+#else
+            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE); // automatic mipmap off
+#endif
+#ifdef FBO16
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F_ARB, width, height, 0, GL_RGBA, GL_HALF_FLOAT_ARB, 0);
+#else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+#endif
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // create a texture object to hold the opaque geometry
+            glGenTextures(1, &geoTextureId);
+            glBindTexture(GL_TEXTURE_2D, geoTextureId);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#ifdef FBO16
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F_ARB, width, height, 0, GL_RGBA, GL_HALF_FLOAT_ARB, 0);
+#else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+#endif
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // create a renderbuffer object to store depth info
+            glGenRenderbuffersEXT(1, &rboId);
+            glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rboId);
+            glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT, width, height);
+            glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
+
+            // create a framebuffer object
+            glGenFramebuffersEXT(1, &fboId);
+            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fboId);
+
+            // attach the texture to fbo color attachment point
+            glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, textureId, 0);
+
+            // attach the renderbuffer to depth attachment point
+            glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, rboId);
+
+            // get fbo status
+            GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+
+            // switch back to the target framebuffer
+            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
+
+            // check fbo status
+            if (status != GL_FRAMEBUFFER_COMPLETE_EXT) destroy();
+
+#endif
+            }
+   }
+
+// destroy fbo
+void mipmap::destroy()
+   {
+#ifdef GL_EXT_framebuffer_object
+
+   if (textureId!=0) glDeleteTextures(1, &textureId);
+   if (rboId!=0) glDeleteRenderbuffersEXT(1, &rboId);
+   if (fboId!=0) glDeleteFramebuffersEXT(1, &fboId);
+   if (geoTextureId!=0) glDeleteTextures(1, &geoTextureId);
+
+   textureId=0;
+   rboId=0;
+   fboId=0;
+   geoTextureId=0;
+
+   HASFBO=FALSE;
+   fboWidth=fboHeight=0;
+
+#endif
+   }
+
+// measure the last frames and adapt the sampling to the target frame rate
+void mipmap::beginadapt()
+   {
+   char *GL_EXTs;
+
+   int i;
+
+   double frame;
+   float ratio;
+
+   // the adapted sampling is kept but the measurements become stale
+   if (vol_fps_<=0.0f)
+      {
+      ADAPTCOUNT=0;
+
+      ADAPTCPU=ADAPTGPU=0.0;
+      for (i=0; i<ADAPTQUERIES; i++) ADAPTISSUED[i]=FALSE;
+
+      return;
+      }
+
+#ifdef GL_EXT_timer_query
+
+   // check for gpu timer queries
+   if (ADAPTQUERY[0]==0)
+      {
+      if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+
+      if (strstr(GL_EXTs,"timer_query")!=NULL) HASTIMER=TRUE;
+
+#ifdef WINOS
+      if (glGenQueriesARB==NULL) HASTIMER=FALSE;
+#endif
+
+      if (HASTIMER) glGenQueriesARB(ADAPTQUERIES,ADAPTQUERY);
+      }
+
+   // poll the queries in flight from the oldest to the latest
+   // a result that is not available yet is picked up in a later frame
+   for (i=0; i<ADAPTQUERIES; i++)
+      {
+      int q=(ADAPTNEXT+i)%ADAPTQUERIES;
+
+      if (ADAPTISSUED[q])
+         {
+         GLuint available,elapsed;
+
+         glGetQueryObjectuivARB(ADAPTQUERY[q],GL_QUERY_RESULT_AVAILABLE_ARB,&available);
+         if (!available) continue;
+
+         glGetQueryObjectuivARB(ADAPTQUERY[q],GL_QUERY_RESULT_ARB,&elapsed);
+         ADAPTGPU=1.0E-9*elapsed;
+
+         ADAPTISSUED[q]=FALSE;
+         }
+      }
+
+#endif
+
+   // the frame time is the maximum of the cpu time and the latest gpu time
+   frame=fmax(ADAPTCPU,ADAPTGPU);
+
+   if (frame>0.0)
+      {
+      ratio=frame*vol_fps_;
+
+      // coarsen immediately if the frame is too slow
+      if (ratio>ADAPTHIGH)
+         {
+         ADAPTCOUNT=0;
+
+         if (ADAPTOVER<ADAPTMAX)
+            {
+            ADAPTOVER*=fmin(fsqrt(ratio),ADAPTSTEP);
+            if (ADAPTOVER>ADAPTMAX) ADAPTOVER=ADAPTMAX;
+            }
+         else if (ADAPTLEVEL<VOLCNT-1) ADAPTLEVEL++;
+         }
+      // refine only after a series of fast frames to avoid flicker
+      else if (ratio<ADAPTLOW)
+         {
+         if (++ADAPTCOUNT>=ADAPTFRAMES)
+            {
+            ADAPTCOUNT=0;
+
+            if (ADAPTLEVEL>0) ADAPTLEVEL--;
+            else if (ADAPTOVER>1.0f)
+               {
+               ADAPTOVER*=fmax(fsqrt(ratio),1.0f/ADAPTSTEP);
+               if (ADAPTOVER<1.0f) ADAPTOVER=1.0f;
+               }
+            }
+         }
+      else ADAPTCOUNT=0;
+      }
+
+#ifdef GL_EXT_timer_query
+
+   // measure this frame unless all queries are still in flight
+   ADAPTACTIVE=FALSE;
+
+   if (HASTIMER)
+      if (!ADAPTISSUED[ADAPTNEXT])
+         {
+         glBeginQueryARB(GL_TIME_ELAPSED_EXT,ADAPTQUERY[ADAPTNEXT]);
+         ADAPTISSUED[ADAPTNEXT]=TRUE;
+         ADAPTACTIVE=TRUE;
+         }
+
+#endif
+
+   ADAPTSTART=gettime();
+   }
+
+// finish the frame time measurement
+void mipmap::endadapt()
+   {
+   if (vol_fps_<=0.0f) return;
+
+#ifdef GL_EXT_timer_query
 
-   QUEUEMAX=QUEUEINC;
+   if (ADAPTACTIVE)
+      {
+      glEndQueryARB(GL_TIME_ELAPSED_EXT);
+      ADAPTNEXT=(ADAPTNEXT+1)%ADAPTQUERIES;
 
-   QUEUEX=new int[QUEUEMAX];
-   QUEUEY=new int[QUEUEMAX];
-   QUEUEZ=new int[QUEUEMAX];
+      ADAPTACTIVE=FALSE;
+      }
 
-   disable_clip();
+#endif
 
-   SHADERID1=0;
-   SHADERID2=0;
-   SHADERID3=0;
+   ADAPTCPU=gettime()-ADAPTSTART;
+   }
 
-   SFXMODE=0;
+// move the opaque geometry out of the fbo
+void mipmap::beginunder()
+   {
+   glBindTexture(GL_TEXTURE_2D, geoTextureId);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, fboWidth, fboHeight);
+   glBindTexture(GL_TEXTURE_2D, 0);
 
-   HASFBO=FALSE;
-   fboWidth=fboHeight=0;
-   textureId=rboId=fboId=0;
+   glClearColor(0,0,0,0);
+   glClear(GL_COLOR_BUFFER_BIT);
    }
 
-mipmap::~mipmap()
+// composite the opaque geometry underneath the front-to-back composited volume
+void mipmap::endunder()
    {
-   int i;
+   glBindTexture(GL_TEXTURE_2D, geoTextureId);
+   glEnable(GL_TEXTURE_2D);
 
-   for (i=0; i<VOLCNT; i++) delete VOL[i];
-   if (VOLCNT>0) delete VOL;
+   glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
 
-   delete TFUNC;
-   delete HISTO;
+   glBlendFunc(GL_ONE_MINUS_DST_ALPHA,GL_ONE);
+   glEnable(GL_BLEND);
 
-   if (VOLUME!=NULL) free(VOLUME);
-   if (GRAD!=NULL) free(GRAD);
+   glDisable(GL_DEPTH_TEST);
 
-   if (CACHE!=NULL) delete CACHE;
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   gluOrtho2D(-1.0f,1.0f,-1.0f,1.0f);
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glBegin(GL_QUADS);
+   glColor3f(1.0f,1.0f,1.0f);
+   glTexCoord2f(0.0f,0.0f);
+   glVertex2f(-1.0f,-1.0f);
+   glTexCoord2f(1.0f,0.0f);
+   glVertex2f(1.0f,-1.0f);
+   glTexCoord2f(1.0f,1.0f);
+   glVertex2f(1.0f,1.0f);
+   glTexCoord2f(0.0f,1.0f);
+   glVertex2f(-1.0f,1.0f);
+   glEnd();
 
-   delete QUEUEX;
-   delete QUEUEY;
-   delete QUEUEZ;
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
 
-   if (SHADERID1!=0) deletefrgprog(SHADERID1);
-   if (SHADERID2!=0) deletefrgprog(SHADERID2);
-   if (SHADERID3!=0) deletefrgprog(SHADERID3);
+   glEnable(GL_DEPTH_TEST);
 
-   destroy();
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glDisable(GL_TEXTURE_2D);
+
+   glDisable(GL_BLEND);
    }
 
-// create fbo
-void mipmap::setup(int width,int height)
+// update 16-bit fbo
+void mipmap::updatefbo()
    {
-   char *GL_EXTs;
+   GLint viewport[4];
+   glGetIntegerv(GL_VIEWPORT,viewport);
+   int width=viewport[2];
+   int height=viewport[3];
 
-   if ((GL_EXTs=(char *)glGetString(GL_EXTENSIONS))==NULL) ERRORMSG();
+   setup(width,height);
+   }
 
-   if (strstr(GL_EXTs,"EXT_framebuffer_object")!=NULL)
-      if (width>0 && height>0)
-         if (!HASFBO || width!=fboWidth || height!=fboHeight)
+// create reduced resolution fbo
+BOOLINT mipmap::setuplow()
+   {
+   int width,height;
+
+   // build upsampling shaders
+   if (!LOWLOADED)
+      {
+      LOWLOADED=TRUE;
+
+      if ((DOWNSHADER=buildglslprog(screen_vtxprg,downsample_frgprg))!=0)
+         if ((UPSHADER=buildglslprog(screen_vtxprg,upsample_frgprg))==0)
             {
+            deleteglslprog(DOWNSHADER);
+            DOWNSHADER=0;
+            }
+      }
+
+   if (DOWNSHADER==0 || UPSHADER==0) return(FALSE);
+
+   width=(int)(vol_scale_*fboWidth+0.5f);
+   height=(int)(vol_scale_*fboHeight+0.5f);
+
+   if (width<1) width=1;
+   if (height<1) height=1;
+
+   if (!HASLOW || width!=lowWidth || height!=lowHeight)
+      {
 #ifdef GL_EXT_framebuffer_object
 
-            destroy();
+      destroylow();
 
-            HASFBO=TRUE;
+      HASLOW=TRUE;
 
-            // save actual size
-            fboWidth=width;
-            fboHeight=height;
+      // save reduced size
+      lowWidth=width;
+      lowHeight=height;
 
-            // create a texture object
-            glGenTextures(1, &textureId);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#ifdef FBOMM
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-#else
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-#endif
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-#ifdef FBOMM
-            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE); // automatic mipmap
-#else
-            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE); // automatic mipmap off
-#endif
+      // create a texture object
+      glGenTextures(1, &lowTextureId);
+      glBindTexture(GL_TEXTURE_2D, lowTextureId);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 #ifdef FBO16
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F_ARB, width, height, 0, GL_RGBA, GL_HALF_FLOAT_ARB, 0);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F_ARB, width, height, 0, GL_RGBA, GL_HALF_FLOAT_ARB, 0);
 #else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 #endif
-            glBindTexture(GL_TEXTURE_2D, 0);
 
-            // create a renderbuffer object to store depth info
-            glGenRenderbuffersEXT(1, &rboId);
-            glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rboId);
-            glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT, width, height);
-            glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
+      // create a depth texture object
+      glGenTextures(1, &lowDepthId);
+      glBindTexture(GL_TEXTURE_2D, lowDepthId);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
 
-            // create a framebuffer object
-            glGenFramebuffersEXT(1, &fboId);
-            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fboId);
+      // create a depth texture object to hold the native depth
+      glGenTextures(1, &depthTextureId);
+      glBindTexture(GL_TEXTURE_2D, depthTextureId);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, fboWidth, fboHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
 
-            // attach the texture to fbo color attachment point
-            glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, textureId, 0);
+      glBindTexture(GL_TEXTURE_2D, 0);
 
-            // attach the renderbuffer to depth attachment point
-            glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, rboId);
+      // create a framebuffer object
+      glGenFramebuffersEXT(1, &lowFboId);
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, lowFboId);
 
-            // get fbo status
-            GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+      // attach the textures to the color and depth attachment points
+      glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, lowTextureId, 0);
+      glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_TEXTURE_2D, lowDepthId, 0);
 
-            // switch back to window-system-provided framebuffer
-            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+      // get fbo status
+      GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
 
-            // check fbo status
-            if (status != GL_FRAMEBUFFER_COMPLETE_EXT) destroy();
+      // switch back to the target framebuffer
+      glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
+
+      // check fbo status
+      if (status != GL_FRAMEBUFFER_COMPLETE_EXT) destroylow();
 
 #endif
-            }
+      }
+
+   return(HASLOW);
    }
 
-// destroy fbo
-void mipmap::destroy()
+// destroy reduced resolution fbo
+void mipmap::destroylow()
    {
 #ifdef GL_EXT_framebuffer_object
 
-   if (textureId!=0) glDeleteTextures(1, &textureId);
-   if (rboId!=0) glDeleteRenderbuffersEXT(1, &rboId);
-   if (fboId!=0) glDeleteFramebuffersEXT(1, &fboId);
+   if (lowTextureId!=0) glDeleteTextures(1, &lowTextureId);
+   if (lowDepthId!=0) glDeleteTextures(1, &lowDepthId);
+   if (lowFboId!=0) glDeleteFramebuffersEXT(1, &lowFboId);
+   if (depthTextureId!=0) glDeleteTextures(1, &depthTextureId);
 
-   textureId=0;
-   rboId=0;
-   fboId=0;
+   lowTextureId=0;
+   lowDepthId=0;
+   lowFboId=0;
+   depthTextureId=0;
 
-   HASFBO=FALSE;
-   fboWidth=fboHeight=0;
+   HASLOW=FALSE;
+   lowWidth=lowHeight=0;
 
 #endif
    }
 
-// update 16-bit fbo
-void mipmap::updatefbo()
+// draw a screen-filling quad
+static void drawscreen()
    {
-   GLint viewport[4];
-   glGetIntegerv(GL_VIEWPORT,viewport);
-   int width=viewport[2];
-   int height=viewport[3];
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   gluOrtho2D(-1.0f,1.0f,-1.0f,1.0f);
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   glBegin(GL_QUADS);
+   glColor3f(1.0f,1.0f,1.0f);
+   glTexCoord2f(0.0f,0.0f);
+   glVertex2f(-1.0f,-1.0f);
+   glTexCoord2f(1.0f,0.0f);
+   glVertex2f(1.0f,-1.0f);
+   glTexCoord2f(1.0f,1.0f);
+   glVertex2f(1.0f,1.0f);
+   glTexCoord2f(0.0f,1.0f);
+   glVertex2f(-1.0f,1.0f);
+   glEnd();
 
-   setup(width,height);
+   glPopMatrix();
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+   }
+
+// redirect the volume into the reduced resolution fbo
+void mipmap::beginlow()
+   {
+   // copy the native depth of the opaque geometry
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
+
+   glBindTexture(GL_TEXTURE_2D, depthTextureId);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, fboWidth, fboHeight);
+
+   // render to reduced fbo
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, lowFboId);
+   glViewport(0, 0, lowWidth, lowHeight);
+
+   glClearColor(0,0,0,0);
+   glClear(GL_COLOR_BUFFER_BIT);
+
+   // downsample the native depth
+   bindglslprog(DOWNSHADER);
+   setglslprogtex(DOWNSHADER,"depth",0);
+
+   glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+   glDepthFunc(GL_ALWAYS);
+
+   drawscreen();
+
+   glDepthFunc(GL_LEQUAL);
+   glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+
+   bindglslprog(0);
+
+   glBindTexture(GL_TEXTURE_2D, 0);
+   }
+
+// upsample the reduced volume with a depth-aware filter
+void mipmap::endlow()
+   {
+   // switch back to the target framebuffer
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
+   glViewport(0, 0, fboWidth, fboHeight);
+
+   bindglslprog(UPSHADER);
+   setglslprogtex(UPSHADER,"col",0);
+   setglslprogtex(UPSHADER,"lowdepth",1);
+   setglslprogtex(UPSHADER,"depth",2);
+   setglslprogpar(UPSHADER,"size",lowWidth,lowHeight,1.0f/lowWidth,1.0f/lowHeight);
+
+   glActiveTextureARB(GL_TEXTURE2_ARB);
+   glBindTexture(GL_TEXTURE_2D, depthTextureId);
+   glActiveTextureARB(GL_TEXTURE1_ARB);
+   glBindTexture(GL_TEXTURE_2D, lowDepthId);
+   glActiveTextureARB(GL_TEXTURE0_ARB);
+   glBindTexture(GL_TEXTURE_2D, lowTextureId);
+
+   glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+   glEnable(GL_BLEND);
+
+   glDepthMask(GL_FALSE);
+   glDisable(GL_DEPTH_TEST);
+
+   drawscreen();
+
+   glEnable(GL_DEPTH_TEST);
+   glDepthMask(GL_TRUE);
+
+   glDisable(GL_BLEND);
+
+   glActiveTextureARB(GL_TEXTURE2_ARB);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glActiveTextureARB(GL_TEXTURE1_ARB);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glActiveTextureARB(GL_TEXTURE0_ARB);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   bindglslprog(0);
    }
 
 // reduce a volume to half its size
@@ -611,6 +1767,19 @@ void mipmap::set_data(unsigned char *data,
                     bricksize,overmax,
                     feedback,obj);
 
+   // keep the volume data in host memory for cpu ray casting
+   if (vol_cpu_!=NULL)
+      {
+      vol_cpu_->clear();
+
+      vol_cpu_->set_level(0,data,
+                          width,height,depth,
+                          mx,my,mz,
+                          sx,sy,sz,
+                          (int)fceil(overmax),
+                          data!=VOLUME);
+      }
+
    for (i=1; i<VOLCNT; i++)
       {
       if (feedback!=NULL) feedback("calculating mipmap",(float)(i+1)/VOLCNT,obj);
@@ -634,6 +1803,13 @@ void mipmap::set_data(unsigned char *data,
                        sx,sy,sz,
                        bricksize,overmax);
 
+      if (vol_cpu_!=NULL)
+         vol_cpu_->set_level(i,data2,
+                             width,height,depth,
+                             mx,my,mz,
+                             sx,sy,sz,
+                             (int)fceil(overmax));
+
       if (i>1)
          {
          free(data);
@@ -2913,6 +4089,8 @@ BOOLINT mipmap::loadvolume(const char *filename, // filename of PVM to load
       {
       if (feedback!=NULL) feedback("loading data",0,obj);
 
+      HISTO->stop();
+
       if (VOLUME!=NULL) free(VOLUME);
       if ((VOLUME=readANYvolume(filename,&WIDTH,&HEIGHT,&DEPTH,&COMPONENTS,&DSX,&DSY,&DSZ,&msb,feedback,obj))==NULL)
          {
@@ -2991,6 +4169,8 @@ BOOLINT mipmap::loadvolume(const char *filename, // filename of PVM to load
          {
          if (feedback!=NULL) feedback("loading gradients",0,obj);
 
+         HISTO->stop();
+
          if (GRAD!=NULL) free(GRAD);
          if ((GRAD=readANYvolume(gradname,&GWIDTH,&GHEIGHT,&GDEPTH,&GCOMPONENTS,&GDSX,&GDSY,&GDSZ,&msb))==NULL) exit(1);
          GRADMAX=1.0f;
@@ -3068,6 +4248,8 @@ BOOLINT mipmap::loadseries(const std::vector<std::string> list, // DICOM series
 
    if (feedback!=NULL) feedback("loading data",0,obj);
 
+   HISTO->stop();
+
    if (VOLUME!=NULL) free(VOLUME);
    if ((VOLUME=readDICOMvolume(list,&WIDTH,&HEIGHT,&DEPTH,&COMPONENTS,&DSX,&DSY,&DSZ,feedback,obj))==NULL)
       {
@@ -3366,6 +4548,76 @@ void mipmap::set_iso_maxsize(long long maxsize,
       }
    }
 
+// set graphics memory budget for out-of-core rendering
+void mipmap::set_vol_budget(long long budget,
+                            int maxload)
+   {
+   brick::set_budget(budget*1024*1024);
+   vol_maxload_=maxload;
+   }
+
+// enable packing of bricks into texture atlases
+void mipmap::set_vol_atlas(BOOLINT on)
+   {volume::setATLASmode(on);}
+
+// enable single-pass ray casting
+void mipmap::set_vol_raycast(BOOLINT on,float thres)
+   {
+   volume::setRAYmode(on,thres);
+   vol_raycast_=on;
+   }
+
+// enable front-to-back compositing with occlusion culling
+void mipmap::set_vol_occlusion(BOOLINT on)
+   {vol_occlusion_=on;}
+
+// enable adaptive sampling to hold a target frame rate
+void mipmap::set_vol_fps(float fps)
+   {
+   if (fps<0.0f) fps=0.0f;
+   vol_fps_=fps;
+   }
+
+// render the volume with reduced resolution
+void mipmap::set_vol_scale(float scale)
+   {
+   if (scale<0.1f) scale=0.1f;
+   else if (scale>1.0f) scale=1.0f;
+
+   vol_scale_=scale;
+   }
+
+// render the volume as intensity projection
+void mipmap::set_vol_mode(int mode)
+   {
+   if (mode<PROJ_NONE || mode>PROJ_AVERAGE) ERRORMSG();
+   vol_mode_=mode;
+   }
+
+// enable cpu ray casting
+void mipmap::set_vol_cpu(BOOLINT on,float thres)
+   {
+   if (on)
+      {
+      if (vol_cpu_==NULL) vol_cpu_=new raycaster(TFUNC);
+      }
+   else
+      if (vol_cpu_!=NULL)
+         {
+         delete vol_cpu_;
+         vol_cpu_=NULL;
+         }
+
+   vol_cpu_thres_=thres;
+   }
+
+// set the finest pyramid level used for rendering
+void mipmap::set_vol_level(int level)
+   {
+   if (level<0) level=0;
+   vol_level_=level;
+   }
+
 // render the volume
 BOOLINT mipmap::render(float ex,float ey,float ez,
                        float dx,float dy,float dz,
@@ -3382,9 +4634,17 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
    BOOLINT aborted=FALSE;
 
    int map=0;
+   int fallback,load;
 
    int plane;
 
+   BOOLINT front2back=FALSE;
+
+   BOOLINT reduced=FALSE;
+
+   BOOLINT cpu=FALSE;
+   double clipequ[4*(MAX_CLIP_PLANES+1)];
+
    // save eye point
    ex_=ex;
    ey_=ey;
@@ -3410,11 +4670,34 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
    ny_=dy;
    nz_=dz;
 
+   // adopt the exact histograms once they have been refined in the background
+   HISTO->update();
+
+#ifdef GL_EXT_framebuffer_object
+   // render into the framebuffer bound by the caller
+   GLint binding=0;
+   glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&binding);
+   targetFboId=binding;
+#endif
+
+   // adapt sampling to the target frame rate
+   beginadapt();
+   if (vol_fps_>0.0f) slab*=ADAPTOVER;
+
    // update fbo
    if (usefbo && has_data()) updatefbo();
 
+   // cast rays on the cpu
+   if (vol_cpu_!=NULL && SFXMODE==0 && vol_mode_==PROJ_NONE)
+      if (vol_cpu_->get_levels()==VOLCNT && vol_cpu_->check()) cpu=TRUE;
+
+   // render the volume into the reduced fbo and the geometry natively
+   if (HASFBO && usefbo && vol_scale_<1.0f && SFXMODE==0 && !cpu)
+      if (get_tfunc()->checkRGBA())
+         reduced=setuplow();
+
    // render to fbo
-   if (HASFBO && usefbo)
+   if (HASFBO && usefbo && !reduced)
       if (get_tfunc()->checkRGBA())
          {
          glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fboId);
@@ -3446,6 +4729,8 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
 
          glEnable(GL_CLIP_PLANE0+plane);
 
+         memcpy(&clipequ[4*plane],equ,4*sizeof(double));
+
          plane++;
          }
 
@@ -3484,6 +4769,8 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
 
       glEnable(GL_CLIP_PLANE0+plane);
 
+      memcpy(&clipequ[4*plane],equ,4*sizeof(double));
+
       plane++;
       }
 
@@ -3493,37 +4780,111 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
    // render opaque surface
    SURFACE.render();
 
+   // redirect the volume into the reduced fbo
+   if (reduced)
+      {
+      for (i=0; i<plane; i++)
+         glDisable(GL_CLIP_PLANE0+i);
+
+      beginlow();
+
+      for (i=0; i<plane; i++)
+         glEnable(GL_CLIP_PLANE0+i);
+      }
+
    // render semi-transparent volume
    if (VOLCNT>0)
       {
       // set stereo interlacing mode
       volume::setSFXmode(SFXMODE);
 
+      // set intensity projection mode
+      volume::setPROJmode(vol_mode_);
+
       // choose volume
       if (TFUNC->get_imode())
          while (map<VOLCNT-1 && slab/VOL[map]->get_slab()>1.5f) map++;
 
+      // skip the levels finer than requested
+      while (map<VOLCNT-1 && (map<vol_level_ || (vol_fps_>0.0f && map<ADAPTLEVEL))) map++;
+
+      // manage brick residency
+      if (brick::get_budget()>0 && !cpu)
+         {
+         brick::next_frame();
+
+         // choose volume that fits into the graphics memory budget
+         // together with the next coarser volume as its fallback
+         while (map<VOLCNT-1 && VOL[map]->get_memory()+VOL[map+1]->get_memory()>brick::get_budget()) map++;
+
+         load=vol_maxload_;
+
+         // keep the finest resident coarser volume (or the coarsest one) in memory
+         // so that streaming the chosen volume does not evict the fallback
+         fallback=map;
+         if (map<VOLCNT-1 && !VOL[map]->is_resident())
+            {
+            fallback=map+1;
+            while (fallback<VOLCNT-1 && !VOL[fallback]->is_resident()) fallback++;
+            VOL[fallback]->stream(load);
+            }
+
+         // stream missing bricks and render the fallback meanwhile
+         if (VOL[map]->stream(load)>0) map=fallback;
+         }
+
+      // composite front-to-back into the fbo to cull occluded bricks
+      // and to terminate the rays early across the bricks
+      if (HASFBO && usefbo && (vol_occlusion_ || vol_raycast_) && !reduced && !cpu && vol_mode_==PROJ_NONE)
+         if (get_tfunc()->checkRGBA() && get_tfunc()->get_aid()==0)
+            if (VOL[map]->has_occlusion()) front2back=TRUE;
+
+      // move the opaque geometry out of the way
+      if (front2back) beginunder();
+
       // render volume
-      aborted=VOL[map]->render(ex,ey,ez,
-                               dx,dy,dz,
-                               ux,uy,uz,
-                               nearp,slab,
-                               1.0f/get_slab(),
-                               lighting,
-                               abort,abortdata);
+      if (vol_mode_!=PROJ_NONE)
+         aborted=VOL[map]->project(ex,ey,ez,
+                                   dx,dy,dz,
+                                   ux,uy,uz,
+                                   nearp,slab,
+                                   vol_mode_,
+                                   abort,abortdata);
+      else if (cpu)
+         vol_cpu_->render(map,
+                          ex,ey,ez,
+                          dx,dy,dz,
+                          nearp,slab,
+                          vol_cpu_thres_,
+                          plane,clipequ);
+      else
+         aborted=VOL[map]->render(ex,ey,ez,
+                                  dx,dy,dz,
+                                  ux,uy,uz,
+                                  nearp,slab,
+                                  1.0f/get_slab(),
+                                  lighting,
+                                  front2back,
+                                  abort,abortdata);
       }
 
    // disable clipping planes
    for (i=0; i<plane; i++)
       glDisable(GL_CLIP_PLANE0+i);
 
+   // composite the opaque geometry underneath the volume
+   if (front2back) endunder();
+
+   // upsample the reduced volume
+   if (reduced) endlow();
+
    // render from fbo
-   if (HASFBO && usefbo)
+   if (HASFBO && usefbo && !reduced)
       if (get_tfunc()->checkRGBA())
          {
          // render from fbo texture:
 
-         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
 
          glBindTexture(GL_TEXTURE_2D, textureId);
          glEnable(GL_TEXTURE_2D);
@@ -3577,19 +4938,25 @@ BOOLINT mipmap::render(float ex,float ey,float ez,
 #ifdef GL_EXT_framebuffer_blit
 
          glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, fboId);
-         glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, 0);
+         glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, targetFboId);
 
          glBlitFramebufferEXT(0, 0, fboWidth, fboHeight,
                               0, 0, fboWidth, fboHeight,
                               GL_DEPTH_BUFFER_BIT,
                               GL_NEAREST);
 
+         // read back from the target framebuffer
+         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, targetFboId);
+
 #endif
          }
 
    // invert frame buffer
    if (TFUNC->get_invmode()) invertbuffer();
 
+   // measure frame time
+   endadapt();
+
    return(aborted);
    }
 
@@ -3727,6 +5094,78 @@ void mipmap::renderslice(float ox,float oy,float oz,
    disableshader();
    }
 
+// extract an oblique volume slice
+BOOLINT mipmap::extractslice(float ox,float oy,float oz,
+                             float nx,float ny,float nz,
+                             int width,int height,float size,
+                             unsigned char *image,int bytes,
+                             float thickness,int mode)
+   {
+   float sx,sy,sz;
+   float x0,y0,z0;
+   float fx,fy,fz;
+
+   float ux,uy,uz;
+   float vx,vy,vz;
+
+   float l,d;
+   int samples;
+
+   if (VOLUME==NULL || VOLCNT==0) return(FALSE);
+   if (WIDTH<2 || HEIGHT<2 || DEPTH<2) return(FALSE);
+
+   l=fsqrt(nx*nx+ny*ny+nz*nz);
+   if (l==0.0f || width<=0 || height<=0 || size<=0.0f) return(FALSE);
+
+   nx/=l;
+   ny/=l;
+   nz/=l;
+
+   // data extent without the half voxel border of the bounding box
+   sx=getsizex()*(WIDTH-1)/(WIDTH+1);
+   sy=getsizey()*(HEIGHT-1)/(HEIGHT+1);
+   sz=getsizez()*(DEPTH-1)/(DEPTH+1);
+
+   // world position of the first voxel
+   x0=getcenterx()-sx/2;
+   y0=getcentery()-sy/2;
+   z0=getcenterz()-sz/2;
+
+   // voxels per world unit
+   fx=(WIDTH-1)/sx;
+   fy=(HEIGHT-1)/sy;
+   fz=(DEPTH-1)/sz;
+
+   mpr::axes(nx,ny,nz,&ux,&uy,&uz,&vx,&vy,&vz);
+
+   // pixel spacing
+   l=size/width;
+
+   // slab sampling with at most one sample per voxel
+   samples=1;
+   d=0.0f;
+
+   if (thickness>0.0f && mode!=MPR_SLICE)
+      {
+      d=fmin(sx/(WIDTH-1),fmin(sy/(HEIGHT-1),sz/(DEPTH-1)));
+      samples=ftrc(fceil(thickness/d))+1;
+      d=thickness/(samples-1);
+      }
+
+   if (MPRENGINE==NULL) MPRENGINE=new mpr;
+   MPRENGINE->set_data(VOLUME,WIDTH,HEIGHT,DEPTH,COMPONENTS);
+
+   MPRENGINE->resample((ox-x0)*fx,(oy-y0)*fy,(oz-z0)*fz,
+                       l*ux*fx,l*uy*fy,l*uz*fz,
+                       l*vx*fx,l*vy*fy,l*vz*fz,
+                       d*nx*fx,d*ny*fy,d*nz*fz,
+                       samples,mode,
+                       width,height,
+                       image,bytes);
+
+   return(TRUE);
+   }
+
 // begin plain rendering
 void mipmap::beginplain()
    {
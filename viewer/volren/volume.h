@@ -17,10 +17,16 @@
 #include "shaderbase.h" // OpenGL shader program handling
 #include "tfbase.h" // transfer functions
 #include "tilebase.h" // volume tiles and bricks
+#include "raybase.h" // cpu ray casting
+#include "mprbase.h" // multi-planar reconstruction
 #include "geobase.h" // surface wrapper
 
 #define MAX_CLIP_PLANES 6
 
+#define OCCBATCH 8
+
+#define ADAPTQUERIES 2
+
 // the volume
 class volume
    {
@@ -35,6 +41,15 @@ class volume
    // set stereo interlacing mode
    static void setSFXmode(int sfxmode);
 
+   // set brick atlas mode
+   static void setATLASmode(BOOLINT atlasmode);
+
+   // set ray casting mode
+   static void setRAYmode(BOOLINT raymode,float thres=0.95f);
+
+   // set intensity projection mode
+   static void setPROJmode(int projmode);
+
    // check brick size
    static BOOLINT check(int bricksize,float overmax);
 
@@ -53,15 +68,37 @@ class volume
    // set ambient/diffuse/specular lighting coefficients
    void set_light(float noise,float ambnt,float difus,float specl,float specx);
 
+   // check whether or not all visible tiles are resident
+   BOOLINT is_resident();
+
+   // make missing visible tiles resident, consuming at most maxload uploads
+   int stream(int &maxload);
+
+   // return graphics memory of the visible tiles in bytes
+   long long get_memory();
+
+   // check whether or not occlusion queries are supported
+   BOOLINT has_occlusion() {return(HASOCC);}
+
    // render the volume
    BOOLINT render(float ex,float ey,float ez,
                   float dx,float dy,float dz,
                   float ux,float uy,float uz,
                   float nearp,float slab,float rslab,
                   BOOLINT lighting=FALSE,
+                  BOOLINT front2back=FALSE,
                   BOOLINT (*abort)(void *abortdata)=NULL,
                   void *abortdata=NULL);
 
+   // render the volume as an order-independent intensity projection
+   BOOLINT project(float ex,float ey,float ez,
+                   float dx,float dy,float dz,
+                   float ux,float uy,float uz,
+                   float nearp,float slab,
+                   int projmode,
+                   BOOLINT (*abort)(void *abortdata)=NULL,
+                   void *abortdata=NULL);
+
    // render a volume slice
    void renderslice(float ox,float oy,float oz,
                     float nx,float ny,float nz);
@@ -93,21 +130,47 @@ class volume
 
    int TILEX,TILEY,TILEZ;
 
+   atlasptr *ATLAS;
+   int ATLASMAX,ATLASCNT;
+
    tfunc2D *TFUNC;
 
    private:
 
    char BASE[MAXSTR];
 
-   BOOLINT sort(int x,int y,int z,
-                int sx,int sy,int sz,
+   static BOOLINT ATLASMODE;
+
+   atlas *pack(atlas *last,int bricksize,int count);
+
+   tileptr *ORDER;
+   int ORDERMAX,ORDERCNT;
+
+   BOOLINT HASVBO;
+   GLuint VBO;
+
+   BOOLINT HASOCC;
+   GLuint OCCQUERY[2*OCCBATCH];
+   BOOLINT OCCISSUED[2*OCCBATCH];
+   tileptr OCCTILE[2*OCCBATCH];
+   GLuint OCCTEX;
+   int OCCX,OCCY;
+   int OCCWIDTH,OCCHEIGHT;
+
+   void sort(int x,int y,int z,
+             int sx,int sy,int sz,
+             float ex,float ey,float ez);
+
+   void upload();
+
+   void occlude(int first,int count,
                 float ex,float ey,float ez,
                 float dx,float dy,float dz,
-                float ux,float uy,float uz,
-                float nearp,float slab,float rslab,
-                BOOLINT lighting=FALSE,
-                BOOLINT (*abort)(void *abortdata)=NULL,
-                void *abortdata=NULL);
+                float nearp);
+
+   void retire(int slot,int count);
+
+   BOOLINT is_occluded(int i);
 
    };
 
@@ -204,6 +267,57 @@ class mipmap
    void set_iso_maxsize(long long maxsize,
                         float ratio=0.25f);
 
+   //! set graphics memory budget in MB for out-of-core rendering
+   //! bricks are kept in host memory and paged in on demand (0=unlimited)
+   //! needs to be set before the volume data is loaded
+   void set_vol_budget(long long budget,
+                       int maxload=16);
+
+   //! enable packing of bricks into texture atlases
+   //! needs to be set before the volume data is loaded
+   void set_vol_atlas(BOOLINT on=TRUE);
+
+   //! enable single-pass ray casting instead of slicing
+   //! rays are terminated early at the given opacity threshold
+   //! with a fbo the rays are composited front-to-back as with set_vol_occlusion
+   //! so that they also terminate early across the bricks
+   void set_vol_raycast(BOOLINT on=TRUE,float thres=0.95f);
+
+   //! enable front-to-back compositing into the fbo
+   //! bricks behind saturated pixels are culled with occlusion queries
+   void set_vol_occlusion(BOOLINT on=TRUE);
+
+   //! set the finest pyramid level used for rendering (0=full resolution)
+   //! used to render coarse previews during interaction
+   void set_vol_level(int level=0);
+
+   //! get the number of pyramid levels
+   int get_vol_levels() {return(VOLCNT);}
+
+   //! enable adaptive sampling to hold a target frame rate (0=off)
+   //! slab thickness and pyramid level follow the measured frame time
+   //! the adapted sampling is kept while disabled and resumed when enabled again
+   void set_vol_fps(float fps=0.0f);
+
+   //! get the actual adaptive oversampling factor
+   float get_vol_adapt() {return((vol_fps_>0.0f)?ADAPTOVER:1.0f);}
+
+   //! render the volume into a fbo with reduced resolution (1=full resolution)
+   //! the volume is upsampled with a depth-aware filter, the geometry stays at native resolution
+   void set_vol_scale(float scale=1.0f);
+
+   //! render the volume as maximum, minimum or average intensity projection
+   //! the intensity is windowed by the non-zero range of the tf (PROJ_NONE=compositing)
+   void set_vol_mode(int mode=PROJ_NONE);
+
+   //! get the actual intensity projection mode
+   int get_vol_mode() {return(vol_mode_);}
+
+   //! render the volume on the cpu by ray casting the volume data in host memory
+   //! rays are terminated early at the given opacity threshold
+   //! needs to be set before the volume data is loaded
+   void set_vol_cpu(BOOLINT on=TRUE,float thres=0.95f);
+
    //! render the volume
    BOOLINT render(float ex,float ey,float ez,
                   float dx,float dy,float dz,
@@ -229,6 +343,17 @@ class mipmap
                     float alpha=1.0f,
                     float alpha2=0.1f);
 
+   //! extract an oblique volume slice on the cpu
+   //! the slice is centered at o with the plane normal n in world coordinates
+   //! the image covers size world units horizontally and is written top-down
+   //! a slab thickness>0 yields a thick slab with MIP, MinIP or average mode
+   //! with 1 or 2 bytes per pixel (msb first)
+   BOOLINT extractslice(float ox,float oy,float oz,
+                        float nx,float ny,float nz,
+                        int width,int height,float size,
+                        unsigned char *image,int bytes=1,
+                        float thickness=0.0f,int mode=MPR_SLICE);
+
    //! return center of bounding box
    float getcenterx() {return(VOL[0]->getcenterx());}
    float getcentery() {return(VOL[0]->getcentery());}
@@ -387,6 +512,19 @@ class mipmap
    long long iso_target_cells_;
    float iso_ratio_;
 
+   int vol_maxload_;
+   BOOLINT vol_occlusion_;
+   BOOLINT vol_raycast_;
+   int vol_level_;
+   float vol_fps_;
+   float vol_scale_;
+   int vol_mode_;
+
+   raycaster *vol_cpu_;
+   float vol_cpu_thres_;
+
+   mpr *MPRENGINE;
+
    // render opaque geometry
    virtual void rendergeometry() = 0;
 
@@ -454,12 +592,56 @@ class mipmap
    GLuint textureId;
    GLuint rboId;
    GLuint fboId;
+   GLuint geoTextureId;
+   GLuint targetFboId;
 
    void setup(int width,int heigth);
    void destroy();
 
+   void beginunder();
+   void endunder();
+
    void updatefbo();
 
+   // reduced resolution fbo:
+
+   BOOLINT HASLOW;
+   int lowWidth,lowHeight;
+   GLuint lowTextureId;
+   GLuint lowDepthId;
+   GLuint lowFboId;
+   GLuint depthTextureId;
+
+   BOOLINT LOWLOADED;
+   int DOWNSHADER;
+   int UPSHADER;
+
+   BOOLINT setuplow();
+   void destroylow();
+
+   void beginlow();
+   void endlow();
+
+   // adaptive sampling:
+
+   float ADAPTOVER;
+   int ADAPTLEVEL;
+   int ADAPTCOUNT;
+
+   double ADAPTSTART;
+   double ADAPTCPU;
+
+   double ADAPTGPU;
+
+   BOOLINT HASTIMER;
+   GLuint ADAPTQUERY[ADAPTQUERIES];
+   BOOLINT ADAPTISSUED[ADAPTQUERIES];
+   int ADAPTNEXT;
+   BOOLINT ADAPTACTIVE;
+
+   void beginadapt();
+   void endadapt();
+
    // volume loading and preprocessing:
 
    unsigned char *readANYvolume(const char *filename,